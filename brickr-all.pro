@@ -0,0 +1,18 @@
+######################################################################
+# Builds the engine library, then the applications linking it
+######################################################################
+
+TEMPLATE = subdirs
+
+SUBDIRS += libbrickr \
+           brickr \
+           brickr-cli \
+           brickr-bench
+
+libbrickr.file = libbrickr.pro
+brickr.file = brickr.pro
+brickr.depends = libbrickr
+brickr-cli.file = brickr-cli.pro
+brickr-cli.depends = libbrickr
+brickr-bench.file = brickr-bench.pro
+brickr-bench.depends = libbrickr
@@ -0,0 +1,29 @@
+######################################################################
+# Benchmarks of the engine operations, JSON results.
+# Run from the repository root (or pass --data-dir) to find the inputs.
+######################################################################
+
+TEMPLATE = app
+TARGET = brickr-bench
+CONFIG += console
+CONFIG -= app_bundle
+DEPENDPATH += . src
+INCLUDEPATH += . src
+QT = core gui
+QMAKE_CXXFLAGS += -std=c++11
+
+include(libbrickr.pri)
+
+unix:!macx{
+    CONFIG(release, debug|release) {
+         QMAKE_CXXFLAGS += -O3
+    }
+    LIBS += -lpthread
+}
+
+# Input
+HEADERS += src/InstructionRenderer.h \
+           src/InstructionWriter.h
+SOURCES += src/bench.cpp \
+           src/InstructionRenderer.cpp \
+           src/InstructionWriter.cpp
@@ -0,0 +1,28 @@
+######################################################################
+# Command line driver: no widgets nor OpenGL, runs without a display.
+# Links the engine library, only the CPU renderers need QtGui.
+######################################################################
+
+TEMPLATE = app
+TARGET = brickr-cli
+CONFIG += console
+CONFIG -= app_bundle
+DEPENDPATH += . src
+INCLUDEPATH += . src
+QT = core gui
+QMAKE_CXXFLAGS += -std=c++11
+
+include(libbrickr.pri)
+
+unix:!macx{
+    LIBS += -lpthread
+}
+
+# Input
+HEADERS += src/InstructionRenderer.h \
+           src/InstructionWriter.h \
+           src/PreviewRenderer.h
+SOURCES += src/cli.cpp \
+           src/InstructionRenderer.cpp \
+           src/InstructionWriter.cpp \
+           src/PreviewRenderer.cpp
@@ -6,27 +6,36 @@ TEMPLATE = app
 TARGET = brickr
 DEPENDPATH += . forms src
 INCLUDEPATH += . src
-QT += svg opengl
+QT += opengl
 LIBS += -lGLU
 QMAKE_CXXFLAGS += -std=c++11
 
+include(libbrickr.pri)
+
 # Input
 HEADERS += src/AssemblyPlugin.h \
            src/AssemblyWidget.h \
-           src/LegoBrick.h \
-           src/LegoCloud.h \
+           src/InstructionRenderer.h \
+           src/InstructionWriter.h \
            src/LegoCloudNode.h \
-           src/LegoDimensions.h \
-           src/LegoGraph.h \
+           src/LegoGraphOverlay.h \
+           src/LegoRenderMesh.h \
+           src/LogRingBuffer.h \
            src/model.h \
            src/openglscene.h \
-           src/QDebugStream.h \
-           src/Vector3.h
+           src/PreviewRenderer.h \
+           src/QDebugStream.h
 FORMS += forms/AssemblyWidget.ui
 SOURCES += src/AssemblyPlugin.cpp \
            src/AssemblyWidget.cpp \
-           src/LegoCloud.cpp \
+           src/InstructionRenderer.cpp \
+           src/InstructionWriter.cpp \
            src/LegoCloudNode.cpp \
+           src/LegoGraphOverlay.cpp \
+           src/LegoRenderMesh.cpp \
+           src/LogRingBuffer.cpp \
            src/main.cpp \
            src/model.cpp \
-           src/openglscene.cpp
+           src/openglscene.cpp \
+           src/PreviewRenderer.cpp \
+           src/QDebugStream.cpp
@@ -0,0 +1,21 @@
+# Include this file to link against the engine library built by libbrickr.pro.
+# brickr-all.pro builds the library first; when building an application on its own,
+# build libbrickr.pro in the matching build directory beforehand.
+
+BRICKR_LIB_DIR = $$shadowed($$PWD)
+
+INCLUDEPATH += $$PWD/src
+DEPENDPATH += $$PWD/src
+
+tracing: DEFINES += BRICKR_TRACING
+
+win32{
+    CONFIG(debug, debug|release): BRICKR_LIB_DIR = $${BRICKR_LIB_DIR}/debug
+    else: BRICKR_LIB_DIR = $${BRICKR_LIB_DIR}/release
+    LIBS += -L$${BRICKR_LIB_DIR} -lbrickr
+    PRE_TARGETDEPS += $${BRICKR_LIB_DIR}/brickr.lib
+    LIBS += -lpsapi
+} else {
+    LIBS += -L$${BRICKR_LIB_DIR} -lbrickr
+    PRE_TARGETDEPS += $${BRICKR_LIB_DIR}/libbrickr.a
+}
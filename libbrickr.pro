@@ -0,0 +1,65 @@
+######################################################################
+# Brick layout engine: voxelization, optimization and I/O.
+# QtCore only, no widgets nor OpenGL. Linked by the GUI, the command
+# line driver and the benchmarks through libbrickr.pri.
+######################################################################
+
+TEMPLATE = lib
+TARGET = brickr
+VERSION = 1.0.0
+CONFIG += staticlib
+DEPENDPATH += . src
+INCLUDEPATH += . src
+QT = core
+QMAKE_CXXFLAGS += -std=c++11
+
+# qmake CONFIG+=tracing compiles the trace spans (Trace.h)
+tracing: DEFINES += BRICKR_TRACING
+
+win32{
+    DEFINES += NOMINMAX
+
+# include boost, replace this with your boost paths
+    BOOST_DIR = C:\local\boost_1_55_0
+    INCLUDEPATH += $${BOOST_DIR}
+}
+
+unix:!macx{
+    CONFIG(release, debug|release) {
+         QMAKE_CXXFLAGS += -O3
+    }
+}
+
+# Input
+HEADERS += src/BinvoxParser.h \
+           src/Brickr.h \
+           src/EngineCounters.h \
+           src/LegoBrick.h \
+           src/LegoBrickList.h \
+           src/LegoCloud.h \
+           src/LegoDimensions.h \
+           src/LegoExporter.h \
+           src/LegoGraph.h \
+           src/LegoMesher.h \
+           src/LegoOperationLog.h \
+           src/LegoPipeline.h \
+           src/LegoRandom.h \
+           src/ObjParser.h \
+           src/ProcessStats.h \
+           src/Trace.h \
+           src/Vector3.h \
+           src/VoxelCache.h \
+           src/Voxelizer.h
+SOURCES += src/BinvoxParser.cpp \
+           src/EngineCounters.cpp \
+           src/LegoBrickList.cpp \
+           src/LegoCloud.cpp \
+           src/LegoExporter.cpp \
+           src/LegoMesher.cpp \
+           src/LegoOperationLog.cpp \
+           src/LegoPipeline.cpp \
+           src/ObjParser.cpp \
+           src/ProcessStats.cpp \
+           src/Trace.cpp \
+           src/VoxelCache.cpp \
+           src/Voxelizer.cpp
@@ -0,0 +1,349 @@
+/*
+ * Procedural binvox workloads for scaling and profiling runs.
+ *
+ *   mkshapes <shape> <resolution> <output.binvox> [-t thickness] [-s seed] [-c]
+ *
+ * shapes:
+ *   sphere    solid ball
+ *   torus     ring standing upright: an arch with bricks hanging under its top
+ *   shell     hollow ball, -t walls (default 2): thin walls are full of weak articulation points
+ *   dumbbell  two balls joined by a horizontal neck of radius -t (default 1)
+ *   overhang  pillar under a wide cap of -t levels (default 2) with pendants hanging from its rim
+ *   terrain   fractal noise height field, -s seed; -t 1 to 10 carves more and more caves
+ *
+ * The resolution (32 to 1024) is the grid size in every direction, except for the terrain which
+ * is a quarter as high. The grid is streamed in binvox order, only one shape is evaluated per
+ * voxel: memory does not grow with the resolution.
+ * -c also writes <output.binvox>.color with a color per surface voxel (the inner voxels keep the
+ * default color), in the "x;y;level;colorId" format read with the binvox file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_RESOLUTION 4
+#define MAX_RESOLUTION 1024
+
+/* Ids in LegoCloud::legalColors_ */
+enum { WHITE = 0, BLACK, RED, BLUE, DARK_GREEN, LIME, YELLOW, ORANGE, BROWN };
+
+enum Shape { SPHERE, TORUS, SHELL, DUMBBELL, OVERHANG, TERRAIN };
+
+static const char *shapeNames[] = { "sphere", "torus", "shell", "dumbbell", "overhang", "terrain" };
+
+typedef struct {
+	enum Shape shape;
+	int depth, height, width; /* x, level, y */
+	float thickness;
+	unsigned int seed;
+	float *heights; /* terrain, depth*width */
+} Generator;
+
+/* Value noise */
+
+static unsigned int hash3(unsigned int seed, int x, int y, int z) {
+	unsigned int h = seed * 0x9E3779B9u;
+	h ^= (unsigned int)x * 0x85EBCA6Bu;
+	h = (h << 13) | (h >> 19);
+	h ^= (unsigned int)y * 0xC2B2AE35u;
+	h = (h << 13) | (h >> 19);
+	h ^= (unsigned int)z * 0x27D4EB2Fu;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h;
+}
+
+static float lattice(unsigned int seed, int x, int y, int z) {
+	return (hash3(seed, x, y, z) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static float smooth(float t) {
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static float lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+static float valueNoise(unsigned int seed, float x, float y, float z) {
+	int x0 = (int)(float)floor(x), y0 = (int)(float)floor(y), z0 = (int)(float)floor(z);
+	float tx = smooth(x - x0), ty = smooth(y - y0), tz = smooth(z - z0);
+	float c[2][2];
+	int i, j;
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < 2; j++)
+			c[i][j] = lerp(lattice(seed, x0 + i, y0 + j, z0), lattice(seed, x0 + i, y0 + j, z0 + 1), tz);
+	return lerp(lerp(c[0][0], c[0][1], ty), lerp(c[1][0], c[1][1], ty), tx);
+}
+
+/* In [0, 1], features of about 1/frequency */
+static float fractalNoise(unsigned int seed, float x, float y, float z, float frequency) {
+	float sum = 0.0f, amplitude = 0.5f, total = 0.0f;
+	int octave;
+
+	for (octave = 0; octave < 5; octave++) {
+		sum += amplitude * valueNoise(seed + octave, x * frequency, y * frequency, z * frequency);
+		total += amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return sum / total;
+}
+
+/* Shapes, in voxel units around the grid center */
+
+static int inside(const Generator *g, int x, int level, int y) {
+	float n = (float)g->depth;
+	float px = x + 0.5f - g->depth * 0.5f;
+	float py = level + 0.5f - g->height * 0.5f;
+	float pz = y + 0.5f - g->width * 0.5f;
+	float r2 = px * px + py * py + pz * pz;
+
+	if (x < 0 || level < 0 || y < 0 || x >= g->depth || level >= g->height || y >= g->width)
+		return 0;
+
+	switch (g->shape) {
+	case SPHERE:
+		return r2 <= (0.45f * n) * (0.45f * n);
+	case TORUS: {
+		/* In the x-level plane */
+		float ring = (float)sqrt(px * px + py * py) - 0.32f * n;
+		float minor = g->thickness > 0.0f ? g->thickness : 0.1f * n;
+		return ring * ring + pz * pz <= minor * minor;
+	}
+	case SHELL: {
+		float outer = 0.45f * n, inner = outer - (g->thickness > 0.0f ? g->thickness : 2.0f);
+		return r2 <= outer * outer && r2 >= inner * inner;
+	}
+	case DUMBBELL: {
+		float ball = 0.22f * n, offset = 0.25f * n;
+		float neck = g->thickness > 0.0f ? g->thickness : 1.0f;
+		float left = (px + offset) * (px + offset) + py * py + pz * pz;
+		float right = (px - offset) * (px - offset) + py * py + pz * pz;
+		return left <= ball * ball || right <= ball * ball || ((float)fabs(px) <= offset && py * py + pz * pz <= neck * neck);
+	}
+	case OVERHANG: {
+		float cap = g->thickness > 0.0f ? g->thickness : 2.0f;
+		float capBottom = 0.75f * g->height, capTop = capBottom + cap;
+		float radial = (float)sqrt(px * px + pz * pz);
+		float angle = (float)atan2(pz, px);
+		if (level + 0.5f >= capBottom && level + 0.5f < capTop)
+			return radial <= 0.45f * n;
+		if (level + 0.5f < capBottom && radial <= 0.1f * n)
+			return 1; /* Pillar */
+		/* Eight pendants under the rim, only held by the cap */
+		if (level + 0.5f < capBottom && level + 0.5f >= capBottom - 0.25f * g->height) {
+			float sector = 6.2831853f / 8.0f;
+			float a = angle - sector * (float)floor(angle / sector + 0.5f);
+			float dx = radial * (float)cos(a) - 0.38f * n, dz = radial * (float)sin(a);
+			return dx * dx + dz * dz <= (0.04f * n + 0.5f) * (0.04f * n + 0.5f);
+		}
+		return 0;
+	}
+	case TERRAIN:
+		if (level + 0.5f > g->heights[x * g->width + y])
+			return 0;
+		/* Caves carve the ground under the first levels, so they can leave floating pieces */
+		if (g->thickness > 0.0f && level > 0)
+			return fractalNoise(g->seed + 101, (float)x, (float)level * 2.0f, (float)y, 4.0f / n) >= 0.25f + 0.025f * g->thickness;
+		return 1;
+	}
+	return 0;
+}
+
+static int colorOf(const Generator *g, int x, int level, int y) {
+	float height = (level + 0.5f) / g->height;
+
+	switch (g->shape) {
+	case DUMBBELL: {
+		float px = x + 0.5f - g->depth * 0.5f;
+		if ((float)fabs(px) < 0.03f * g->depth + 1.0f)
+			return YELLOW;
+		return px < 0.0f ? RED : BLUE;
+	}
+	case OVERHANG:
+		return level + 0.5f >= 0.75f * g->height ? DARK_GREEN : BROWN;
+	case TERRAIN:
+		/* Cliffs and cave walls, then the ground by altitude */
+		if (inside(g, x, level + 1, y))
+			return BROWN;
+		if (height < 0.3f)
+			return YELLOW;
+		if (height < 0.65f)
+			return DARK_GREEN;
+		return height < 0.85f ? BLACK : WHITE;
+	default: {
+		static const int bands[] = { RED, ORANGE, YELLOW, LIME, DARK_GREEN, BLUE };
+		int band = (int)(height * 6.0f);
+		return bands[band < 0 ? 0 : (band > 5 ? 5 : band)];
+	}
+	}
+}
+
+static int isSurface(const Generator *g, int x, int level, int y) {
+	return !inside(g, x - 1, level, y) || !inside(g, x + 1, level, y) ||
+		!inside(g, x, level - 1, y) || !inside(g, x, level + 1, y) ||
+		!inside(g, x, level, y - 1) || !inside(g, x, level, y + 1);
+}
+
+static void buildHeights(Generator *g) {
+	int x, y;
+	float n = (float)g->depth;
+
+	g->heights = (float *)malloc(sizeof(float) * g->depth * g->width);
+	if (!g->heights)
+		return;
+	for (x = 0; x < g->depth; x++)
+		for (y = 0; y < g->width; y++) {
+			float noise = fractalNoise(g->seed, (float)x, 0.0f, (float)y, 3.0f / n);
+			/* Contrast so that there are both plains and peaks */
+			noise = smooth(smooth(noise));
+			g->heights[x * g->width + y] = g->height * (0.1f + 0.88f * noise);
+		}
+}
+
+static int writeRun(FILE *f, unsigned char value, unsigned char count) {
+	unsigned char run[2];
+
+	run[0] = value;
+	run[1] = count;
+	return fwrite(run, sizeof(unsigned char), 2, f) == 2;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: mkshapes <sphere|torus|shell|dumbbell|overhang|terrain> <resolution> <output.binvox> [-t thickness] [-s seed] [-c]\n");
+}
+
+int main(int argc, char **argv) {
+	Generator g;
+	int resolution, writeColors = 0, written = 1, i, x, y, level;
+	unsigned char value = 0, count = 0;
+	long voxels = 0, colors = 0;
+	FILE *f, *colorFile = NULL;
+	char *colorFilePath = NULL;
+
+	if (argc < 4) {
+		usage();
+		return 1;
+	}
+
+	memset(&g, 0, sizeof(g));
+	for (i = 0; i < 6 && strcmp(argv[1], shapeNames[i]) != 0; i++)
+		;
+	if (i == 6) {
+		fprintf(stderr, "unknown shape: %s\n", argv[1]);
+		usage();
+		return 1;
+	}
+	g.shape = (enum Shape)i;
+
+	resolution = atoi(argv[2]);
+	if (resolution < MIN_RESOLUTION || resolution > MAX_RESOLUTION) {
+		fprintf(stderr, "the resolution must be between %d and %d\n", MIN_RESOLUTION, MAX_RESOLUTION);
+		return 1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			char *end;
+			g.thickness = (float)strtod(argv[++i], &end);
+			if (*end != '\0' || end == argv[i] || !(g.thickness >= 0.0f)) {
+				fprintf(stderr, "invalid thickness: %s\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			g.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-c") == 0)
+			writeColors = 1;
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	g.depth = g.width = resolution;
+	g.height = g.shape == TERRAIN ? (resolution / 4 > 4 ? resolution / 4 : 4) : resolution;
+	if (g.shape == TERRAIN) {
+		buildHeights(&g);
+		if (!g.heights) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+	}
+
+	f = fopen(argv[3], "wb");
+	if (!f) {
+		fprintf(stderr, "unable to write %s\n", argv[3]);
+		free(g.heights);
+		return 1;
+	}
+	if (writeColors) {
+		colorFilePath = (char *)malloc(strlen(argv[3]) + 7);
+		sprintf(colorFilePath, "%s.color", argv[3]);
+		colorFile = fopen(colorFilePath, "w");
+		if (!colorFile)
+			fprintf(stderr, "unable to write %s\n", colorFilePath);
+	}
+
+	fprintf(f, "#binvox 1\n");
+	fprintf(f, "dim %d %d %d\n", g.depth, g.height, g.width);
+	fprintf(f, "translate %f %f %f\n", 0.0, 0.0, 0.0);
+	fprintf(f, "scale %f\n", 1.0);
+	fprintf(f, "data\n");
+
+	/* Binvox order: x slowest, the level fastest */
+	for (x = 0; x < g.depth; x++)
+		for (y = 0; y < g.width; y++)
+			for (level = 0; level < g.height; level++) {
+				unsigned char filled = (unsigned char)inside(&g, x, level, y);
+
+				if (filled) {
+					voxels++;
+					if (colorFile && isSurface(&g, x, level, y)) {
+						fprintf(colorFile, "%d;%d;%d;%d\n", x, y, level, colorOf(&g, x, level, y));
+						colors++;
+					}
+				}
+
+				if (count > 0 && (filled != value || count == 255)) {
+					written = writeRun(f, value, count) && written;
+					count = 0;
+				}
+				value = filled;
+				count++;
+			}
+	if (count > 0)
+		written = writeRun(f, value, count) && written;
+
+	/* A full disk only shows up in the write results */
+	written = !ferror(f) && written;
+	written = fclose(f) == 0 && written;
+	if (colorFile) {
+		int colorWritten = !ferror(colorFile);
+		colorWritten = fclose(colorFile) == 0 && colorWritten;
+		if (!colorWritten) {
+			fprintf(stderr, "error writing %s\n", colorFilePath);
+			remove(colorFilePath);
+			written = 0;
+		}
+	}
+	free(colorFilePath);
+	free(g.heights);
+	if (!written) {
+		fprintf(stderr, "error writing %s\n", argv[3]);
+		remove(argv[3]);
+		return 1;
+	}
+
+	fprintf(stderr, "%s: %s %dx%dx%d, %ld voxels", argv[3], shapeNames[g.shape], g.depth, g.height, g.width, voxels);
+	if (colorFile)
+		fprintf(stderr, ", %ld colors", colors);
+	fprintf(stderr, "\n");
+	return 0;
+}
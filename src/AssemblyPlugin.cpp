@@ -4,37 +4,57 @@
 #include "LegoCloudNode.h"
 #include "LegoCloud.h"
 #include "LegoBrick.h"
+#include "LegoPipeline.h"
+#include "Trace.h"
 
-#include <fstream>
 #include <limits.h>
+#include <QDateTime>
 #include <QSet>
 #include <QFileInfo>
 #include <QTime>
-#include <QtDebug>
-#include <QFile>
-#include <QHash>
-
-#define AUTO_OPTIMIZE_MAX_STEPS 50
 
 AssemblyPlugin::AssemblyPlugin()
   : assemblyWidget_(0) {
+  //BRICKR_TRACE=<file.json> records the session, in builds with CONFIG+=tracing
+  if(!qEnvironmentVariableIsEmpty("BRICKR_TRACE"))
+    Trace::start(QString::fromLocal8Bit(qgetenv("BRICKR_TRACE")));
 }
 
 AssemblyPlugin::~AssemblyPlugin()
 {
+  if(Trace::isRecording())
+    Trace::stop();
+}
+
+void AssemblyPlugin::setLegoCloudNode(const std::shared_ptr<LegoCloudNode>& legoCloudNode)
+{
+  //Every cloud of the session gets its own seed, printed so that brickr-cli --seed can reproduce the run
+  static unsigned int cloudNumber = 0;
+  const unsigned int seed = unsigned(QDateTime::currentMSecsSinceEpoch()) + cloudNumber++;
+  legoCloudNode->getLegoCloud()->setSeed(seed);
+  std::cout << "Seed: " << seed << std::endl;
+
+  legoCloudNode_ = legoCloudNode;
+  connect(legoCloudNode_.get(), SIGNAL(meshReady()), this, SIGNAL(sceneChanged()));
 }
 
 //Button slot
 void AssemblyPlugin::test(int x, int y, int z)
 {
+  BRICKR_TRACE_SCOPE("AssemblyPlugin::test");
 
   if(x < 0 || y < 0 || z < 0)
   {
     std::cerr << "The test values must all be positive" << std::endl;
     return;
   }
+  if(x > LegoBrick::MAX_COORDINATE + 1 || y > LegoBrick::MAX_COORDINATE + 1 || z > LegoBrick::MAX_COORDINATE + 1)
+  {
+    std::cerr << "The test values must not exceed " << LegoBrick::MAX_COORDINATE + 1 << std::endl;
+    return;
+  }
 
-  legoCloudNode_ = std::make_shared<LegoCloudNode>();
+  setLegoCloudNode(std::make_shared<LegoCloudNode>());
 
   int height = y;
   int width = x;
@@ -65,16 +85,15 @@ void AssemblyPlugin::test(int x, int y, int z)
 
 void AssemblyPlugin::loadVoxelization(QString filename)
 {
+  BRICKR_TRACE_SCOPE("AssemblyPlugin::loadVoxelization");
   //No file selected
   if(filename == NULL)
     return;
 
-  legoCloudNode_ = std::make_shared<LegoCloudNode>();
+  setLegoCloudNode(std::make_shared<LegoCloudNode>());
 
 
-  std::cout << "Opening file: " << qPrintable(filename) << std::endl;
-  parseBinvox(filename.toStdString(), legoCloudNode_.get());
-  legoCloudNode_->getLegoCloud()->buildNeighbourhood();
+  LegoPipeline::loadVoxelization(filename, *legoCloudNode_->getLegoCloud());
 
   legoCloudNode_->nodeUpdated();
 
@@ -84,6 +103,35 @@ void AssemblyPlugin::loadVoxelization(QString filename)
     assemblyWidget_->setMaxLayerSpinBox(legoCloudNode_->getLegoCloud()->getLevelNumber());
 }
 
+bool AssemblyPlugin::loadProject(QString filename)
+{
+  BRICKR_TRACE_SCOPE("AssemblyPlugin::loadProject");
+  //No file selected
+  if(filename == NULL)
+    return false;
+
+  std::shared_ptr<LegoCloudNode> legoCloudNode = std::make_shared<LegoCloudNode>();
+
+  std::cout << "Opening project: " << qPrintable(filename) << std::endl;
+  QTime time;
+  time.start();
+
+  if(!legoCloudNode->getLegoCloud()->loadProject(filename))
+    return false;
+
+  std::cout << "  read " << legoCloudNode->getLegoCloud()->getBrickNumber() << " bricks in " << time.elapsed()/1000.0 << " seconds" << std::endl;
+
+  setLegoCloudNode(legoCloudNode);
+  legoCloudNode_->nodeUpdated();
+
+  emit geometryChanged();
+
+  if (assemblyWidget_)
+    assemblyWidget_->setMaxLayerSpinBox(legoCloudNode_->getLegoCloud()->getLevelNumber());
+
+  return true;
+}
+
 /*
 void AssemblyPlugin::loadObj(QString fileName)
 {
@@ -165,239 +213,16 @@ void AssemblyPlugin::removeAllMeshes()
 }
 */
 
-bool AssemblyPlugin::parseBinvox(const std::string& filename, LegoCloudNode* legoCloudNode)
-{
-  //Credit: http://www.google.com/search?q=binvox
-  typedef unsigned char byte;
-
-  int version;
-  int size;
-  float tx, ty, tz;
-  float scale;
-  int depth, width, height;
-  QFile colorFile(QString::fromStdString(filename)+".color");
-  QHash<int, int> colors;
-
-  std::ifstream input;
-  input.open(filename.c_str(),std::ios::binary);
-  if (!input.is_open())
-    return false;
-
-  // read header
-  std::string line;
-  input >> line;  // #binvox
-  if (line.compare("#binvox") != 0) {
-    std::cerr << "Error: first line reads [" << line.c_str() << "] instead of [#binvox]" << std::endl;
-    return false;
-  }
-
-  input >> version;
-  //cout << "reading binvox version " << version << endl;
-
-  depth = -1;
-  int done = 0;
-  while(input.good() && !done) {
-    input >> line;
-    if (line.compare("data") == 0) done = 1;
-    else if (line.compare("dim") == 0) {
-      input >> depth >> height >> width;
-    }
-    else if (line.compare("translate") == 0) {
-      input >> tx >> ty >> tz;
-    }
-    else if (line.compare("scale") == 0) {
-      input >> scale;
-    }
-    else {
-      std::cerr << "  unrecognized keyword [" << line.c_str() << "], skipping" << std::endl;
-      char c;
-      do {  // skip until end of line
-        c = input.get();
-      } while(input.good() && (c != '\n'));
-
-    }
-  }
-  if (!done) {
-    std::cerr << "  error reading header" << std::endl;
-    return false;
-  }
-  if (depth == -1) {
-    std::cerr << "  missing dimensions in header" << std::endl;
-    return false;
-  }
-
-  size = width * height * depth;
-  legoCloudNode->getLegoCloud()->setVoxelGridDimmension(height, width, depth);
-
-  if(colorFile.exists()) {
-    if(colorFile.open(QIODevice::ReadOnly)) {
-        QTextStream stream(&colorFile);
-
-        while(!stream.atEnd()) {
-            QString line = stream.readLine();
-            QStringList fields = line.split(";");
-            int key = fields[2].toInt() * width * height + fields[1].toInt() * width + fields[0].toInt();
-
-            colors.insert(key, fields[3].toInt());
-        }
-
-        qDebug() << colors;
-
-        colorFile.close();
-    }
-  }
-
-  //
-  // read voxel data
-  //
-  byte value;
-  byte count;
-  int index = 0;
-  int end_index = 0;
-  int nr_voxels = 0;
-
-  input.unsetf(std::ios::skipws);  // need to read every byte now (!)
-  input >> value;  // read the linefeed char
-
-  while((end_index < size) && input.good()) {
-    input >> value >> count;
-
-    if (input.good()) {
-      end_index = index + count;
-      if (end_index > size) { std::cerr << "binvox file invalid." << std::endl; return false; }
-
-      if (value)
-      {
-          for(int i=index; i < end_index; i++) {
-              int level = (i%(width*height))%height;
-              int y = ((i-level)%(width*height))/height;
-              int x = (i - level - y*height)/(width*height);
-              int key = level * width * height + y * width + x;
-
-              LegoBrick* brick = legoCloudNode->getLegoCloud()->addBrick(level, x, y);
-              if(colors.contains(key)) {
-                  brick->setColorId(colors.value(key));
-              }
-              legoCloudNode->getLegoCloud()->addVoxel(level, x, y, brick);
-          }
-          nr_voxels += count;
-      }
-      index = end_index;
-    }  // if file still ok
-
-  }  // while
-
-  input.close();
-  std::cout << "  read " << nr_voxels << " voxels" << std::endl;
-
-  return true;
-}
-
 QPair<float, QPair<int, int> > AssemblyPlugin::autoOptimize()
 {
+  BRICKR_TRACE_SCOPE("AssemblyPlugin::autoOptimize");
   if(!legoCloudNode_)
     return QPair<float, QPair<int, int> >();
 
-  LegoCloud* legoCloud = legoCloudNode_->getLegoCloud();
-
-//  progress::setNumberOfSteps(AUTO_OPTIMIZE_MAX_STEPS, "Optimizing...");
-//  progress::setProgress(0);
-
-  std::cout << "Optimization started, please wait..." << std::endl;
-  QTime time;
-  time.start();
-
-  //Step1: merge
-  legoCloud->merge();
-
-  int conCompNumber = legoCloud->getConCompNumber();
-  int minConCompNumber = conCompNumber;
-  int iterationCon = 0;
-  int totalConCompIter = 0;
-  int totalArtPointIter = 0;
-
-  //Step2: find the minimum number of connected components
-  while(iterationCon < AUTO_OPTIMIZE_MAX_STEPS*2 && (conCompNumber > 1 || conCompNumber > minConCompNumber))
-  {
-    legoCloud->splitConComp();
-    legoCloud->merge();
-    conCompNumber = legoCloud->getConCompNumber();
-
-    if(conCompNumber < minConCompNumber)
-      minConCompNumber = conCompNumber;
-
-    iterationCon++;
-    totalConCompIter++;
-  }
-
-  //std::cout << minConCompNumber << " " << legoCloud->getConCompNumber() << std::endl;
-
-  //Step3: reduce the bad articulation points then if the connected component number increase try to reduce it
-  int badArtPointNumber = legoCloud->getBadArtPointNumber();
-  int iterationBicon = 0;
-  while(badArtPointNumber > 0 && iterationBicon < AUTO_OPTIMIZE_MAX_STEPS)
-  {
-    legoCloud->splitBiconComp();
-    legoCloud->merge();
-    conCompNumber = legoCloud->getConCompNumber();
-    badArtPointNumber = legoCloud->getBadArtPointNumber();
-
-    if(conCompNumber < minConCompNumber)
-      minConCompNumber = conCompNumber;
-
-    iterationCon = 0;
-    while(conCompNumber > minConCompNumber && iterationCon < AUTO_OPTIMIZE_MAX_STEPS*2)
-    {
-      legoCloud->splitConComp();
-      legoCloud->merge();
-      conCompNumber = legoCloud->getConCompNumber();
-      badArtPointNumber = legoCloud->getBadArtPointNumber();
-
-      iterationCon++;
-      totalConCompIter++;
-    }
-
-    iterationBicon++;
-    totalArtPointIter++;
-//    progress::setProgress(iterationBicon);
-  }
-
-  //int end = QTime::currentTime().msec();
-
-  //std::cout << "conIter: " << totalConCompIter << ", artIter: " << totalArtPointIter << std::endl;
-
-  badArtPointNumber = legoCloud->getBadArtPointNumber();
-//  progress::finish();
-
+  const LegoPipeline::OptimizeResult result = LegoPipeline::autoOptimize(*legoCloudNode_->getLegoCloud());
   legoCloudNode_->nodeUpdated();
 
-  std::cout << "Optimization ended; results:" << std::endl;
-
-  std::cout << "Brick count: " << legoCloud->getBrickNumber() << std::endl;
-
-  if(conCompNumber == 1)
-  {
-    std::cout << "This model is fully connected." << std::endl;
-  }
-  else
-  {
-    std::cout << "   There are " << conCompNumber << " connected components." << std::endl;
-    std::cout << "   Warning, there are more than 1 connected component, this model will have disconnected pieces. Consider doing another optimization." << std::endl;
-  }
-
-  if(badArtPointNumber == 0)
-  {
-    std::cout << "There are no weak articulation points." << std::endl;
-  }
-  else
-  {
-    std::cout << "   There are " << badArtPointNumber << " weak articulation points." << std::endl;
-    std::cout << "   Warning, there are some weak articulation points in this model. Consider doing another optimization." << std::endl;
-  }
-
-  std::cout << "Time: " << time.elapsed()/1000.0 << " seconds." << std::endl;
-
-  return QPair<float, QPair<int, int> >(time.elapsed()/1000.0, QPair<int, int>(totalConCompIter, totalArtPointIter));
+  return QPair<float, QPair<int, int> >(result.seconds, QPair<int, int>(result.conCompIterations, result.artPointIterations));
 }
 
 void AssemblyPlugin::draw()
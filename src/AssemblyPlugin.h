@@ -22,6 +22,7 @@ public:
 
   void test(int x, int y, int z);
   void loadVoxelization(QString filename);
+  bool loadProject(QString filename);
   void loadObj(QString fileName);
   void loadTexture(QString fileName);
   void removeAllMeshes();
@@ -35,9 +36,11 @@ public:
 
 signals:
   void geometryChanged();
+  //Only the display changed, the view is kept
+  void sceneChanged();
 
 private:
-  bool parseBinvox(const std::string& filename, LegoCloudNode *legoCloudNode_);
+  void setLegoCloudNode(const std::shared_ptr<LegoCloudNode>& legoCloudNode);
 
   AssemblyWidget *assemblyWidget_;
   std::shared_ptr<LegoCloudNode> legoCloudNode_;
@@ -5,18 +5,56 @@
 
 #include <QFileDialog>
 #include <QGraphicsView>
-#include <QGraphicsScene>
 #include <QImage>
-#include <QSvgGenerator>
 #include <QtCore/QSettings>
 #include <QInputDialog>
 #include <QApplication>
-#include <QProcess>
 #include <QTextStream>
 #include <fstream>
 
+#include "InstructionRenderer.h"
+#include "InstructionWriter.h"
+#include "LegoPipeline.h"
+#include "VoxelCache.h"
+#include "Voxelizer.h"
+
 //#define STATISTICS
 
+namespace
+{
+
+//Asks for the binvox executable when it is not found
+class DialogVoxelizer : public Voxelizer
+{
+public:
+  explicit DialogVoxelizer(QWidget* parent)
+    : parent_(parent)
+  {
+  }
+
+protected:
+  QString locateBinvoxProgram()
+  {
+    const QString binvoxProgram = Voxelizer::locateBinvoxProgram();
+    if(!binvoxProgram.isEmpty())
+      return binvoxProgram;
+
+    //If it is not found in the last specified location; we ask the user
+    const QString binvoxFilePath = QFileDialog::getOpenFileName(parent_, "Locate binvox executable");
+    if(binvoxFilePath.isNull())
+      return QString();
+
+    QSettings settings;
+    settings.setValue("AssemblyPlugin::Binvox", binvoxFilePath);
+    return binvoxFilePath;
+  }
+
+private:
+  QWidget* parent_;
+};
+
+}
+
 AssemblyWidget::AssemblyWidget(AssemblyPlugin* _plugin, QWidget* _parent)
   : QWidget(_parent), Ui_AssemblyWidget(), plugin_(_plugin) {
 
@@ -44,7 +82,10 @@ void AssemblyWidget::on_testButton_pressed() {
     return;
 
   if(hollowCheckBox->isChecked())
+  {
     legoCloudNode->getLegoCloud()->preHollow(shellThicknessSpinBox->value());
+    legoCloudNode->nodeUpdated();
+  }
 }
 
 void AssemblyWidget::on_loadFileButton_pressed()
@@ -108,6 +149,8 @@ void AssemblyWidget::on_loadFileButton_pressed()
 
         statFileTextStream << autoOptimizeResult.second.second << "\t";
 
+        statFileTextStream << legoCloudNode->getLegoCloud()->getSeed() << "\t";
+
         statFileTextStream << "\n";
 
         statFileTextStream.flush();
@@ -133,7 +176,7 @@ void AssemblyWidget::on_loadFileButton_pressed()
 
   //We now check if the extension is a mesh
   QFileInfo selectedFileinfo(selectedFilePath);
-  if(isMeshExtensionSupported(selectedFileinfo.suffix()))
+  if(Voxelizer::isMeshExtensionSupported(selectedFileinfo.suffix()))
   {
     bool ok;
     int voxelizationResolution = QInputDialog::getInt(qApp->activeWindow(), "Voxelization resolution",
@@ -202,8 +245,6 @@ void AssemblyWidget::on_layerSpinBox_valueChanged(int _value){
 
   legoCloudNode->setRenderLayer(_value);
   legoCloudNode->nodeUpdated();
-
-  //legoCloudNode->drawInstructions(&scene_);
 }
 
 
@@ -257,7 +298,6 @@ void AssemblyWidget::on_randomRadioButton_toggled(bool checked)
       return;
 
     legoCloudNode->setColorRendering(LegoCloudNode::Random);
-    legoCloudNode->nodeUpdated();
   }
 }
 
@@ -270,7 +310,6 @@ void AssemblyWidget::on_realColorRadioButton_toggled(bool checked)
       return;
 
     legoCloudNode->setColorRendering(LegoCloudNode::RealColor);
-    legoCloudNode->nodeUpdated();
   }
 }
 
@@ -283,7 +322,6 @@ void AssemblyWidget::on_conRadioButton_toggled(bool checked)
       return;
 
     legoCloudNode->setColorRendering(LegoCloudNode::ConnectedComp);
-    legoCloudNode->nodeUpdated();
   }
 }
 
@@ -296,7 +334,6 @@ void AssemblyWidget::on_biconRadioButton_toggled(bool checked)
       return;
 
     legoCloudNode->setColorRendering(LegoCloudNode::BiconnectedComp);
-    legoCloudNode->nodeUpdated();
   }
 }
 
@@ -359,7 +396,7 @@ void AssemblyWidget::on_saveInstructionsButton_pressed()
   QSettings settings;
   QString lastSavedFile = settings.value("AssemblyPlugin::SaveInstruction", "").toString();
 
-  QString filePathBase = QFileDialog::getSaveFileName(this, "Save instructions (.png .jpg or .svg)", lastSavedFile, "Images (*.png *.jpg *.svg)");
+  QString filePathBase = QFileDialog::getSaveFileName(this, "Save instructions (.png .jpg .svg or .pdf)", lastSavedFile, "Images (*.png *.jpg *.svg);;Pdf (*.pdf)");
   if(filePathBase == NULL)
   {
     //User canceled
@@ -369,67 +406,113 @@ void AssemblyWidget::on_saveInstructionsButton_pressed()
   settings.setValue("AssemblyPlugin::SaveInstruction", filePathBase);
 
   QFileInfo fileInfo(filePathBase);
-  bool useSVG = fileInfo.suffix().compare("svg", Qt::CaseInsensitive) == 0;
-
-  const int BRICK_PIXEL_SIZE = 20;
-
-  QGraphicsScene scene;
-
-//  progress::setNumberOfSteps(legoCloudNode->getLegoCloud()->getLevelNumber(), "Saving instructions...");
-//  progress::setProgress(0);
-
-  for(int level = 0; level < legoCloudNode->getLegoCloud()->getLevelNumber(); level++)
+  bool ok = true;
+  if(fileInfo.suffix().compare("pdf", Qt::CaseInsensitive) == 0)
   {
-    legoCloudNode->setRenderLayer(level);
-    legoCloudNode->drawInstructions(&scene, !useSVG);
-
-    int imageSizeX = legoCloudNode->getLegoCloud()->getWidth()*BRICK_PIXEL_SIZE;
-    int imageSizeY = legoCloudNode->getLegoCloud()->getDepth()*BRICK_PIXEL_SIZE;
+    InstructionWriter writer(*legoCloudNode->getLegoCloud());
+    ok = writer.writePdf(filePathBase);
+  }
+  else if(fileInfo.suffix().compare("svg", Qt::CaseInsensitive) == 0)
+  {
+    InstructionWriter writer(*legoCloudNode->getLegoCloud());
+    ok = writer.writeSvgLevels(filePathBase);
+  }
+  else
+  {
+    InstructionRenderer renderer(*legoCloudNode->getLegoCloud());
+    ok = renderer.saveLevels(filePathBase);
+  }
 
-    QString filePathLevel = fileInfo.absolutePath() + "/" + fileInfo.baseName() + "_" + QString::number(level) + "." + fileInfo.completeSuffix();
-    std::cout << "Saving: " << filePathLevel.toStdString().c_str() << std::endl;
+  if(!ok)
+    std::cerr << "Some instruction pages could not be saved" << std::endl;
+}
 
-    if(useSVG)
-    {
-      QSvgGenerator svgGen;
+void AssemblyWidget::on_objExportButton_pressed()
+{
+  LegoCloudNode* legoCloudNode = plugin_->getLegoCloudNode();
+  if(!legoCloudNode)
+    return;
 
-      svgGen.setFileName(filePathLevel);
-      svgGen.setSize(QSize(imageSizeX, imageSizeY));
-      svgGen.setViewBox(QRect(0, 0, imageSizeX, imageSizeY));
+  const QString objFilter = "Obj (*.obj)";
+  const QString instancedObjFilter = "Instanced obj (*.obj)";
+  const QString plyFilter = "Ply (*.ply)";
+  const QString stlFilter = "Stl (*.stl)";
 
-      QPainter painter( &svgGen );
-      scene.render( &painter );
-    }
-    else
-    {
-      QImage image(QSize(imageSizeX, imageSizeY), QImage::Format_ARGB32_Premultiplied);
-      image.fill(QColor("White"));
-      QPainter painter(&image);
-      painter.setRenderHint(QPainter::Antialiasing);
-      scene.render(&painter);
-      image.save(filePathLevel);
-    }
+  QString selectedFilter = objFilter;
+  QString filename = QFileDialog::getSaveFileName(this, "Save as", "", objFilter + ";;" + instancedObjFilter + ";;" + plyFilter + ";;" + stlFilter, &selectedFilter);
 
-//    progress::setProgress(level);
+  if(filename.isNull())
+  {
+    return;
   }
 
-//  progress::finish();
+  LegoExporter::Options options;
+  options.outerOnly = outerOnlyExportBox->isChecked();
+  options.cullHidden = cullHiddenExportBox->isChecked();
+  if(selectedFilter == instancedObjFilter)
+    options.format = LegoExporter::InstancedObj;
+  else if(selectedFilter == plyFilter)
+    options.format = LegoExporter::Ply;
+  else if(selectedFilter == stlFilter)
+    options.format = LegoExporter::Stl;
+  else
+    options.format = LegoExporter::formatFromFileName(filename);
+
+  if(!legoCloudNode->exportMesh(filename, options))
+    std::cerr << "Export failed: " << qPrintable(filename) << std::endl;
 }
 
-void AssemblyWidget::on_objExportButton_pressed()
+void AssemblyWidget::on_saveProjectButton_pressed()
 {
   LegoCloudNode* legoCloudNode = plugin_->getLegoCloudNode();
   if(!legoCloudNode)
     return;
 
-  QString filename = QFileDialog::getSaveFileName(this, "Save as", "", "Obj (*.obj)");
+  QSettings settings;
+  QString lastProjectFile = settings.value("AssemblyPlugin::ProjectFile", "").toString();
 
+  QString filename = QFileDialog::getSaveFileName(this, "Save project", lastProjectFile, "Brickr project (*.brickr)");
   if(filename.isNull())
   {
     return;
   }
 
-  legoCloudNode->exportToObj(filename);
+  settings.setValue("AssemblyPlugin::ProjectFile", filename);
+
+  if(legoCloudNode->getLegoCloud()->saveProject(filename))
+    std::cout << "Project saved: " << qPrintable(filename) << std::endl;
+}
+
+void AssemblyWidget::on_loadProjectButton_pressed()
+{
+  QSettings settings;
+  QString lastProjectFile = settings.value("AssemblyPlugin::ProjectFile", "").toString();
+
+  QString filename = QFileDialog::getOpenFileName(this, "Open project", lastProjectFile, "Brickr project (*.brickr)");
+  if(filename.isNull())
+  {
+    return;
+  }
+
+  settings.setValue("AssemblyPlugin::ProjectFile", filename);
+
+  if(!plugin_->loadProject(filename))
+    return;
+
+  //resetUi() pushes its spin box values to the cloud, so the loaded limits are restored afterwards
+  const QMap<BrickSize, int> brickLimits = plugin_->getLegoCloudNode()->getLegoCloud()->getBrickLimits();
+  resetUi();
+
+  spinBox1x2->setValue(brickLimits.value(BrickSize(1, 2), -1));
+  spinBox1x3->setValue(brickLimits.value(BrickSize(1, 3), -1));
+  spinBox1x4->setValue(brickLimits.value(BrickSize(1, 4), -1));
+  spinBox1x6->setValue(brickLimits.value(BrickSize(1, 6), -1));
+  spinBox1x8->setValue(brickLimits.value(BrickSize(1, 8), -1));
+  spinBox2x2->setValue(brickLimits.value(BrickSize(2, 2), -1));
+  spinBox2x3->setValue(brickLimits.value(BrickSize(2, 3), -1));
+  spinBox2x4->setValue(brickLimits.value(BrickSize(2, 4), -1));
+  spinBox2x6->setValue(brickLimits.value(BrickSize(2, 6), -1));
+  spinBox2x8->setValue(brickLimits.value(BrickSize(2, 8), -1));
 }
 
 void AssemblyWidget::on_printStatsButton_pressed()
@@ -453,9 +536,8 @@ void AssemblyWidget::on_finalizeButton_pressed()
     return;
 
 
-  legoCloudNode->getLegoCloud()->postHollow();
-  legoCloudNode->getLegoCloud()->solveBrickNumberLimitation();
-  legoCloudNode->getLegoCloud()->merge();
+  LegoPipeline::finalize(*legoCloudNode->getLegoCloud());
+  legoCloudNode->nodeUpdated();
 
   std::cout << "Finalization done, the instructions can be saved." << std::endl;
 }
@@ -547,7 +629,7 @@ void AssemblyWidget::resetUi()
 
 void AssemblyWidget::loadFile(const QString &filePath, int voxelizationResolution)
 {
-  QFileInfo selectedFileinfo(filePath), scaledFileinfo(filePath);
+  QFileInfo selectedFileinfo(filePath);
 
   if(!selectedFileinfo.exists() || !selectedFileinfo.isReadable())
   {
@@ -556,99 +638,17 @@ void AssemblyWidget::loadFile(const QString &filePath, int voxelizationResolutio
   }
 
   QString binvoxFilePath;
-  if(isMeshExtensionSupported(selectedFileinfo.suffix()))
+  if(Voxelizer::isMeshExtensionSupported(selectedFileinfo.suffix()))
   {
-    QString scaledFilePath = selectedFileinfo.absolutePath() + "/_" +selectedFileinfo.baseName() + "_scaled.obj";
-
-    {
-      QFile scaledFile(scaledFilePath);
-      scaledFile.remove();
-    }
-    scaleMesh(filePath, scaledFilePath);
-    scaledFileinfo = QFileInfo(scaledFilePath);
-
     assert(voxelizationResolution > 0);
-    binvoxFilePath = selectedFileinfo.absolutePath() + "/"+selectedFileinfo.baseName()+QString::number(voxelizationResolution) + ".binvox";
-    QFile binvoxFile(binvoxFilePath);
+    binvoxFilePath = Voxelizer::binvoxFilePath(filePath, voxelizationResolution);
 
-    if (binvoxFile.exists())
-    {
-      //We make sure that binvoxFilePath does not exist
-      std::cout << "Removing file: " << qPrintable(binvoxFilePath) << std::endl;
-      binvoxFile.remove();
-    }
-
-    //First we try to find it in its default location
-#ifdef WIN32
-    QFileInfo binvoxProgramFileInfo(QCoreApplication::applicationDirPath() + "/binvox.exe");
-#else
-    QFileInfo binvoxProgramFileInfo(QCoreApplication::applicationDirPath() + "/../Resources/binvox");
-#endif
-//    std::cout << qPrintable(QCoreApplication::applicationFilePath()) << std::endl;
-
-    if(!binvoxProgramFileInfo.exists())
-    {
-      QSettings settings;
-      binvoxProgramFileInfo.setFile(settings.value("AssemblyPlugin::Binvox", "").toString());
-
-      //If it is not in the default location, we try from the last specified location
-      if(!binvoxProgramFileInfo.exists())
-      {
-        //If it is not found in the last specified location; we ask the user
-        QString binvoxFilePath = QFileDialog::getOpenFileName(this, "Locate binvox executable");
-        if(binvoxFilePath.isNull())
-        {
-          std::cerr << "The binvox executable was not found." << std::endl;
-          return;
-        }
-
-        settings.setValue("AssemblyPlugin::Binvox", binvoxFilePath);
-
-
-        binvoxProgramFileInfo.setFile(binvoxFilePath);
-        assert(binvoxProgramFileInfo.exists());
-      }
-    }
-
-    //We first check that the following file does not exist or we remove it (otherwise the binvox program will rename the output file)
-    QFile binvoxProgramOutputFile(scaledFileinfo.absolutePath()+"/"+scaledFileinfo.baseName()+".binvox");
-
-    if(binvoxProgramOutputFile.exists())
-    {
-      std::cout << "Removing file: " << qPrintable(binvoxProgramOutputFile.fileName()) << std::endl;
-      assert(binvoxProgramOutputFile.remove());
-    }
-
-#ifdef WIN32
-    QString command("\"" + binvoxProgramFileInfo.absoluteFilePath() + "\" -d "+ QString::number(voxelizationResolution) + " \"" + scaledFilePath + "\"");
-#else
-    QString command("\"" + binvoxProgramFileInfo.absoluteFilePath()+ "\" -pb -d "+ QString::number(voxelizationResolution) + " \"" +scaledFilePath + "\"");
-#endif
-//    QString command(binvoxProgramFileInfo.absoluteFilePath()+ " -d "+ QString::number(voxelizationResolution) + " " +filePath);
-    std::cout << "Running " << qPrintable(command) << std::endl;
-
-
-    QProcess process;
-    process.start(command);
-    process.waitForFinished(-1); // will wait forever until finished
-
-//    std::cout << process.readAllStandardOutput().data() << std::endl;
-    std::cerr << process.readAllStandardError().data() << std::endl;
-
-    if(!binvoxProgramOutputFile.exists())
-    {
-      std::cerr << "The file could not be voxelized with binvox. The format is probably not correctly handled by binvox or the software does not have administrative rights." << std::endl;
+    QSettings settings;
+    VoxelCache voxelCache(settings.value("AssemblyPlugin::VoxelCacheDir", VoxelCache::defaultCacheDir()).toString(),
+                          settings.value("AssemblyPlugin::VoxelCacheSizeMB", VoxelCache::DEFAULT_MAX_BYTES/(1024*1024)).toLongLong()*1024*1024);
+    DialogVoxelizer voxelizer(this);
+    if(!voxelizer.voxelize(filePath, voxelizationResolution, binvoxFilePath, &voxelCache))
       return;
-    }
-
-    binvoxProgramOutputFile.rename(binvoxFile.fileName());
-
-    {
-      QFile scaledFile(scaledFilePath);
-      scaledFile.remove();
-    }
-
-    assert(binvoxFile.exists());
   }
   else
   {
@@ -663,55 +663,12 @@ void AssemblyWidget::loadFile(const QString &filePath, int voxelizationResolutio
     return;
 
   if(hollowCheckBox->isChecked())
+  {
     legoCloudNode->getLegoCloud()->preHollow(shellThicknessSpinBox->value());
-}
-
-bool AssemblyWidget::isMeshExtensionSupported(const QString &extension) const
-{
-  return extension.compare("obj", Qt::CaseInsensitive) == 0;// ||
-//      extension.compare("off", Qt::CaseInsensitive) == 0 ||
-//      extension.compare("stl", Qt::CaseInsensitive) == 0 ||
-//      extension.compare("ply", Qt::CaseInsensitive) == 0 ||
-//      extension.compare("dxf", Qt::CaseInsensitive) == 0;
-}
-
-void AssemblyWidget::scaleMesh(const QString &filePath, const QString &scaledFilePath)
-{
-  QFile infile(filePath);
-  if (!infile.open(QFile::ReadOnly))
-    return;
-
-  QFile outfile(scaledFilePath);
-  if (!outfile.open(QFile::WriteOnly | QFile::Truncate))
-    return;
-
-  QTextStream in(&infile);
-  QTextStream out(&outfile);
-
-  while (!in.atEnd()) {
-    QString input = in.readLine();
-    if (input.isEmpty() || input[0] == '#')
-      continue;
-
-    QTextStream ts(&input);
-    QString id;
-    ts >> id;
-    if (id == "v") {
-      Vector3 p;
-      for (int i = 0; i < 3; ++i) {
-        ts >> p[i];
-      }
-      out << "v " << p[0] << " " << 0.83333333*p[1] << " " << p[2] << "\n";
-    } else {
-      out << input << "\n";
-    }
+    legoCloudNode->nodeUpdated();
   }
-
-  infile.close();
-  outfile.close();
 }
 
-
 void AssemblyWidget::setBrickLimit(BrickSize size, int value)
 {
   LegoCloudNode* legoCloudNode = plugin_->getLegoCloudNode();
@@ -44,6 +44,8 @@ private slots:
 
   void on_saveInstructionsButton_pressed();
   void on_objExportButton_pressed();
+  void on_saveProjectButton_pressed();
+  void on_loadProjectButton_pressed();
 
   void on_printStatsButton_pressed();
 
@@ -70,8 +72,6 @@ private:
   void setBrickLimit(BrickSize size, int value);
   void resetUi();
   void loadFile(const QString& filePath, int voxelizationResolution = 0);
-  bool isMeshExtensionSupported(const QString& extension) const;
-  void scaleMesh(const QString &filePath, const QString &scaledFilePath);
 
   AssemblyPlugin *plugin_;
 };
@@ -0,0 +1,158 @@
+#include "BinvoxParser.h"
+
+#include "LegoCloud.h"
+
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QTextStream>
+
+#include <climits>
+#include <fstream>
+#include <iostream>
+
+bool BinvoxParser::parse(const std::string& filename, LegoCloud& legoCloud)
+{
+  //Credit: http://www.google.com/search?q=binvox
+  typedef unsigned char byte;
+
+  int version;
+  int size;
+  float tx, ty, tz;
+  float scale;
+  int depth, width, height;
+  QFile colorFile(QString::fromStdString(filename)+".color");
+  QHash<int, int> colors;
+
+  std::ifstream input;
+  input.open(filename.c_str(),std::ios::binary);
+  if (!input.is_open())
+    return false;
+
+  // read header
+  std::string line;
+  input >> line;  // #binvox
+  if (line.compare("#binvox") != 0) {
+    std::cerr << "Error: first line reads [" << line.c_str() << "] instead of [#binvox]" << std::endl;
+    return false;
+  }
+
+  input >> version;
+  //cout << "reading binvox version " << version << endl;
+
+  depth = -1;
+  int done = 0;
+  while(input.good() && !done) {
+    input >> line;
+    if (line.compare("data") == 0) done = 1;
+    else if (line.compare("dim") == 0) {
+      input >> depth >> height >> width;
+    }
+    else if (line.compare("translate") == 0) {
+      input >> tx >> ty >> tz;
+    }
+    else if (line.compare("scale") == 0) {
+      input >> scale;
+    }
+    else {
+      std::cerr << "  unrecognized keyword [" << line.c_str() << "], skipping" << std::endl;
+      char c;
+      do {  // skip until end of line
+        c = input.get();
+      } while(input.good() && (c != '\n'));
+
+    }
+  }
+  if (!done) {
+    std::cerr << "  error reading header" << std::endl;
+    return false;
+  }
+  if (depth == -1) {
+    std::cerr << "  missing dimensions in header" << std::endl;
+    return false;
+  }
+
+  //Voxel coordinates are stored on 16 bits in LegoBrick, and the voxel index is an int
+  const int maxDimension = LegoBrick::MAX_COORDINATE + 1;
+  if (depth <= 0 || width <= 0 || height <= 0 || depth > maxDimension || width > maxDimension || height > maxDimension
+      || qint64(width) * height * depth > INT_MAX) {
+    std::cerr << "  unsupported dimensions " << depth << "x" << height << "x" << width << std::endl;
+    return false;
+  }
+
+  size = width * height * depth;
+  legoCloud.setVoxelGridDimmension(height, width, depth);
+
+  if(colorFile.exists()) {
+    if(colorFile.open(QIODevice::ReadOnly)) {
+        QTextStream stream(&colorFile);
+
+        int invalidColors = 0;
+        while(!stream.atEnd()) {
+            QString line = stream.readLine();
+            QStringList fields = line.split(";");
+
+            //Unknown color ids keep the default color
+            bool ok = fields.size() >= 4;
+            const int colorId = ok ? fields[3].toInt(&ok) : 0;
+            if(!ok || colorId < 0 || colorId >= legoCloud.getLegalColor().size() || colorId > LegoBrick::MAX_COLOR_ID) {
+                invalidColors++;
+                continue;
+            }
+            int key = (fields[2].toInt() * width + fields[1].toInt()) * depth + fields[0].toInt();
+            colors.insert(key, colorId);
+        }
+
+        std::cout << "  read " << colors.size() << " voxel colors" << std::endl;
+        if(invalidColors > 0)
+            std::cerr << "  ignored " << invalidColors << " invalid voxel colors" << std::endl;
+
+        colorFile.close();
+    }
+  }
+
+  //
+  // read voxel data
+  //
+  byte value;
+  byte count;
+  int index = 0;
+  int end_index = 0;
+  int nr_voxels = 0;
+
+  input.unsetf(std::ios::skipws);  // need to read every byte now (!)
+  input >> value;  // read the linefeed char
+
+  while((end_index < size) && input.good()) {
+    input >> value >> count;
+
+    if (input.good()) {
+      end_index = index + count;
+      if (end_index > size) { std::cerr << "binvox file invalid." << std::endl; return false; }
+
+      if (value)
+      {
+          for(int i=index; i < end_index; i++) {
+              int level = (i%(width*height))%height;
+              int y = ((i-level)%(width*height))/height;
+              int x = (i - level - y*height)/(width*height);
+              int key = (level * width + y) * depth + x;//x < depth, y < width: unique for any grid shape
+
+              LegoBrick* brick = legoCloud.addBrick(level, x, y);
+              if(colors.contains(key)) {
+                  brick->setColorId(colors.value(key));
+              }
+              legoCloud.addVoxel(level, x, y, brick);
+          }
+          nr_voxels += count;
+      }
+      index = end_index;
+    }  // if file still ok
+
+  }  // while
+
+  input.close();
+  std::cout << "  read " << nr_voxels << " voxels" << std::endl;
+
+  return true;
+}
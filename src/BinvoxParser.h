@@ -0,0 +1,17 @@
+#ifndef BINVOX_PARSER_H
+#define BINVOX_PARSER_H
+
+#include <string>
+
+class LegoCloud;
+
+//Reader of binvox voxelizations (run-length encoded occupancy), every filled voxel becomes a 1x1 brick.
+//The optional "<file>.color" sidecar gives the color id of voxels, one "x;y;level;colorId" line each.
+class BinvoxParser
+{
+public:
+  //The voxel grid dimensions of the cloud are set from the header, the neighbourhood is not built
+  static bool parse(const std::string& filename, LegoCloud& legoCloud);
+};
+
+#endif // BINVOX_PARSER_H
@@ -0,0 +1,30 @@
+#ifndef BRICKR_H
+#define BRICKR_H
+
+//Public API of the engine library (libbrickr): include this header and link with libbrickr.pri.
+//Only QtCore is needed. Rendering (instructions, previews) and the GUI are not part of the library.
+
+#define BRICKR_VERSION_MAJOR 1
+#define BRICKR_VERSION_MINOR 0
+#define BRICKR_VERSION_PATCH 0
+#define BRICKR_VERSION_STR "1.0.0"
+
+#include "LegoDimensions.h"
+#include "Vector3.h"
+#include "LegoBrick.h"
+#include "LegoGraph.h"
+#include "LegoCloud.h"
+#include "LegoMesher.h"
+#include "LegoExporter.h"
+#include "LegoPipeline.h"
+#include "LegoOperationLog.h"
+#include "LegoRandom.h"
+#include "BinvoxParser.h"
+#include "ObjParser.h"
+#include "EngineCounters.h"
+#include "ProcessStats.h"
+#include "Trace.h"
+#include "VoxelCache.h"
+#include "Voxelizer.h"
+
+#endif // BRICKR_H
@@ -0,0 +1,116 @@
+#include "EngineCounters.h"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+struct CounterBlock
+{
+  CounterBlock()
+  {
+    for(int i = 0; i < EngineCounters::COUNTER_NUMBER; i++)
+      values[i] = 0;
+  }
+
+  std::atomic<qint64> values[EngineCounters::COUNTER_NUMBER];
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<CounterBlock> > counterBlocks;//Never freed: the counts of finished threads are kept
+
+const char* counterNames[EngineCounters::COUNTER_NUMBER] =
+{
+  "canMergeCalls",
+  "canMergeRejectedShape",
+  "canMergeRejectedSize",
+  "canMergeRejectedColor",
+  "canMergeRejectedLimit",
+  "findBestNeighbourCalls",
+  "mergeDraws",
+  "mergeFailedDraws",
+  "merges",
+  "splits",
+  "cuts",
+  "cutEvaluations",
+  "canRemoveBrickCalls",
+  "canRemoveBrickAccepted",
+  "hollowFailedDraws",
+  "subgraphBuilds",
+  "subgraphVertices",
+  "subgraphEdges"
+};
+
+double ratio(qint64 numerator, qint64 denominator)
+{
+  return denominator > 0 ? double(numerator)/denominator : 0.0;
+}
+
+}
+
+thread_local std::atomic<qint64>* EngineCounters::threadValues_ = NULL;
+
+EngineCounters::Snapshot::Snapshot()
+{
+  for(int i = 0; i < COUNTER_NUMBER; i++)
+    values[i] = 0;
+}
+
+EngineCounters::Snapshot EngineCounters::Snapshot::operator-(const Snapshot& other) const
+{
+  Snapshot difference;
+  for(int i = 0; i < COUNTER_NUMBER; i++)
+    difference.values[i] = values[i] - other.values[i];
+  return difference;
+}
+
+std::atomic<qint64>* EngineCounters::registerThread()
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  counterBlocks.push_back(std::unique_ptr<CounterBlock>(new CounterBlock()));
+  return counterBlocks.back()->values;
+}
+
+EngineCounters::Snapshot EngineCounters::snapshot()
+{
+  Snapshot snapshot;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for(size_t block = 0; block < counterBlocks.size(); block++)
+  {
+    for(int i = 0; i < COUNTER_NUMBER; i++)
+      snapshot.values[i] += counterBlocks[block]->values[i].load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+void EngineCounters::reset()
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for(size_t block = 0; block < counterBlocks.size(); block++)
+  {
+    for(int i = 0; i < COUNTER_NUMBER; i++)
+      counterBlocks[block]->values[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+const char* EngineCounters::name(Counter counter)
+{
+  return counterNames[counter];
+}
+
+void EngineCounters::print(std::ostream& stream, const Snapshot& snapshot)
+{
+  for(int i = 0; i < COUNTER_NUMBER; i++)
+    stream << "  " << counterNames[i] << ": " << snapshot.values[i] << std::endl;
+
+  const qint64 rejected = snapshot[CanMergeRejectedShape] + snapshot[CanMergeRejectedSize] + snapshot[CanMergeRejectedColor] + snapshot[CanMergeRejectedLimit];
+  stream << "  canMerge rejection rate: " << ratio(rejected, snapshot[CanMergeCalls])*100.0 << "%" << std::endl;
+  stream << "  merge failed draw rate: " << ratio(snapshot[MergeFailedDraws], snapshot[MergeDraws])*100.0 << "%" << std::endl;
+  stream << "  canRemoveBrick acceptance rate: " << ratio(snapshot[CanRemoveBrickAccepted], snapshot[CanRemoveBrickCalls])*100.0 << "%" << std::endl;
+  stream << "  hollow failed draw rate: " << ratio(snapshot[HollowFailedDraws], snapshot[CanRemoveBrickCalls])*100.0 << "%" << std::endl;
+  stream << "  mean subgraph: " << ratio(snapshot[SubgraphVertices], snapshot[SubgraphBuilds]) << " vertices, "
+         << ratio(snapshot[SubgraphEdges], snapshot[SubgraphBuilds]) << " edges" << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef ENGINE_COUNTERS_H
+#define ENGINE_COUNTERS_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <iosfwd>
+
+//Always-on event counters of the engine inner loops (merge, split, cut, hollow).
+//Each thread increments its own block with relaxed loads and stores (no locked instruction);
+//snapshot() sums the blocks of all the threads.
+//The counts are process wide and only grow, diff two snapshots to measure an operation.
+class EngineCounters
+{
+public:
+  enum Counter
+  {
+    CanMergeCalls,
+    CanMergeRejectedShape,//The two bricks do not form a rectangle
+    CanMergeRejectedSize,//No brick of that size
+    CanMergeRejectedColor,
+    CanMergeRejectedLimit,
+    FindBestNeighbourCalls,
+    MergeDraws,//Random bricks drawn by merge
+    MergeFailedDraws,//Drawn bricks that could not merge with any neighbour
+    Merges,
+    Splits,
+    Cuts,
+    CutEvaluations,//Cuts tried by findBestCut
+    CanRemoveBrickCalls,
+    CanRemoveBrickAccepted,
+    HollowFailedDraws,//Random inner bricks drawn by postHollow that could not be removed
+    SubgraphBuilds,//Local subgraphs of canRemoveBrick and findBestCut
+    SubgraphVertices,
+    SubgraphEdges,
+    COUNTER_NUMBER
+  };
+
+  struct Snapshot
+  {
+    Snapshot();
+
+    qint64 values[COUNTER_NUMBER];
+
+    inline qint64 operator[](Counter counter) const {return values[counter];}
+    Snapshot operator-(const Snapshot& other) const;
+  };
+
+  static inline void add(Counter counter, qint64 value = 1)
+  {
+    if(!threadValues_)
+      threadValues_ = registerThread();
+    std::atomic<qint64>& counterValue = threadValues_[counter];
+    counterValue.store(counterValue.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);//Only this thread writes
+  }
+
+  static Snapshot snapshot();
+  //Only while the engine is idle
+  static void reset();
+
+  //lowerCamelCase, used as JSON keys
+  static const char* name(Counter counter);
+
+  //Counts followed by the acceptance and failure rates
+  static void print(std::ostream& stream, const Snapshot& snapshot);
+
+private:
+  static std::atomic<qint64>* registerThread();
+
+  static thread_local std::atomic<qint64>* threadValues_;
+};
+
+#endif // ENGINE_COUNTERS_H
@@ -0,0 +1,117 @@
+#include "InstructionRenderer.h"
+
+#include "LegoCloud.h"
+#include "LegoDimensions.h"
+
+#include <QAtomicInt>
+#include <QFileInfo>
+#include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <iostream>
+
+namespace
+{
+
+class LevelJob : public QRunnable
+{
+public:
+  LevelJob(const InstructionRenderer& renderer, int level, bool hintLayerBelow, const QString& filePath, QAtomicInt& failures)
+    : renderer_(renderer), level_(level), hintLayerBelow_(hintLayerBelow), filePath_(filePath), failures_(failures)
+  {
+  }
+
+  void run()
+  {
+    const QImage image = renderer_.renderLevel(level_, hintLayerBelow_);
+    if(!image.save(filePath_))
+    {
+      std::cerr << "Unable to save: " << qPrintable(filePath_) << std::endl;
+      failures_.ref();
+    }
+  }
+
+private:
+  const InstructionRenderer& renderer_;
+  int level_;
+  bool hintLayerBelow_;
+  QString filePath_;
+  QAtomicInt& failures_;
+};
+
+}
+
+InstructionRenderer::InstructionRenderer(const LegoCloud& legoCloud, int brickPixelSize)
+  : legoCloud_(legoCloud), brickPixelSize_(brickPixelSize), knobStamp_(brickPixelSize, brickPixelSize, QImage::Format_ARGB32_Premultiplied)
+{
+  //The knob outline is the only antialiased primitive, render it once
+  knobStamp_.fill(Qt::transparent);
+  QPainter painter(&knobStamp_);
+  painter.setRenderHint(QPainter::Antialiasing);
+
+  const double knobRadius = LEGO_KNOB_RADIUS / LEGO_KNOB_DISTANCE;
+  painter.drawEllipse(QRectF((0.5 - knobRadius)*brickPixelSize_, (0.5 - knobRadius)*brickPixelSize_, 2.0*knobRadius*brickPixelSize_, 2.0*knobRadius*brickPixelSize_));
+}
+
+QImage InstructionRenderer::renderLevel(int level, bool hintLayerBelow) const
+{
+  QImage image(legoCloud_.getWidth()*brickPixelSize_, legoCloud_.getDepth()*brickPixelSize_, QImage::Format_ARGB32_Premultiplied);
+  image.fill(QColor(Qt::white).rgba());
+
+  QPainter painter(&image);
+  painter.setPen(QPen(Qt::black, 0));//Cosmetic, as the scene items were
+
+  const LegoBrickList& bricks = legoCloud_.getBricks(level);
+  for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+  {
+    const Color3& color = legoCloud_.getLegalColor()[brick->getColorId()];
+    painter.setBrush(QColor(color[0]*255, color[1]*255, color[2]*255));
+    painter.drawRect(brick->getPosX()*brickPixelSize_, brick->getPosY()*brickPixelSize_, brick->getSizeX()*brickPixelSize_, brick->getSizeY()*brickPixelSize_);
+
+    for(int x = 0; x < brick->getSizeX(); ++x)
+    {
+      for(int y = 0; y < brick->getSizeY(); ++y)
+      {
+        painter.drawImage((brick->getPosX() + x)*brickPixelSize_, (brick->getPosY() + y)*brickPixelSize_, knobStamp_);
+      }
+    }
+  }
+
+  //Draw the underneath layer (if there is one)
+  if(level >= 1 && hintLayerBelow)
+  {
+    const QBrush hintBrush(QColor(0, 0, 0, 200), Qt::Dense5Pattern);
+    const LegoBrickList& bricksBelow = legoCloud_.getBricks(level-1);
+    for(LegoBrickList::const_iterator brick = bricksBelow.constBegin(); brick != bricksBelow.constEnd(); brick++)
+    {
+      painter.fillRect(brick->getPosX()*brickPixelSize_, brick->getPosY()*brickPixelSize_, brick->getSizeX()*brickPixelSize_, brick->getSizeY()*brickPixelSize_, hintBrush);
+    }
+  }
+
+  return image;
+}
+
+bool InstructionRenderer::saveLevels(const QString& filePathBase, bool hintLayerBelow, int threadCount) const
+{
+  QThreadPool pool;
+  if(threadCount > 0)
+    pool.setMaxThreadCount(threadCount);
+
+  QAtomicInt failures(0);
+  for(int level = 0; level < legoCloud_.getLevelNumber(); level++)
+  {
+    const QString filePathLevel = levelFilePath(filePathBase, level);
+    std::cout << "Saving: " << qPrintable(filePathLevel) << std::endl;
+    pool.start(new LevelJob(*this, level, hintLayerBelow, filePathLevel, failures));//Deleted by the pool
+  }
+  pool.waitForDone();
+
+  return failures.fetchAndAddRelaxed(0) == 0;
+}
+
+QString InstructionRenderer::levelFilePath(const QString& filePathBase, int level)
+{
+  const QFileInfo fileInfo(filePathBase);
+  return fileInfo.absolutePath() + "/" + fileInfo.baseName() + "_" + QString::number(level) + "." + fileInfo.completeSuffix();
+}
@@ -0,0 +1,33 @@
+#ifndef INSTRUCTION_RENDERER_H
+#define INSTRUCTION_RENDERER_H
+
+#include <QImage>
+#include <QString>
+
+class LegoCloud;
+
+//Raster instruction pages, one per level, painted straight into a QImage.
+//Knobs are blitted from a stamp rendered once, levels are rendered and encoded in parallel.
+class InstructionRenderer
+{
+public:
+  static const int DEFAULT_BRICK_PIXEL_SIZE = 20;
+
+  InstructionRenderer(const LegoCloud& legoCloud, int brickPixelSize = DEFAULT_BRICK_PIXEL_SIZE);
+
+  //Thread safe, as long as the cloud is not modified
+  QImage renderLevel(int level, bool hintLayerBelow = true) const;
+
+  //Saves every level to "<base>_<level>.<suffix>", the format follows the suffix.
+  //threadCount <= 0 means one thread per core
+  bool saveLevels(const QString& filePathBase, bool hintLayerBelow = true, int threadCount = 0) const;
+
+  static QString levelFilePath(const QString& filePathBase, int level);
+
+private:
+  const LegoCloud& legoCloud_;
+  int brickPixelSize_;
+  QImage knobStamp_;
+};
+
+#endif // INSTRUCTION_RENDERER_H
@@ -0,0 +1,275 @@
+#include "InstructionWriter.h"
+
+#include "LegoCloud.h"
+#include "LegoDimensions.h"
+
+#include <QColor>
+#include <QFile>
+#include <QHash>
+#include <QPainter>
+#include <QPair>
+#include <QPdfWriter>
+
+#include <iostream>
+#include <vector>
+
+#define SVG_FLUSH_SIZE (1 << 20)
+
+namespace
+{
+
+inline void flush(QFile& file, QByteArray& buffer, bool force = false)
+{
+  if(force || buffer.size() > SVG_FLUSH_SIZE)
+  {
+    file.write(buffer);
+    buffer.resize(0);
+  }
+}
+
+void appendRect(QByteArray& out, const QRect& rect, int pixelSize)
+{
+  out.append("<rect x=\"");
+  out.append(QByteArray::number(rect.x()*pixelSize));
+  out.append("\" y=\"");
+  out.append(QByteArray::number(rect.y()*pixelSize));
+  out.append("\" width=\"");
+  out.append(QByteArray::number(rect.width()*pixelSize));
+  out.append("\" height=\"");
+  out.append(QByteArray::number(rect.height()*pixelSize));
+  out.append("\"/>\n");
+}
+
+}
+
+InstructionWriter::InstructionWriter(const LegoCloud& legoCloud, int brickPixelSize)
+  : legoCloud_(legoCloud), brickPixelSize_(brickPixelSize)
+{
+}
+
+bool InstructionWriter::writeSvgLevels(const QString& filePathBase, bool hintLayerBelow) const
+{
+  bool ok = true;
+  for(int level = 0; level < legoCloud_.getLevelNumber(); level++)
+  {
+    const QString filePathLevel = InstructionRenderer::levelFilePath(filePathBase, level);
+    std::cout << "Saving: " << qPrintable(filePathLevel) << std::endl;
+    ok = writeSvgLevel(level, filePathLevel, hintLayerBelow) && ok;
+  }
+  return ok;
+}
+
+bool InstructionWriter::writeSvgLevel(int level, const QString& filePath, bool hintLayerBelow) const
+{
+  QFile file(filePath);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    std::cerr << "InstructionWriter: unable to create or open the file: " << qPrintable(filePath) << std::endl;
+    return false;
+  }
+
+  const QByteArray pixelSize = QByteArray::number(brickPixelSize_);
+  const QByteArray imageSizeX = QByteArray::number(legoCloud_.getWidth()*brickPixelSize_);
+  const QByteArray imageSizeY = QByteArray::number(legoCloud_.getDepth()*brickPixelSize_);
+  const QByteArray knobCenter = QByteArray::number(brickPixelSize_/2.0);
+  const QByteArray knobRadius = QByteArray::number(LEGO_KNOB_RADIUS / LEGO_KNOB_DISTANCE * brickPixelSize_);
+
+  QByteArray out;
+  out.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  out.append("<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"" + imageSizeX + "\" height=\"" + imageSizeY
+             + "\" viewBox=\"0 0 " + imageSizeX + " " + imageSizeY + "\">\n");
+
+  //A knob is defined once, the knob layer tiles it over the brick footprint
+  out.append("<defs>\n");
+  out.append("<symbol id=\"knob\" width=\"" + pixelSize + "\" height=\"" + pixelSize + "\"><circle cx=\"" + knobCenter + "\" cy=\"" + knobCenter + "\" r=\"" + knobRadius
+             + "\" fill=\"none\" stroke=\"#000\"/></symbol>\n");
+  out.append("<pattern id=\"knobs\" width=\"" + pixelSize + "\" height=\"" + pixelSize + "\" patternUnits=\"userSpaceOnUse\"><use xlink:href=\"#knob\"/></pattern>\n");
+  out.append("<pattern id=\"hint\" width=\"4\" height=\"4\" patternUnits=\"userSpaceOnUse\"><rect width=\"1\" height=\"1\" fill-opacity=\"0.78\"/>"
+             "<rect x=\"2\" y=\"2\" width=\"1\" height=\"1\" fill-opacity=\"0.78\"/></pattern>\n");
+  out.append("</defs>\n");
+
+  //Bricks: one path per color
+  const LegoBrickList& bricks = legoCloud_.getBricks(level);
+  const QVector<Color3>& legalColors = legoCloud_.getLegalColor();
+  out.append("<g stroke=\"#000\">\n");
+  for(int colorId = 0; colorId < legalColors.size(); colorId++)
+  {
+    bool pathStarted = false;
+    for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+    {
+      if(brick->getColorId() != colorId)
+        continue;
+
+      if(!pathStarted)
+      {
+        const Color3& color = legalColors[colorId];
+        out.append("<path fill=\"" + QColor(color[0]*255, color[1]*255, color[2]*255).name().toLatin1() + "\" d=\"");
+        pathStarted = true;
+      }
+
+      out.append('M');
+      out.append(QByteArray::number(brick->getPosX()*brickPixelSize_));
+      out.append(' ');
+      out.append(QByteArray::number(brick->getPosY()*brickPixelSize_));
+      out.append('h');
+      out.append(QByteArray::number(brick->getSizeX()*brickPixelSize_));
+      out.append('v');
+      out.append(QByteArray::number(brick->getSizeY()*brickPixelSize_));
+      out.append("h-");
+      out.append(QByteArray::number(brick->getSizeX()*brickPixelSize_));
+      out.append('z');
+
+      flush(file, out);
+    }
+
+    if(pathStarted)
+      out.append("\"/>\n");
+  }
+  out.append("</g>\n");
+
+  //Knobs
+  out.append("<g fill=\"url(#knobs)\">\n");
+  foreach(const QRect& rect, mergedFootprint(legoCloud_, level))
+  {
+    appendRect(out, rect, brickPixelSize_);
+    flush(file, out);
+  }
+  out.append("</g>\n");
+
+  //Underneath layer
+  if(level >= 1 && hintLayerBelow)
+  {
+    out.append("<g fill=\"url(#hint)\">\n");
+    foreach(const QRect& rect, mergedFootprint(legoCloud_, level-1))
+    {
+      appendRect(out, rect, brickPixelSize_);
+      flush(file, out);
+    }
+    out.append("</g>\n");
+  }
+
+  out.append("</svg>\n");
+  flush(file, out, true);
+
+  const bool ok = file.error() == QFile::NoError;
+  file.close();
+  return ok;
+}
+
+bool InstructionWriter::writePdf(const QString& filePath, bool hintLayerBelow) const
+{
+  const int imageSizeX = legoCloud_.getWidth()*brickPixelSize_;
+  const int imageSizeY = legoCloud_.getDepth()*brickPixelSize_;
+
+  //One point per pixel of the raster instructions
+  QPdfWriter pdfWriter(filePath);
+  pdfWriter.setResolution(72);
+  pdfWriter.setPageSizeMM(QSizeF(imageSizeX*25.4/72.0, imageSizeY*25.4/72.0));
+  QPagedPaintDevice::Margins margins = {0, 0, 0, 0};
+  pdfWriter.setMargins(margins);
+
+  QPainter painter;
+  if(!painter.begin(&pdfWriter))
+  {
+    std::cerr << "InstructionWriter: unable to create or open the file: " << qPrintable(filePath) << std::endl;
+    return false;
+  }
+
+  const double knobRadius = LEGO_KNOB_RADIUS / LEGO_KNOB_DISTANCE * brickPixelSize_;
+  const QBrush hintBrush(QColor(0, 0, 0, 200), Qt::Dense5Pattern);
+
+  for(int level = 0; level < legoCloud_.getLevelNumber(); level++)
+  {
+    //Pages are written to the file as they are completed
+    if(level > 0)
+      pdfWriter.newPage();
+
+    std::cout << "Saving page " << level << " of " << qPrintable(filePath) << std::endl;
+
+    painter.setPen(QPen(Qt::black, 0));
+    const LegoBrickList& bricks = legoCloud_.getBricks(level);
+    for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+    {
+      const Color3& color = legoCloud_.getLegalColor()[brick->getColorId()];
+      painter.setBrush(QColor(color[0]*255, color[1]*255, color[2]*255));
+      painter.drawRect(brick->getPosX()*brickPixelSize_, brick->getPosY()*brickPixelSize_, brick->getSizeX()*brickPixelSize_, brick->getSizeY()*brickPixelSize_);
+    }
+
+    painter.setBrush(Qt::NoBrush);
+    for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+    {
+      for(int x = 0; x < brick->getSizeX(); ++x)
+      {
+        for(int y = 0; y < brick->getSizeY(); ++y)
+        {
+          painter.drawEllipse(QPointF((brick->getPosX() + x + 0.5)*brickPixelSize_, (brick->getPosY() + y + 0.5)*brickPixelSize_), knobRadius, knobRadius);
+        }
+      }
+    }
+
+    if(level >= 1 && hintLayerBelow)
+    {
+      foreach(const QRect& rect, mergedFootprint(legoCloud_, level-1))
+      {
+        painter.fillRect(rect.x()*brickPixelSize_, rect.y()*brickPixelSize_, rect.width()*brickPixelSize_, rect.height()*brickPixelSize_, hintBrush);
+      }
+    }
+  }
+
+  return painter.end();
+}
+
+QVector<QRect> InstructionWriter::mergedFootprint(const LegoCloud& legoCloud, int level)
+{
+  QVector<QRect> rects;
+  if(level < 0 || level >= legoCloud.getLevelNumber())
+    return rects;
+
+  const int width = legoCloud.getWidth();
+  const int depth = legoCloud.getDepth();
+
+  std::vector<char> occupied(width*depth, 0);//[y*width + x]
+  const LegoBrickList& bricks = legoCloud.getBricks(level);
+  for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+  {
+    for(int y = brick->getPosY(); y < brick->getPosY() + brick->getSizeY(); y++)
+    {
+      std::fill(occupied.begin() + y*width + brick->getPosX(), occupied.begin() + y*width + brick->getPosX() + brick->getSizeX(), 1);
+    }
+  }
+
+  //(first x, end x) of the runs still open, and the row where they started
+  typedef QPair<int, int> Run;
+  QHash<Run, int> openRuns;
+
+  for(int y = 0; y <= depth; y++)
+  {
+    QHash<Run, int> nextRuns;
+    int x = 0;
+    while(y < depth && x < width)
+    {
+      if(!occupied[y*width + x])
+      {
+        x++;
+        continue;
+      }
+
+      const int runStart = x;
+      while(x < width && occupied[y*width + x])
+        x++;
+
+      const Run run(runStart, x);
+      nextRuns.insert(run, openRuns.contains(run) ? openRuns.take(run) : y);
+    }
+
+    //The runs that did not continue on this row are complete
+    for(QHash<Run, int>::const_iterator runIt = openRuns.constBegin(); runIt != openRuns.constEnd(); ++runIt)
+    {
+      rects.push_back(QRect(runIt.key().first, runIt.value(), runIt.key().second - runIt.key().first, y - runIt.value()));
+    }
+
+    openRuns = nextRuns;
+  }
+
+  return rects;
+}
@@ -0,0 +1,35 @@
+#ifndef INSTRUCTION_WRITER_H
+#define INSTRUCTION_WRITER_H
+
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+#include "InstructionRenderer.h"
+
+class LegoCloud;
+
+//Vector instructions: compact SVG written directly (one file per level) or a single multi-page PDF.
+//Output is streamed level by level, memory does not grow with the number of levels.
+class InstructionWriter
+{
+public:
+  InstructionWriter(const LegoCloud& legoCloud, int brickPixelSize = InstructionRenderer::DEFAULT_BRICK_PIXEL_SIZE);
+
+  //"<base>_<level>.svg" for every level
+  bool writeSvgLevels(const QString& filePathBase, bool hintLayerBelow = true) const;
+  bool writeSvgLevel(int level, const QString& filePath, bool hintLayerBelow = true) const;
+
+  //One page per level
+  bool writePdf(const QString& filePath, bool hintLayerBelow = true) const;
+
+  //Area covered by the bricks of a level, as few rectangles as possible (in knob units).
+  //Horizontal runs of cells are merged, then identical runs of consecutive rows.
+  static QVector<QRect> mergedFootprint(const LegoCloud& legoCloud, int level);
+
+private:
+  const LegoCloud& legoCloud_;
+  int brickPixelSize_;
+};
+
+#endif // INSTRUCTION_WRITER_H
@@ -10,52 +10,64 @@
 typedef QPair<int, int> BrickSize;
 typedef Vector3 Color3;
 
+//Packed to 16 bytes: 16 bits coordinates, 4 bits sizes, 8 bits color id and flag bits, plus the cached hash.
 class LegoBrick
 {
 public:
+  static const int MAX_COORDINATE = 0xffff;//Level and positions
+  static const int MAX_SIZE = 0xf;//In knobs
+  static const int MAX_COLOR_ID = 0xff;
 
-  //Default constructor in order to use the QTL datatypes
+  //Default constructor in order to use the QTL datatypes, also the free slots of LegoBrickList (no knob)
   LegoBrick()
-    :level_(0), posX_(0), posY_(0), sizeX_(0), sizeY_(0)
+    :level_(0), posX_(0), posY_(0), sizes_(0), colorId_(0), flags_(0)
   {
     computeHash();
-    isOuter_ = false;
-    colorId_ = 0;
   }
 
+  //BinvoxParser, loadProject and the test box reject the values out of range, release builds clamp what would get through
+  //instead of wrapping it onto another brick
   LegoBrick(int level, int posX, int posY, int sizeX, int sizeY)
-    :level_(level), posX_(posX), posY_(posY), sizeX_(sizeX), sizeY_(sizeY), randColor_(Color3(0, rand()/double(RAND_MAX), rand()/double(RAND_MAX)))
+    :level_(quint16(qBound(0, level, int(MAX_COORDINATE)))),
+      posX_(quint16(qBound(0, posX, int(MAX_COORDINATE)))),
+      posY_(quint16(qBound(0, posY, int(MAX_COORDINATE)))),
+      sizes_(quint8(qBound(0, sizeX, int(MAX_SIZE)) | (qBound(0, sizeY, int(MAX_SIZE)) << 4))),
+      colorId_(0), flags_(0)
   {
+    Q_ASSERT(level >= 0 && level <= MAX_COORDINATE);
+    Q_ASSERT(posX >= 0 && posX <= MAX_COORDINATE && posY >= 0 && posY <= MAX_COORDINATE);
+    Q_ASSERT(sizeX >= 0 && sizeX <= MAX_SIZE && sizeY >= 0 && sizeY <= MAX_SIZE);
     computeHash();
-    isOuter_ = false;
-    colorId_ = 0;
   }
 
   inline int getLevel() const {return level_;}
   inline int getPosX() const {return posX_;}
   inline int getPosY() const {return posY_;}
 
-  inline int getSizeX() const {return sizeX_;}
-  inline int getSizeY() const {return sizeY_;}
-  inline BrickSize getSize() const {return (sizeX_ <= sizeY_ ? BrickSize(sizeX_, sizeY_) : BrickSize(sizeY_, sizeX_));}
-  inline int getKnobNumber() const {return sizeX_*sizeY_;}
+  inline int getSizeX() const {return sizes_ & 0xf;}
+  inline int getSizeY() const {return sizes_ >> 4;}
+  inline BrickSize getSize() const {return (getSizeX() <= getSizeY() ? BrickSize(getSizeX(), getSizeY()) : BrickSize(getSizeY(), getSizeX()));}
+  inline int getKnobNumber() const {return getSizeX()*getSizeY();}
 
-  inline const Color3 getRandColor() const {return randColor_;}
+  //The debug color is a function of the position and size: it is not stored and does not consume any random number
+  inline const Color3 getRandColor() const
+  {
+    const uint scrambled = hash_*2654435761u;
+    return Color3(0, ((scrambled >> 8) & 0xff)/255.0f, ((scrambled >> 16) & 0xff)/255.0f);
+  }
   inline int getColorId() const {return colorId_;}
-  inline void setColorId(int id) { colorId_ = id;}
-  inline void setRandColor(double r, double g, double b) {randColor_[0] = r; randColor_[1] = g; randColor_[2] = b;}
+  inline void setColorId(int id) {Q_ASSERT(id >= 0 && id <= MAX_COLOR_ID); colorId_ = quint8(qBound(0, id, int(MAX_COLOR_ID)));}
 
 
-  inline bool isOuter() const {return isOuter_;}
-  inline void setIsOuter(bool isOuter) {isOuter_ = isOuter;}
+  inline bool isOuter() const {return flags_ & OUTER_FLAG;}
+  inline void setIsOuter(bool isOuter) {flags_ = isOuter ? (flags_ | OUTER_FLAG) : (flags_ & ~OUTER_FLAG);}
 
   //We ignore color
   inline bool operator==(const LegoBrick& other) const {
-    return (level_ == other.getLevel() &&
-            posX_ == other.getPosX() &&
-            posY_ == other.getPosY() &&
-            sizeX_ == other.getSizeX() &&
-            sizeY_ == other.getSizeY()
+    return (level_ == other.level_ &&
+            posX_ == other.posX_ &&
+            posY_ == other.posY_ &&
+            sizes_ == other.sizes_
             );}
 
 
@@ -73,25 +85,25 @@ public:
   }
 
   inline void print() const{
-    std::cout << "LegoBrick(" << level_ << ", " << posX_ << ", " << posY_ << ", " << sizeX_ << ", " << sizeY_ << ", "<< (isOuter_ ? "Outer" : "Inner") << ")" << std::endl;
+    std::cout << "LegoBrick(" << getLevel() << ", " << getPosX() << ", " << getPosY() << ", " << getSizeX() << ", " << getSizeY() << ", "<< (isOuter() ? "Outer" : "Inner") << ")" << std::endl;
   }
 
 private:
-  int level_;
-  int posX_;
-  int posY_;
+  enum Flags{OUTER_FLAG = 0x1};
 
-  int sizeX_;//In knobs
-  int sizeY_;//In knobs
+  quint16 level_;
+  quint16 posX_;
+  quint16 posY_;
 
-  Color3 randColor_;
-  int colorId_;//Corresponds to the index in the legalColors_ array of LegoCloud
-
-  bool isOuter_;
+  quint8 sizes_;//X in the low 4 bits, Y in the high 4 bits
+  quint8 colorId_;//Corresponds to the index in the legalColors_ array of LegoCloud
+  quint8 flags_;
 
   uint hash_;
 };
 
+Q_STATIC_ASSERT(sizeof(LegoBrick) == 16);
+
 /*
 inline uint qHash(const LegoBrick& brick)
 {
@@ -0,0 +1,58 @@
+#include "LegoBrickList.h"
+
+LegoBrickList::LegoBrickList()
+  : lastChunkUsed_(0), size_(0)
+{
+}
+
+LegoBrick* LegoBrickList::append(const LegoBrick& brick)
+{
+  Q_ASSERT(brick.getKnobNumber() > 0);
+
+  LegoBrick* slot;
+  if(!freeSlots_.empty())
+  {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  }
+  else
+  {
+    if(chunks_.empty() || lastChunkUsed_ == chunkCapacity(chunks_.size() - 1))
+    {
+      //The slots are default bricks, without knobs: free until they are taken
+      chunks_.push_back(std::unique_ptr<LegoBrick[]>(new LegoBrick[chunkCapacity(chunks_.size())]));
+      lastChunkUsed_ = 0;
+    }
+    slot = &chunks_.back()[lastChunkUsed_++];
+  }
+
+  *slot = brick;
+  size_++;
+  return slot;
+}
+
+void LegoBrickList::remove(LegoBrick* brick)
+{
+  Q_ASSERT(brick->getKnobNumber() > 0);
+  *brick = LegoBrick();
+  freeSlots_.push_back(brick);
+  size_--;
+}
+
+void LegoBrickList::clear()
+{
+  chunks_.clear();
+  freeSlots_.clear();
+  lastChunkUsed_ = 0;
+  size_ = 0;
+}
+
+bool LegoBrickList::contains(const LegoBrick& brick) const
+{
+  for(const_iterator brickIt = constBegin(); brickIt != constEnd(); ++brickIt)
+  {
+    if(*brickIt == brick)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,123 @@
+#ifndef LEGO_BRICK_LIST_H
+#define LEGO_BRICK_LIST_H
+
+#include <memory>
+#include <vector>
+
+#include "LegoBrick.h"
+
+//Bricks of a level, stored contiguously in chunks that are never moved: the neighbourhood and the graph
+//designate the bricks by address. The chunks grow from FIRST_CHUNK_CAPACITY to MAX_CHUNK_CAPACITY bricks.
+//A removed brick leaves a free slot, reused by the next append; free slots are bricks without knobs
+//(every brick has one at least) and the iterators skip them.
+class LegoBrickList
+{
+public:
+  static const int FIRST_CHUNK_CAPACITY = 32;
+  static const int MAX_CHUNK_CAPACITY = 4096;//64 KB
+
+  template<typename Brick> class Iterator
+  {
+  public:
+    Iterator() : chunks_(NULL), chunk_(0), brick_(NULL), chunkEnd_(NULL) {}
+
+    inline Brick& operator*() const {return *brick_;}
+    inline Brick* operator->() const {return brick_;}
+
+    inline Iterator& operator++()
+    {
+      ++brick_;
+      skipFreeSlots();
+      return *this;
+    }
+
+    inline Iterator operator++(int)
+    {
+      Iterator previous = *this;
+      ++(*this);
+      return previous;
+    }
+
+    inline bool operator==(const Iterator& other) const {return brick_ == other.brick_;}
+    inline bool operator!=(const Iterator& other) const {return brick_ != other.brick_;}
+
+  private:
+    friend class LegoBrickList;
+
+    Iterator(const std::vector<std::unique_ptr<LegoBrick[]> >* chunks, size_t chunk)
+      : chunks_(chunks), chunk_(chunk), brick_(NULL), chunkEnd_(NULL)
+    {
+      if(chunk_ < chunks_->size())
+      {
+        brick_ = (*chunks_)[chunk_].get();
+        chunkEnd_ = brick_ + chunkCapacity(chunk_);
+        skipFreeSlots();
+      }
+    }
+
+    inline void skipFreeSlots()
+    {
+      while(brick_ != NULL && (brick_ == chunkEnd_ || brick_->getKnobNumber() == 0))
+      {
+        if(brick_ == chunkEnd_)
+        {
+          chunk_++;
+          brick_ = chunk_ < chunks_->size() ? (*chunks_)[chunk_].get() : NULL;
+          chunkEnd_ = brick_ != NULL ? brick_ + chunkCapacity(chunk_) : NULL;
+        }
+        else
+        {
+          ++brick_;
+        }
+      }
+    }
+
+    const std::vector<std::unique_ptr<LegoBrick[]> >* chunks_;
+    size_t chunk_;
+    Brick* brick_;//NULL at the end
+    Brick* chunkEnd_;
+  };
+
+  typedef Iterator<LegoBrick> iterator;
+  typedef Iterator<const LegoBrick> const_iterator;
+
+  LegoBrickList();
+
+  //Moving keeps the bricks where they are; a copy would not, so there is none
+  LegoBrickList(LegoBrickList&& other) = default;
+  LegoBrickList& operator=(LegoBrickList&& other) = default;
+  LegoBrickList(const LegoBrickList&) = delete;
+  LegoBrickList& operator=(const LegoBrickList&) = delete;
+
+  inline int size() const {return size_;}
+  inline bool isEmpty() const {return size_ == 0;}
+
+  //Returns the address of the stored brick, valid until it is removed
+  LegoBrick* append(const LegoBrick& brick);
+  void remove(LegoBrick* brick);
+  void clear();
+
+  bool contains(const LegoBrick& brick) const;//Linear, for the assertions
+
+  inline iterator begin() {return iterator(&chunks_, 0);}
+  inline iterator end() {return iterator();}
+  inline const_iterator begin() const {return const_iterator(&chunks_, 0);}
+  inline const_iterator end() const {return const_iterator();}
+  inline const_iterator constBegin() const {return const_iterator(&chunks_, 0);}
+  inline const_iterator constEnd() const {return const_iterator();}
+
+  inline int chunkNumber() const {return int(chunks_.size());}
+  inline int freeSlotNumber() const {return int(freeSlots_.size());}
+  static inline int chunkCapacity(size_t chunk)
+  {
+    return chunk < 7 ? FIRST_CHUNK_CAPACITY << chunk : MAX_CHUNK_CAPACITY;
+  }
+
+private:
+  std::vector<std::unique_ptr<LegoBrick[]> > chunks_;
+  int lastChunkUsed_;//Slots of the last chunk taken at least once
+  std::vector<LegoBrick*> freeSlots_;
+  int size_;
+};
+
+#endif // LEGO_BRICK_LIST_H
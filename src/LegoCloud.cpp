@@ -1,16 +1,149 @@
 #include "LegoCloud.h"
-#include "LegoCloudNode.h"
+#include "EngineCounters.h"
+#include "LegoOperationLog.h"
+#include "ProcessStats.h"
+#include "Trace.h"
 
 #include <boost/graph/connected_components.hpp>
 #include <boost/graph/biconnected_components.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <QTime>
+#include <QFile>
+#include <QDataStream>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <vector>
 
 #define DEFAULT_COLOR_ID 2
 
+#define PROJECT_MAGIC 0x42524b50 //"BRKP"
+#define PROJECT_VERSION 1
+#define PROJECT_MAX_EXTENT 4096 //Per dimension, keeps the adjacency grids of rebuildAdjacency() under 16M cells
+
+namespace
+{
+
+//Size of a heap block: glibc adds an 8 bytes header, rounds up to 16 bytes and allocates 32 bytes at least
+qint64 heapBytes(qint64 requested)
+{
+  return std::max<qint64>(32, (requested + 8 + 15) & ~qint64(15));
+}
+
+const qint64 LIST_NODE_LINKS = 2*sizeof(void*);//Previous and next of a std::list node
+
+template <class T> qint64 vectorBytes(qint64 capacity)
+{
+  return capacity > 0 ? heapBytes(sizeof(QArrayData) + capacity*sizeof(T)) : 0;
+}
+
+//QList stores pointers, or pointers to heap nodes for the large types
+template <class T> qint64 listBytes(qint64 size)
+{
+  if(size == 0)
+    return 0;
+  const qint64 nodeBytes = (QTypeInfo<T>::isLarge || QTypeInfo<T>::isStatic) ? heapBytes(sizeof(T)) : 0;
+  return heapBytes(sizeof(QListData::Data) + size*sizeof(void*)) + size*nodeBytes;
+}
+
+//LegoBrickList: the chunks and their table, plus the free slots
+qint64 brickListBytes(int chunkNumber, qint64 freeSlotNumber)
+{
+  qint64 bytes = chunkNumber > 0 ? heapBytes(chunkNumber*sizeof(void*)) : 0;
+  for(int chunk = 0; chunk < chunkNumber; chunk++)
+    bytes += heapBytes(LegoBrickList::chunkCapacity(chunk)*sizeof(LegoBrick));
+  return bytes + (freeSlotNumber > 0 ? heapBytes(freeSlotNumber*sizeof(LegoBrick*)) : 0);
+}
+
+//Chunks of a LegoBrickList holding brickNumber bricks
+int projectedChunks(qint64 brickNumber)
+{
+  int chunkNumber = 0;
+  for(qint64 capacity = 0; capacity < brickNumber; chunkNumber++)
+    capacity += LegoBrickList::chunkCapacity(chunkNumber);
+  return chunkNumber;
+}
+
+template <class Key, class T> qint64 hashBytes(qint64 size, qint64 buckets)
+{
+  if(buckets == 0)
+    return 0;//Shared empty hash
+  return heapBytes(sizeof(QHashData)) + heapBytes(buckets*sizeof(void*)) + size*heapBytes(sizeof(QHashNode<Key, T>));
+}
+
+template <class Key, class T> qint64 hashBytes(const QHash<Key, T>& hash)
+{
+  return hashBytes<Key, T>(hash.size(), hash.capacity());
+}
+
+template <class T> qint64 setBytes(const QSet<T>& set)
+{
+  return hashBytes<T, QHashDummyValue>(set.size(), set.capacity());
+}
+
+template <class Key, class T> qint64 mapBytes(const QMap<Key, T>& map)
+{
+  return heapBytes(sizeof(QMapDataBase)) + map.size()*heapBytes(sizeof(QMapNode<Key, T>));
+}
+
+//QHash keeps more buckets than nodes, a prime just above a power of two and 17 at least
+qint64 projectedBuckets(qint64 size)
+{
+  qint64 buckets = 16;
+  while(buckets < size)
+    buckets *= 2;
+  return buckets + 1;
+}
+
+//adjacency_list<listS, listS, undirectedS>: a vertex is a node of the vertex list. An edge is a node of the
+//edge list (ends and property) plus a node in the out-edge list of both ends (target and edge list iterator)
+qint64 graphVertexBytes()
+{
+  return heapBytes(LIST_NODE_LINKS + sizeof(LegoGraph::stored_vertex));
+}
+
+qint64 graphEdgeBytes()
+{
+  return heapBytes(LIST_NODE_LINKS + 2*sizeof(void*) + sizeof(LegoEdge)) + 2*heapBytes(LIST_NODE_LINKS + 2*sizeof(void*));
+}
+
+double megabytes(qint64 bytes)
+{
+  return bytes/(1024.0*1024.0);
+}
+
+//Sets of bricks are ordered by address, which changes from a run to another: they are sorted with this
+//before any random choice or any order dependent operation, so that a seed reproduces a run
+bool brickLessThan(const LegoBrick* brick1, const LegoBrick* brick2)
+{
+  if(brick1->getLevel() != brick2->getLevel())
+    return brick1->getLevel() < brick2->getLevel();
+  if(brick1->getPosX() != brick2->getPosX())
+    return brick1->getPosX() < brick2->getPosX();
+  if(brick1->getPosY() != brick2->getPosY())
+    return brick1->getPosY() < brick2->getPosY();
+  if(brick1->getSizeX() != brick2->getSizeX())
+    return brick1->getSizeX() < brick2->getSizeX();
+  return brick1->getSizeY() < brick2->getSizeY();
+}
+
+QList<LegoBrick*> sortedBricks(const QSet<LegoBrick*>& bricks)
+{
+  QList<LegoBrick*> sorted = bricks.toList();
+  std::sort(sorted.begin(), sorted.end(), brickLessThan);
+  return sorted;
+}
+
+}
+
 LegoCloud::LegoCloud()
 {
   levelNumber_ = 0;
+  height_ = 0;
+  width_ = 0;
+  depth_ = 0;
+  seed_ = 0;
+  operationLog_ = NULL;
   merged_ = false;
   brickLimitConstraint_ = false;
 
@@ -84,20 +217,18 @@ LegoBrick *LegoCloud::addBrick(int level, int posX, int posY)
   {
     for(int i = 0; i < level+1 - levelNumber_; i++)
     {
-      QList<LegoBrick> levelBricks;
-      bricks_.append(levelBricks);
+      bricks_.push_back(LegoBrickList());
     }
     levelNumber_ = level+1;
   }
-  assert(bricks_.size() > level);
+  assert(int(bricks_.size()) > level);
 
   LegoBrick brick(level, posX, posY, 1, 1);
   assert(!bricks_[level].contains(brick));
 
   brickNumber_[BrickSize(1,1)]++;
 
-  bricks_[level].push_back(brick);
-  LegoBrick* brickPointer = &(bricks_[level].last());
+  LegoBrick* brickPointer = bricks_[level].append(brick);
 
   LegoGraph::vertex_descriptor vertex = boost::add_vertex(graph_);
   graph_[vertex].brick = brickPointer;
@@ -112,6 +243,9 @@ void LegoCloud::removeAllBricks()
   graph_.clear();
   bricks_.clear();
   neighbourhood_.clear();
+  brickToVertex_.clear();
+  outerBricks_.clear();
+  innerBricks_.clear();
   levelNumber_ = 0;
   width_ = 0;
   depth_ = 0;
@@ -157,6 +291,9 @@ void LegoCloud::addVoxel(int level, int posX, int posY, LegoBrick* brick)
 
 void LegoCloud::buildNeighbourhood()//Assumption: there is only 1x1 bricks
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::buildNeighbourhood");
+  BRICKR_TRACE_ARG("bricks", getBrickNumber());
+
   QSet<LegoBrick*> neighbours;
   QSet<LegoBrick*> toRemove;
 
@@ -165,7 +302,7 @@ void LegoCloud::buildNeighbourhood()//Assumption: there is only 1x1 bricks
 
   for(int level = 0; level < levelNumber_; level++)
   {
-    for(QList<LegoBrick>::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
+    for(LegoBrickList::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
     {
       assert(brickIt->getKnobNumber() == 1);
       neighbours.clear();
@@ -287,16 +424,26 @@ void LegoCloud::buildNeighbourhood()//Assumption: there is only 1x1 bricks
 
 void LegoCloud::preHollow(int shellThickness)
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::preHollow");
+  BRICKR_TRACE_ARG("bricks", getBrickNumber());
+
   if(shellThickness < 1)
   {
     std::cerr << "The shell thickness should be greater than 0" << std::endl;
   }
 
+  //The voxel grid is only filled by a voxelization, not by loadProject(), and is released at the end
+  if(voxelGrid_.isEmpty())
+  {
+    std::cerr << "preHollow needs the voxel grid of the model" << std::endl;
+    return;
+  }
+
   QList<LegoBrick*> toDelete;
   for(int level = 0; level < levelNumber_; level++)
   {
     //for(QSet<LegoBrick>::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
-    for(QList<LegoBrick>::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)//QTL
+    for(LegoBrickList::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)//QTL
     {
       LegoBrick* brick = &(*brickIt);
 
@@ -345,6 +492,9 @@ QSet<LegoBrick *>& LegoCloud::getNeighbours(LegoBrick *brick)
 
 void LegoCloud::merge()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::merge");
+  BRICKR_TRACE_ARG("bricksBefore", getBrickNumber());
+
   //progress::setNumberOfSteps(levelNumber_, "merging...");
   //progress::setProgress(0);
 
@@ -357,7 +507,7 @@ void LegoCloud::merge()
   {
     toMerge.clear();
 
-    LegoBrick* brickToMerge = outerBricks_[rand()%outerBricks_.size()];
+    LegoBrick* brickToMerge = outerBricks_[random_.bounded(outerBricks_.size())];
     LegoBrick* neighbourToMerge;
 
     if(merged_)//True only after the first merge
@@ -365,6 +515,10 @@ void LegoCloud::merge()
     else
       neighbourToMerge = findBestNeighbour(brickToMerge, MaxConnectivity);
 
+    EngineCounters::add(EngineCounters::MergeDraws);
+    if(neighbourToMerge == NULL)
+      EngineCounters::add(EngineCounters::MergeFailedDraws);
+
     while(neighbourToMerge != NULL)
     {
       toMerge.clear();
@@ -392,7 +546,7 @@ void LegoCloud::merge()
   {
     toMerge.clear();
 
-    LegoBrick* brickToMerge = innerBricks_[rand()%innerBricks_.size()];
+    LegoBrick* brickToMerge = innerBricks_[random_.bounded(innerBricks_.size())];
     LegoBrick* neighbourToMerge;
 
     if(merged_)//True only after the first merge
@@ -400,6 +554,10 @@ void LegoCloud::merge()
     else
       neighbourToMerge = findBestNeighbour(brickToMerge, MaxConnectivity);
 
+    EngineCounters::add(EngineCounters::MergeDraws);
+    if(neighbourToMerge == NULL)
+      EngineCounters::add(EngineCounters::MergeFailedDraws);
+
     while(neighbourToMerge != NULL)
     {
       toMerge.clear();
@@ -421,15 +579,21 @@ void LegoCloud::merge()
   biconnectedComponents();
 
   merged_ = true;
+  BRICKR_TRACE_ARG("bricksAfter", getBrickNumber());
+  BRICKR_TRACE_ARG("components", conCompNumber_);
+  BRICKR_TRACE_ARG("weakArticulationPoints", badArtPointNumber_);
   //progress::finish();
 }
 
 //This method should be the last call before saving instructions
 void LegoCloud::solveBrickNumberLimitation()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::solveBrickNumberLimitation");
+  BRICKR_TRACE_ARG("bricksBefore", getBrickNumber());
+
   for(int level = 0; level < levelNumber_; level++)
   {
-    QList<LegoBrick>::iterator brickIt;
+    LegoBrickList::iterator brickIt;
     for(brickIt = bricks_[level].begin(); brickIt!=bricks_[level].end(); brickIt++)
     {
       int limit = brickLimitation_[brickIt->getSize()];
@@ -467,6 +631,9 @@ void LegoCloud::solveBrickNumberLimitation()
   connectedComponents();
   biconnectedComponents();
   brickLimitConstraint_ = true;
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::BrickLimits, brickLimitation_);
+  BRICKR_TRACE_ARG("bricksAfter", getBrickNumber());
 }
 
 void LegoCloud::setBrickLimit(BrickSize size, int value)
@@ -528,7 +695,7 @@ void LegoCloud::loadColors(scenegraph::OpenMeshNode* meshNode)
 
   for(int level = 0; level < levelNumber_; level++)
   {
-    QList<LegoBrick>::iterator brickIt;
+    LegoBrickList::iterator brickIt;
     for(brickIt = bricks_[level].begin(); brickIt!=bricks_[level].end(); brickIt++)
     {
       //if(brickIt->isOuter())
@@ -666,47 +833,41 @@ void LegoCloud::loadColors(scenegraph::OpenMeshNode* meshNode)
 void LegoCloud::printBrickTypes()
 {
   //Print the brick type by color and by type
-  QHash<int, QHash<BrickSize, int> > bricksByColorByType;
-
-  for(int colorId = 0; colorId < legalColors_.size(); colorId++)
-  {
-    bricksByColorByType[colorId] = QHash<BrickSize, int>();
-    foreach(const BrickSize& brickSize, legalBricks_)
-    {
-      bricksByColorByType[colorId][brickSize] = 0;
-    }
-  }
-
-  const int brick0ColorID = (*(innerBricks_.begin()))->getColorId();//We take from innerBricks_ because bricks_[0] could be empty
+  //Number of bricks by color, size x and size y
+  const int colorNumber = legalColors_.size();
+  const int sizeNumber = LegoBrick::MAX_SIZE + 1;
+  QVector<int> bricksByColorBySize(colorNumber*sizeNumber*sizeNumber, 0);
+  int firstColorId = -1;
   bool isSingleColor = true;
-
   for(int level = 0; level < levelNumber_; level++)
   {
-    QList<LegoBrick>::iterator brickIt;
-    for(brickIt = bricks_[level].begin(); brickIt!=bricks_[level].end(); brickIt++)
+    for(LegoBrickList::const_iterator brickIt = bricks_[level].constBegin(); brickIt != bricks_[level].constEnd(); brickIt++)
     {
-      int colorID = brickIt->getColorId();
-      bricksByColorByType[colorID][brickIt->getSize()]++;
-
-      if(brick0ColorID != colorID)
-      {
-        isSingleColor = false;
-      }
+      const int colorId = brickIt->getColorId();
+      assert(colorId < colorNumber);
+      bricksByColorBySize[(colorId*sizeNumber + brickIt->getSizeX())*sizeNumber + brickIt->getSizeY()]++;
+      if(firstColorId < 0)
+        firstColorId = colorId;
+      isSingleColor = isSingleColor && colorId == firstColorId;
     }
   }
 
   //We only display the by color brick types if there is more than 1 color
   if(!isSingleColor)
   {
-    for(int colorId = 0; colorId < legalColors_.size(); colorId++)
+    for(int colorId = 0; colorId < colorNumber; colorId++)
     {
 
       std::cout << "Color: (" << legalColors_[colorId] << "): " << std::endl;
 
       foreach(const BrickSize& brickSize, legalBricks_)
       {
-        if(bricksByColorByType[colorId][brickSize] > 0)
-          std::cout << "\t" << brickSize.first << "x" << brickSize.second  << ": "<< bricksByColorByType[colorId][brickSize] << " bricks" << std::endl;
+        const int* colorBricks = bricksByColorBySize.constData() + colorId*sizeNumber*sizeNumber;
+        int number = colorBricks[brickSize.first*sizeNumber + brickSize.second];
+        if(brickSize.first != brickSize.second)
+          number += colorBricks[brickSize.second*sizeNumber + brickSize.first];//Both orientations
+        if(number > 0)
+          std::cout << "\t" << brickSize.first << "x" << brickSize.second  << ": "<< number << " bricks" << std::endl;
       }
     }
     std::cout << std::endl;
@@ -729,10 +890,249 @@ void LegoCloud::printStats()
   std::cout << "Height: " << levelNumber_ << " levels " << "(" <<levelNumber_*LEGO_HEIGHT*100.0 << "cm)" << std::endl;
   std::cout << "Number of connected components: "<< conCompNumber_ << std::endl;
   std::cout << "Number of weak articulation points: " << badArtPointNumber_ << std::endl;
+  std::cout << "Engine counters (since the start of the application):" << std::endl;
+  EngineCounters::print(std::cout, EngineCounters::snapshot());
+  memoryReport().print(std::cout);
+
+  const int resolution = std::max(levelNumber_, std::max(width_, depth_));
+  if(resolution > 0)
+  {
+    std::cout << "Projection at twice the resolution (" << 2*resolution << "):" << std::endl;
+    projectMemory(2*resolution, getFillRatio()).print(std::cout);
+  }
+}
+
+LegoCloud::MemoryReport::MemoryReport()
+  : bricks(0), neighbourhood(0), graphVertices(0), graphEdges(0), brickToVertex(0), brickLists(0),
+    voxelGrid(0), colorsAndLimits(0), peakResidentBytes(-1)
+{
+}
+
+qint64 LegoCloud::MemoryReport::total() const
+{
+  return bricks + neighbourhood + graphVertices + graphEdges + brickToVertex + brickLists + voxelGrid + colorsAndLimits;
+}
+
+void LegoCloud::MemoryReport::print(std::ostream& stream) const
+{
+  stream << "Memory (estimated, MB):" << std::endl;
+  stream << "  bricks: " << megabytes(bricks) << std::endl;
+  stream << "  neighbourhood: " << megabytes(neighbourhood) << std::endl;
+  stream << "  graph vertices: " << megabytes(graphVertices) << std::endl;
+  stream << "  graph edges: " << megabytes(graphEdges) << std::endl;
+  stream << "  brick to vertex: " << megabytes(brickToVertex) << std::endl;
+  stream << "  outer and inner bricks: " << megabytes(brickLists) << std::endl;
+  stream << "  voxel grid: " << megabytes(voxelGrid) << std::endl;
+  stream << "  colors and limits: " << megabytes(colorsAndLimits) << std::endl;
+  stream << "  total: " << megabytes(total()) << std::endl;
+  if(peakResidentBytes >= 0)
+    stream << "  process peak resident: " << megabytes(peakResidentBytes) << std::endl;
+}
+
+LegoCloud::MemoryReport LegoCloud::memoryReport() const
+{
+  MemoryReport report;
+
+  report.bricks = bricks_.capacity() > 0 ? heapBytes(bricks_.capacity()*sizeof(LegoBrickList)) : 0;
+  for(size_t level = 0; level < bricks_.size(); level++)
+    report.bricks += brickListBytes(bricks_[level].chunkNumber(), bricks_[level].freeSlotNumber());
+
+  report.neighbourhood = hashBytes(neighbourhood_);
+  for(QHash<LegoBrick*, QSet<LegoBrick*> >::const_iterator it = neighbourhood_.constBegin(); it != neighbourhood_.constEnd(); ++it)
+    report.neighbourhood += setBytes(it.value());
+
+  report.graphVertices = boost::num_vertices(graph_)*graphVertexBytes();
+  report.graphEdges = boost::num_edges(graph_)*graphEdgeBytes();
+  report.brickToVertex = hashBytes(brickToVertex_);
+  report.brickLists = listBytes<LegoBrick*>(outerBricks_.size()) + listBytes<LegoBrick*>(innerBricks_.size());
+
+  report.voxelGrid = vectorBytes<QVector<QVector<LegoBrick*> > >(voxelGrid_.capacity());
+  for(int level = 0; level < voxelGrid_.size(); level++)
+  {
+    report.voxelGrid += vectorBytes<QVector<LegoBrick*> >(voxelGrid_[level].capacity());
+    for(int x = 0; x < voxelGrid_[level].size(); x++)
+      report.voxelGrid += vectorBytes<LegoBrick*>(voxelGrid_[level][x].capacity());
+  }
+
+  report.colorsAndLimits = setBytes(legalBricks_) + vectorBytes<Color3>(legalColors_.capacity())
+      + mapBytes(brickLimitation_) + mapBytes(brickNumber_);
+
+  report.peakResidentBytes = ProcessStats::peakResidentBytes();
+  return report;
+}
+
+LegoCloud::MemoryReport LegoCloud::projectMemory(int resolution, double fillRatio) const
+{
+  MemoryReport report;
+  if(resolution <= 0)
+    return report;
+
+  const qint64 cells = qint64(resolution)*resolution*resolution;
+  const qint64 brickNumber = qint64(std::min(std::max(fillRatio, 0.0), 1.0)*cells + 0.5);
+  const qint64 neighbourNumber = 4;
+
+  report.bricks = heapBytes(resolution*sizeof(LegoBrickList)) + (resolution - 1)*brickListBytes(projectedChunks(brickNumber/resolution), 0)
+      + brickListBytes(projectedChunks(brickNumber - (resolution - 1)*(brickNumber/resolution)), 0);
+  report.neighbourhood = hashBytes<LegoBrick*, QSet<LegoBrick*> >(brickNumber, projectedBuckets(brickNumber))
+      + brickNumber*hashBytes<LegoBrick*, QHashDummyValue>(neighbourNumber, projectedBuckets(neighbourNumber));
+  report.graphVertices = brickNumber*graphVertexBytes();
+  report.graphEdges = brickNumber*graphEdgeBytes();
+  report.brickToVertex = hashBytes<LegoBrick*, LegoGraph::vertex_descriptor>(brickNumber, projectedBuckets(brickNumber));
+  report.brickLists = listBytes<LegoBrick*>(brickNumber);
+  report.voxelGrid = vectorBytes<QVector<QVector<LegoBrick*> > >(resolution)
+      + resolution*vectorBytes<QVector<LegoBrick*> >(resolution)
+      + qint64(resolution)*resolution*vectorBytes<LegoBrick*>(resolution);
+  report.colorsAndLimits = setBytes(legalBricks_) + vectorBytes<Color3>(legalColors_.capacity())
+      + mapBytes(brickLimitation_) + mapBytes(brickNumber_);
+  return report;
+}
+
+double LegoCloud::getFillRatio() const
+{
+  const qint64 resolution = std::max(levelNumber_, std::max(width_, depth_));
+  if(resolution == 0)
+    return 0.0;
+
+  qint64 voxelNumber = 0;
+  for(int level = 0; level < levelNumber_; level++)
+  {
+    for(LegoBrickList::const_iterator brickIt = bricks_[level].constBegin(); brickIt != bricks_[level].constEnd(); brickIt++)
+      voxelNumber += brickIt->getKnobNumber();
+  }
+  return double(voxelNumber)/(resolution*resolution*resolution);
+}
+
+void LegoCloud::setSeed(quint64 seed)
+{
+  seed_ = seed;
+  random_.seed(seed);
+}
+
+void LegoCloud::setOperationLog(LegoOperationLog* log)
+{
+  operationLog_ = log;
+  if(operationLog_)
+    operationLog_->setSeed(seed_);
+}
+
+bool LegoCloud::replay(const LegoOperationLog& log)
+{
+  BRICKR_TRACE_SCOPE("LegoCloud::replay");
+  BRICKR_TRACE_ARG("operations", log.size());
+  typedef LegoOperationLog::BrickHandle BrickHandle;
+
+  //The bricks by handle, updated with the bricks created by each operation
+  QHash<BrickHandle, LegoBrick*> bricks;
+  bricks.reserve(getBrickNumber());
+  for(int level = 0; level < levelNumber_; level++)
+  {
+    for(LegoBrickList::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
+      bricks.insert(BrickHandle(*brickIt), &(*brickIt));
+  }
+
+  const QVector<LegoOperationLog::Operation>& operations = log.getOperations();
+  for(int i = 0; i < operations.size(); i++)
+  {
+    const LegoOperationLog::Operation& operation = operations[i];
+    LegoBrick* brick = NULL;
+    LegoBrick* otherBrick = NULL;
+    if(operation.type == LegoOperationLog::Merge || operation.type == LegoOperationLog::Split
+       || operation.type == LegoOperationLog::Cut || operation.type == LegoOperationLog::Remove)
+    {
+      brick = bricks.take(operation.bricks[0]);
+      if(operation.type == LegoOperationLog::Merge)
+        otherBrick = bricks.take(operation.bricks[1]);
+      if(brick == NULL || (operation.type == LegoOperationLog::Merge && otherBrick == NULL))
+      {
+        std::cerr << "Replay: operation " << i << " (" << LegoOperationLog::typeName(operation.type)
+                  << ") refers to a brick that does not exist, the log was recorded from another state" << std::endl;
+        return false;
+      }
+    }
+
+    switch(operation.type)
+    {
+    case LegoOperationLog::Merge:
+    {
+      //Two bricks of a level never overlap: they are adjacent and fill a rectangle when their areas add up to its area
+      const int minX = qMin(brick->getPosX(), otherBrick->getPosX());
+      const int minY = qMin(brick->getPosY(), otherBrick->getPosY());
+      const int sizeX = qMax(brick->getPosX() + brick->getSizeX(), otherBrick->getPosX() + otherBrick->getSizeX()) - minX;
+      const int sizeY = qMax(brick->getPosY() + brick->getSizeY(), otherBrick->getPosY() + otherBrick->getSizeY()) - minY;
+      if(brick->getLevel() != otherBrick->getLevel() || brick->getKnobNumber() + otherBrick->getKnobNumber() != sizeX*sizeY
+         || !legalBricks_.contains(BrickSize(qMin(sizeX, sizeY), qMax(sizeX, sizeY))))
+      {
+        std::cerr << "Replay: operation " << i << " (merge) does not merge two bricks in a legal brick, the log is corrupted" << std::endl;
+        return false;
+      }
+      QSet<LegoBrick*> toMerge;
+      toMerge.insert(brick);
+      toMerge.insert(otherBrick);
+      LegoBrick* newBrick = mergeBricks(toMerge);
+      bricks.insert(BrickHandle(*newBrick), newBrick);
+      break;
+    }
+    case LegoOperationLog::Split:
+    case LegoOperationLog::Cut:
+    {
+      QList<LegoBrick*> newBricks;
+      if(operation.type == LegoOperationLog::Split)
+      {
+        splitBrick(brick, &newBricks);
+      }
+      else
+      {
+        //The first new brick shares the corner of the brick and all of its width or depth, both parts must be legal
+        const BrickHandle& first = operation.bricks[1];
+        const bool alongX = first.sizeY == brick->getSizeY() && first.sizeX > 0 && first.sizeX < brick->getSizeX();
+        const bool alongY = first.sizeX == brick->getSizeX() && first.sizeY > 0 && first.sizeY < brick->getSizeY();
+        auto isLegal = [this](int sizeX, int sizeY) {return legalBricks_.contains(BrickSize(qMin(sizeX, sizeY), qMax(sizeX, sizeY)));};
+        if(first.level != brick->getLevel() || first.posX != brick->getPosX() || first.posY != brick->getPosY() || (!alongX && !alongY)
+           || !isLegal(first.sizeX, first.sizeY)
+           || !isLegal(alongX ? brick->getSizeX() - first.sizeX : first.sizeX, alongX ? first.sizeY : brick->getSizeY() - first.sizeY))
+        {
+          std::cerr << "Replay: operation " << i << " (cut) does not cut its brick in two legal bricks, the log is corrupted" << std::endl;
+          return false;
+        }
+        LegoBrick brick1(first.level, first.posX, first.posY, first.sizeX, first.sizeY);
+        LegoBrick brick2(brick->getLevel(),
+                         alongX ? first.posX + first.sizeX : first.posX,
+                         alongX ? first.posY : first.posY + first.sizeY,
+                         alongX ? brick->getSizeX() - first.sizeX : brick->getSizeX(),
+                         alongX ? brick->getSizeY() : brick->getSizeY() - first.sizeY);
+        cutBrick(brick, QPair<LegoBrick, LegoBrick>(brick1, brick2), &newBricks);
+      }
+      foreach(LegoBrick* newBrick, newBricks)
+        bricks.insert(BrickHandle(*newBrick), newBrick);
+      break;
+    }
+    case LegoOperationLog::Remove:
+      removeBrick(brick);
+      break;
+    case LegoOperationLog::ConnectedComponents:
+      connectedComponents();
+      break;
+    case LegoOperationLog::BiconnectedComponents:
+      biconnectedComponents();
+      break;
+    case LegoOperationLog::BrickLimits:
+      //The limits of the recorded run, whatever this cloud was given (logs before version 3 have none)
+      if(!operation.limits.isEmpty())
+        brickLimitation_ = operation.limits;
+      brickLimitConstraint_ = true;
+      break;
+    }
+  }
+
+  merged_ = true;
+  return true;
 }
 
 float LegoCloud::postHollow()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::postHollow");
+  BRICKR_TRACE_ARG("bricksBefore", getBrickNumber());
+
   std::cout << "Begin hollow..." << std::endl;
 //  progress::setNumberOfSteps(levelNumber_, "hollowing...");
 //  progress::setProgress(0);
@@ -748,14 +1148,17 @@ float LegoCloud::postHollow()
   while(noSuccessNumber < innerBricks_.size())
   {
 
-    LegoBrick* randomInnerBrick = innerBricks_[rand()%innerBricks_.size()];
+    LegoBrick* randomInnerBrick = innerBricks_[random_.bounded(innerBricks_.size())];
     if(canRemoveBrick(randomInnerBrick))
     {
+      if(operationLog_)
+        operationLog_->append(LegoOperationLog::Remove, *randomInnerBrick);
       removeBrick(randomInnerBrick);
       noSuccessNumber = 0;
     }
     else
     {
+      EngineCounters::add(EngineCounters::HollowFailedDraws);
       noSuccessNumber++;
     }
   }
@@ -776,6 +1179,7 @@ float LegoCloud::postHollow()
 //  progress::finish();
 
   std::cout << "End hollow" << std::endl;
+  BRICKR_TRACE_ARG("bricksAfter", getBrickNumber());
   //progress::finish();
 
   return time.elapsed()/1000.0;
@@ -783,6 +1187,10 @@ float LegoCloud::postHollow()
 
 void LegoCloud::connectedComponents()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::connectedComponents");
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::ConnectedComponents);
+
   //Vertex index map (input)
   typedef std::map<LegoGraph::vertex_descriptor, int> VertexIndexMap;
   VertexIndexMap vertex_id_map;
@@ -802,17 +1210,19 @@ void LegoCloud::connectedComponents()
   boost::property_map < LegoGraph, int LegoVertex::* >::type component_map = get(&LegoVertex::connected_comp, graph_);
 
   conCompNumber_ = boost::connected_components(graph_, component_map, boost::vertex_index_map(vertex_index_pmap));
+  BRICKR_TRACE_ARG("components", conCompNumber_);
 }
 
 void LegoCloud::splitConComp()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::splitConComp");
   QSet<LegoBrick*> toSplit;
 
   for(int level = 0; level < levelNumber_; level++)
   {
-    QList<LegoBrick>& bricks = bricks_[level];
+    LegoBrickList& bricks = bricks_[level];
 
-    QList<LegoBrick>::iterator brickIt;
+    LegoBrickList::iterator brickIt;
     for(brickIt = bricks.begin(); brickIt!=bricks.end(); brickIt++)
     {
       int connected_comp = graph_[brickToVertex_[&(*brickIt)]].connected_comp;
@@ -829,7 +1239,8 @@ void LegoCloud::splitConComp()
     }
   }
 
-  foreach(LegoBrick* brickToSplit, toSplit)
+  BRICKR_TRACE_ARG("splitBricks", toSplit.size());
+  foreach(LegoBrick* brickToSplit, sortedBricks(toSplit))
   {
     splitBrick(brickToSplit);
   }
@@ -852,6 +1263,10 @@ void LegoCloud::loopConComp()
 
 void LegoCloud::biconnectedComponents()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::biconnectedComponents");
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::BiconnectedComponents);
+
   //Vertex index map (input)
   typedef std::map<LegoGraph::vertex_descriptor, int> VertexIndexMap;
   VertexIndexMap vertex_id_map;
@@ -911,10 +1326,13 @@ void LegoCloud::biconnectedComponents()
     }
 
   }
+  BRICKR_TRACE_ARG("articulationPoints", art_points.size());
+  BRICKR_TRACE_ARG("weakArticulationPoints", badArtPointNumber_);
 }
 
 void LegoCloud::splitBiconComp()
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::splitBiconComp");
   QSet<LegoBrick*> toSplit;
 
   LegoGraph::vertex_iterator vertexIt, vertexItEnd;
@@ -934,7 +1352,8 @@ void LegoCloud::splitBiconComp()
   }
 
 
-  foreach(LegoBrick* brickToSplit, toSplit)
+  BRICKR_TRACE_ARG("splitBricks", toSplit.size());
+  foreach(LegoBrick* brickToSplit, sortedBricks(toSplit))
   {
     splitBrick(brickToSplit);
   }
@@ -963,9 +1382,7 @@ LegoBrick *LegoCloud::addBrick(int level, int posX, int posY, int sizeX, int siz
   assert(!bricks_[level].contains(brick));
 
   //Insert the brick and recuperate the address of the inserted brick
-  bricks_[level].push_back(brick);
-  LegoBrick* newBrickPointer = &(bricks_[level].back());
-  //assert(newBrickIt != bricks_[level].constEnd());
+  LegoBrick* newBrickPointer = bricks_[level].append(brick);
 
   brickNumber_[brick.getSize()]++;
 
@@ -1003,10 +1420,9 @@ bool LegoCloud::removeBrick(LegoBrick *brick)
   //Decrement the number of this brick type
   brickNumber_[brick->getSize()]--;
 
-  bool removeOk = bricks_[brick->getLevel()].removeOne(*brick);//Remove the brick
-  assert(removeOk);
+  bricks_[brick->getLevel()].remove(brick);//Remove the brick, its slot is reused by the next added brick of the level
 
-  return removeOk;
+  return true;
 }
 
 LegoBrick* LegoCloud::mergeBricks(const QSet<LegoBrick *> brickToMerge)//The signature of this method should be changed to (LegoBrick * a, LegoBrick * b)
@@ -1060,6 +1476,9 @@ LegoBrick* LegoCloud::mergeBricks(const QSet<LegoBrick *> brickToMerge)//The sig
          legalBricks_.contains(BrickSize(newBrickSizeY, newBrickSizeX)));//Trying to merge uncompatible bricks
 
   //****OK, merge can begin****
+  const QList<LegoBrick*> orderedBricks = sortedBricks(brickToMerge);
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::Merge, *orderedBricks.first(), *orderedBricks.last());
 
   LegoBrick* newBrick = addBrick(LEVEL, minX, minY, newBrickSizeX, newBrickSizeY);
 
@@ -1084,7 +1503,7 @@ LegoBrick* LegoCloud::mergeBricks(const QSet<LegoBrick *> brickToMerge)//The sig
   if(newColorId != -1)
     newBrick->setColorId(newColorId);
   else
-    newBrick->setColorId((*(brickToMerge.begin()))->getColorId());//If both bricks are inner bricks, we just pick one color
+    newBrick->setColorId(orderedBricks.first()->getColorId());//If both bricks are inner bricks, we just pick one color
 
   newBrick->setIsOuter(isOuter);
 
@@ -1127,18 +1546,23 @@ LegoBrick* LegoCloud::mergeBricks(const QSet<LegoBrick *> brickToMerge)//The sig
     removeBrick(brick);
   }
 
+  EngineCounters::add(EngineCounters::Merges);
   return newBrick;
 }
 
 
 
-bool LegoCloud::splitBrick(LegoBrick *brick)
+bool LegoCloud::splitBrick(LegoBrick *brick, QList<LegoBrick*>* createdBricks)
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::splitBrick");
   if(brick->getKnobNumber() == 1)
   {
     return false;//Brick of size 1x1 connot be split
   }
 
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::Split, *brick);
+
   int level = brick->getLevel();
   int oldBrickPosX = brick->getPosX();
   int oldBrickPosY = brick->getPosY();
@@ -1149,6 +1573,7 @@ bool LegoCloud::splitBrick(LegoBrick *brick)
 
 
   QSet<LegoBrick*> newBricks;
+  QList<LegoBrick*> orderedNewBricks;//The outer and inner lists are filled in this order
   for(int x = oldBrickPosX; x < oldBrickPosX + oldBrickSizeX; x++)
   {
     for(int y = oldBrickPosY; y < oldBrickPosY + oldBrickSizeY; y++)
@@ -1156,6 +1581,7 @@ bool LegoCloud::splitBrick(LegoBrick *brick)
       LegoBrick* newBrick = addBrick(level, x, y, 1, 1);
       newBrick->setColorId(brick->getColorId());
       newBricks.insert(newBrick);
+      orderedNewBricks.append(newBrick);
       neighbourhood_.insert(newBrick, QSet<LegoBrick*>());//Add an empty set of neighbours for each new brick
     }
   }
@@ -1189,7 +1615,7 @@ bool LegoCloud::splitBrick(LegoBrick *brick)
   LegoGraph::adjacency_iterator neighbourIt, neighbourItEnd;
   QSet<LegoGraph::vertex_descriptor> graphNeighbours;
 
-  foreach(LegoBrick *newBrick, newBricks)
+  foreach(LegoBrick *newBrick, orderedNewBricks)
   {
     assert(boost::out_degree(brickToVertex_[newBrick], graph_) == 0);
     graphNeighbours.clear();
@@ -1220,7 +1646,10 @@ bool LegoCloud::splitBrick(LegoBrick *brick)
   }
 
   removeBrick(brick);
+  if(createdBricks)
+    *createdBricks = orderedNewBricks;
 
+  EngineCounters::add(EngineCounters::Splits);
   return true;
 }
 
@@ -1287,10 +1716,11 @@ bool LegoCloud::areConnected(const LegoBrick *brick1, const LegoBrick *brick2)
 
 bool LegoCloud::canMerge(LegoBrick *brick1, LegoBrick *brick2)
 {
+  EngineCounters::add(EngineCounters::CanMergeCalls);
   assert(bricks_[brick1->getLevel()].contains(*brick1));
   assert(bricks_[brick2->getLevel()].contains(*brick2));
 
-  if(brick1->getLevel() != brick1->getLevel())
+  if(brick1->getLevel() != brick2->getLevel())
   {
     std::cerr << "Trying to merge bricks on different levels" << std::endl;
     return false;
@@ -1315,6 +1745,7 @@ bool LegoCloud::canMerge(LegoBrick *brick1, LegoBrick *brick2)
   if(totalKnobNumber < newBrickSizeX*newBrickSizeY)
   {
     //std::cerr << "Trying to merge uncompatible bricks(missing knobs)" << std::endl;
+    EngineCounters::add(EngineCounters::CanMergeRejectedShape);
     return false;
   }
 
@@ -1330,17 +1761,24 @@ bool LegoCloud::canMerge(LegoBrick *brick1, LegoBrick *brick2)
   if(!legalBricks_.contains(BrickSize(newBrickSizeX, newBrickSizeY)))
   {
     //std::cerr << "Trying to merge uncompatible bricks" << std::endl;
+    EngineCounters::add(EngineCounters::CanMergeRejectedSize);
     return false;
   }
 
   if(brick1->isOuter() && brick2->isOuter() && brick1->getColorId() != brick2->getColorId())
+  {
+    EngineCounters::add(EngineCounters::CanMergeRejectedColor);
     return false;
+  }
 
   if(brickLimitConstraint_)
   {
     int limit = brickLimitation_[BrickSize(newBrickSizeX, newBrickSizeY)];
     if(limit != -1 && brickNumber_[BrickSize(newBrickSizeX, newBrickSizeY)] >= limit)
+    {
+      EngineCounters::add(EngineCounters::CanMergeRejectedLimit);
       return false;
+    }
 
   }
 
@@ -1371,6 +1809,7 @@ int LegoCloud::connectionNumber(LegoBrick *brick1, LegoBrick *brick2)
 
 LegoBrick *LegoCloud::findBestNeighbour(LegoBrick *brick, MergeStrategy strategy)
 {
+  EngineCounters::add(EngineCounters::FindBestNeighbourCalls);
   const QSet<LegoBrick*>& neighbours = neighbourhood_.value(brick);
   if(neighbours.size() == 0)
   {
@@ -1391,7 +1830,10 @@ LegoBrick *LegoCloud::findBestNeighbour(LegoBrick *brick, MergeStrategy strategy
     if(possibleNeighbours.size() == 0)
       return NULL;
     else
-      return possibleNeighbours.at(rand() % possibleNeighbours.size());
+    {
+      std::sort(possibleNeighbours.begin(), possibleNeighbours.end(), brickLessThan);
+      return possibleNeighbours.at(random_.bounded(possibleNeighbours.size()));
+    }
   }
   else if(strategy == MaxConnectivity)//Most connections after merge first
   {
@@ -1416,15 +1858,22 @@ LegoBrick *LegoCloud::findBestNeighbour(LegoBrick *brick, MergeStrategy strategy
     if(bestNeighbours.size() == 0)
       return NULL;
     else
-      return bestNeighbours.at(rand() % bestNeighbours.size());//Instead of randomly chosing one, we should consider brick type limit constraints
+    {
+      std::sort(bestNeighbours.begin(), bestNeighbours.end(), brickLessThan);
+      return bestNeighbours.at(random_.bounded(bestNeighbours.size()));//Instead of randomly chosing one, we should consider brick type limit constraints
+    }
 
   }
 
   return NULL;
 }
 
-bool LegoCloud::cutBrick(LegoBrick *oldBrick, QPair<LegoBrick, LegoBrick> newBricks)
+bool LegoCloud::cutBrick(LegoBrick *oldBrick, QPair<LegoBrick, LegoBrick> newBricks, QList<LegoBrick*>* addedBricks)
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::cutBrick");
+
+  if(operationLog_)
+    operationLog_->append(LegoOperationLog::Cut, *oldBrick, newBricks.first);
 
   //add the 2 new bricks
   LegoBrick* newBrick1 = addBrick(newBricks.first.getLevel(), newBricks.first.getPosX(), newBricks.first.getPosY(), newBricks.first.getSizeX(), newBricks.first.getSizeY());
@@ -1489,7 +1938,10 @@ bool LegoCloud::cutBrick(LegoBrick *oldBrick, QPair<LegoBrick, LegoBrick> newBri
   }
 
   removeBrick(oldBrick);
+  if(addedBricks)
+    *addedBricks << newBrick1 << newBrick2;
 
+  EngineCounters::add(EngineCounters::Cuts);
   return true;
 }
 
@@ -1523,6 +1975,9 @@ QVector<QPair<LegoBrick, LegoBrick> > LegoCloud::possibleCuts(LegoBrick *brick)
 
 int LegoCloud::findBestCut(LegoBrick *brick, const QVector<QPair<LegoBrick, LegoBrick> >& cuts)
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::findBestCut");
+  BRICKR_TRACE_ARG("cuts", cuts.size());
+  EngineCounters::add(EngineCounters::CutEvaluations, cuts.size());
   typedef QPair<LegoBrick, LegoBrick> Cut;
   typedef boost::adjacency_list<boost::listS, boost::listS, boost::undirectedS > Subgraph;
 
@@ -1531,6 +1986,7 @@ int LegoCloud::findBestCut(LegoBrick *brick, const QVector<QPair<LegoBrick, Lego
   QVector<LegoGraph::vertex_descriptor> oneRingNeighbours;
 
   //*** First, create an exact 2-ring subgraph around "brick"
+  BRICKR_TRACE_BEGIN(subgraphSpan, "subgraph");
   //Add the center vertex
   Subgraph::vertex_descriptor v0 = boost::add_vertex(subgraph);
   globalToLocal[brickToVertex_[brick]] = v0;
@@ -1583,6 +2039,11 @@ int LegoCloud::findBestCut(LegoBrick *brick, const QVector<QPair<LegoBrick, Lego
     }
   }
 
+  BRICKR_TRACE_END(subgraphSpan);
+  BRICKR_TRACE_ARG("subgraphVertices", boost::num_vertices(subgraph));
+  EngineCounters::add(EngineCounters::SubgraphBuilds);
+  EngineCounters::add(EngineCounters::SubgraphVertices, boost::num_vertices(subgraph));
+  EngineCounters::add(EngineCounters::SubgraphEdges, boost::num_edges(subgraph));
   //Done ***
 
   //*** Then create the vertex index map needed by the connected_components and biconnected_components algo
@@ -1667,12 +2128,15 @@ int LegoCloud::findBestCut(LegoBrick *brick, const QVector<QPair<LegoBrick, Lego
 
 bool LegoCloud::canRemoveBrick(LegoBrick *brick)
 {
+  BRICKR_TRACE_SCOPE("LegoCloud::canRemoveBrick");
+  EngineCounters::add(EngineCounters::CanRemoveBrickCalls);
   typedef boost::adjacency_list<boost::listS, boost::listS, boost::undirectedS > Subgraph;
 
   Subgraph subgraph;
   QMap<LegoGraph::vertex_descriptor, Subgraph::vertex_descriptor> globalToLocal;
 
   //*** First, create an exact 2-ring subgraph around "brick"
+  BRICKR_TRACE_BEGIN(subgraphSpan, "subgraph");
   //Add the center vertex
   Subgraph::vertex_descriptor v0 = boost::add_vertex(subgraph);
   globalToLocal[brickToVertex_[brick]] = v0;
@@ -1724,6 +2188,11 @@ bool LegoCloud::canRemoveBrick(LegoBrick *brick)
     }
   }
 
+  BRICKR_TRACE_END(subgraphSpan);
+  BRICKR_TRACE_ARG("subgraphVertices", boost::num_vertices(subgraph));
+  EngineCounters::add(EngineCounters::SubgraphBuilds);
+  EngineCounters::add(EngineCounters::SubgraphVertices, boost::num_vertices(subgraph));
+  EngineCounters::add(EngineCounters::SubgraphEdges, boost::num_edges(subgraph));
   //Done ***
 
   //*** Then create the vertex index map needed by the connected_components and biconnected_components algo
@@ -1763,7 +2232,295 @@ bool LegoCloud::canRemoveBrick(LegoBrick *brick)
   size_t afterBiconCompNumber = boost::biconnected_components(subgraph, boost::dummy_property_map(), boost::vertex_index_map(vertex_index_pmap));
 
   if(afterConCompNumber <= beforeConCompNumber && afterBiconCompNumber <= beforeBiconCompNumber)
+  {
+    EngineCounters::add(EngineCounters::CanRemoveBrickAccepted);
     return true;
+  }
   else
     return false;
 }
+
+bool LegoCloud::saveProject(const QString &filename) const
+{
+  BRICKR_TRACE_SCOPE("LegoCloud::saveProject");
+  //The project is written aside and only replaces the previous one once it is complete on disk
+  QSaveFile file(filename);
+  if(!file.open(QIODevice::WriteOnly))
+  {
+    std::cerr << "LegoCloud: unable to create or open the file: " << qPrintable(filename) << std::endl;
+    return false;
+  }
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_4_8);
+
+  out << quint32(PROJECT_MAGIC) << quint32(PROJECT_VERSION);
+  out << qint32(height_) << qint32(width_) << qint32(depth_) << qint32(levelNumber_);
+  out << merged_ << brickLimitConstraint_;
+
+  out << qint32(legalColors_.size());
+  foreach(const Color3& color, legalColors_)
+  {
+    out << color[0] << color[1] << color[2];
+  }
+
+  out << qint32(brickLimitation_.size());
+  for(QMap<BrickSize, int>::const_iterator limitIt = brickLimitation_.constBegin(); limitIt != brickLimitation_.constEnd(); ++limitIt)
+  {
+    out << qint32(limitIt.key().first) << qint32(limitIt.key().second) << qint32(limitIt.value());
+  }
+
+  for(int level = 0; level < levelNumber_; level++)
+  {
+    out << qint32(bricks_[level].size());
+    for(LegoBrickList::const_iterator brickIt = bricks_[level].constBegin(); brickIt != bricks_[level].constEnd(); brickIt++)
+    {
+      out << qint32(brickIt->getPosX()) << qint32(brickIt->getPosY())
+          << qint32(brickIt->getSizeX()) << qint32(brickIt->getSizeY())
+          << qint32(brickIt->getColorId()) << brickIt->isOuter();
+    }
+  }
+
+  if(out.status() != QDataStream::Ok)
+  {
+    std::cerr << "LegoCloud: unable to write the file: " << qPrintable(filename) << std::endl;
+    file.cancelWriting();
+    return false;
+  }
+  if(!file.commit())
+  {
+    std::cerr << "LegoCloud: unable to save the file: " << qPrintable(filename) << " (" << qPrintable(file.errorString()) << ")" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool LegoCloud::loadProject(const QString &filename)
+{
+  BRICKR_TRACE_SCOPE("LegoCloud::loadProject");
+  QFile file(filename);
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    std::cerr << "LegoCloud: unable to open the file: " << qPrintable(filename) << std::endl;
+    return false;
+  }
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_4_8);
+
+  quint32 magic, version;
+  in >> magic >> version;
+  if(magic != PROJECT_MAGIC)
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " is not a brickr project." << std::endl;
+    return false;
+  }
+  if(version > PROJECT_VERSION)
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " was saved by a newer version (" << version << ")." << std::endl;
+    return false;
+  }
+
+  removeAllBricks();
+
+  qint32 height, width, depth, levelNumber;
+  in >> height >> width >> depth >> levelNumber;
+  in >> merged_ >> brickLimitConstraint_;
+  if(in.status() != QDataStream::Ok
+     || height < 0 || width < 0 || depth < 0 || levelNumber < 0
+     || height > PROJECT_MAX_EXTENT || width > PROJECT_MAX_EXTENT || depth > PROJECT_MAX_EXTENT || levelNumber > PROJECT_MAX_EXTENT)
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " has invalid dimensions." << std::endl;
+    return false;
+  }
+  height_ = height;
+  width_ = width;
+  depth_ = depth;
+
+  qint32 colorNumber;
+  in >> colorNumber;
+  if(in.status() != QDataStream::Ok || colorNumber < 0 || colorNumber > LegoBrick::MAX_COLOR_ID + 1)
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " has an invalid number of colors." << std::endl;
+    return false;
+  }
+  legalColors_.clear();
+  for(int i = 0; i < colorNumber && in.status() == QDataStream::Ok; i++)
+  {
+    Color3 color;
+    in >> color[0] >> color[1] >> color[2];
+    legalColors_.push_back(color);
+  }
+
+  qint32 limitNumber;
+  in >> limitNumber;
+  for(int i = 0; i < limitNumber && in.status() == QDataStream::Ok; i++)
+  {
+    qint32 sizeX, sizeY, limit;
+    in >> sizeX >> sizeY >> limit;
+    brickLimitation_[BrickSize(sizeX, sizeY)] = limit;
+  }
+
+  //Bricks are appended directly: addBrick() checks for duplicates, which is quadratic per level
+  for(int level = 0; level < levelNumber && in.status() == QDataStream::Ok; level++)
+  {
+    bricks_.push_back(LegoBrickList());
+    levelNumber_ = level+1;
+
+    qint32 brickNumber;
+    in >> brickNumber;
+    for(int i = 0; i < brickNumber && in.status() == QDataStream::Ok; i++)
+    {
+      qint32 posX, posY, sizeX, sizeY, colorId;
+      bool isOuter;
+      in >> posX >> posY >> sizeX >> sizeY >> colorId >> isOuter;
+      if(in.status() != QDataStream::Ok)
+        break;
+
+      //Sizes are checked first, the extent test below relies on them
+      if(!legalBricks_.contains(BrickSize(sizeX, sizeY)) && !legalBricks_.contains(BrickSize(sizeY, sizeX)))
+      {
+        std::cerr << "LegoCloud: " << qPrintable(filename) << " has a brick of an unknown size (" << sizeX << "x" << sizeY << ")." << std::endl;
+        removeAllBricks();
+        return false;
+      }
+      if(posX < 0 || posY < 0 || posX > PROJECT_MAX_EXTENT - sizeX || posY > PROJECT_MAX_EXTENT - sizeY
+         || sizeX > LegoBrick::MAX_SIZE || sizeY > LegoBrick::MAX_SIZE)
+      {
+        std::cerr << "LegoCloud: " << qPrintable(filename) << " has a brick out of the supported range." << std::endl;
+        removeAllBricks();
+        return false;
+      }
+      if(colorId < 0 || colorId >= legalColors_.size() || colorId > LegoBrick::MAX_COLOR_ID)
+      {
+        std::cerr << "LegoCloud: " << qPrintable(filename) << " has a brick of an unknown color (" << colorId << ")." << std::endl;
+        removeAllBricks();
+        return false;
+      }
+
+      LegoBrick* brick = bricks_[level].append(LegoBrick(level, posX, posY, sizeX, sizeY));
+      brick->setColorId(colorId);
+      brick->setIsOuter(isOuter);
+
+      brickNumber_[brick->getSize()]++;
+
+      if(isOuter)
+        outerBricks_.append(brick);
+      else
+        innerBricks_.append(brick);
+
+      LegoGraph::vertex_descriptor vertex = boost::add_vertex(graph_);
+      graph_[vertex].brick = brick;
+      brickToVertex_.insert(brick, vertex);
+
+      if(posX+sizeX > width_)
+        width_ = posX+sizeX;
+      if(posY+sizeY > depth_)
+        depth_ = posY+sizeY;
+    }
+  }
+
+  file.close();
+
+  if(in.status() != QDataStream::Ok)
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " is truncated or corrupted." << std::endl;
+    removeAllBricks();
+    return false;
+  }
+
+  if(!rebuildAdjacency())
+  {
+    std::cerr << "LegoCloud: " << qPrintable(filename) << " is corrupted." << std::endl;
+    removeAllBricks();
+    return false;
+  }
+
+  connectedComponents();
+  biconnectedComponents();
+
+  return true;
+}
+
+bool LegoCloud::rebuildAdjacency()
+{
+  BRICKR_TRACE_SCOPE("LegoCloud::rebuildAdjacency");
+  neighbourhood_.clear();
+  neighbourhood_.reserve(getBrickNumber());
+
+  //Two rasterized levels: the current one and the one below.
+  //loadProject() bounds width_ and depth_ by PROJECT_MAX_EXTENT, the indices are still computed in 64 bits
+  const qint64 gridSize = qint64(width_)*depth_;
+  Q_ASSERT(gridSize <= qint64(PROJECT_MAX_EXTENT)*PROJECT_MAX_EXTENT);
+  std::vector<LegoBrick*> levelGrid(size_t(gridSize), (LegoBrick*)NULL);
+  std::vector<LegoBrick*> belowGrid(size_t(gridSize), (LegoBrick*)NULL);
+
+  for(int level = 0; level < levelNumber_; level++)
+  {
+    std::fill(levelGrid.begin(), levelGrid.end(), (LegoBrick*)NULL);
+    for(LegoBrickList::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
+    {
+      for(int x = brickIt->getPosX(); x < brickIt->getPosX() + brickIt->getSizeX(); x++)
+      {
+        for(int y = brickIt->getPosY(); y < brickIt->getPosY() + brickIt->getSizeY(); y++)
+        {
+          LegoBrick*& cell = levelGrid[qint64(x)*depth_ + y];
+          if(cell != NULL)
+          {
+            std::cerr << "LegoCloud: bricks overlap at level " << level << " (" << x << ", " << y << ")." << std::endl;
+            return false;
+          }
+          cell = &(*brickIt);
+        }
+      }
+    }
+
+    for(LegoBrickList::iterator brickIt = bricks_[level].begin(); brickIt != bricks_[level].end(); brickIt++)
+    {
+      LegoBrick* brick = &(*brickIt);
+      const int minX = brick->getPosX();
+      const int maxX = brick->getPosX() + brick->getSizeX();//Exclusive
+      const int minY = brick->getPosY();
+      const int maxY = brick->getPosY() + brick->getSizeY();//Exclusive
+
+      //Same level neighbours touch one of the four sides
+      QSet<LegoBrick*> neighbours;
+      for(int x = minX; x < maxX; x++)
+      {
+        if(minY > 0 && levelGrid[qint64(x)*depth_ + minY-1] != NULL)
+          neighbours.insert(levelGrid[qint64(x)*depth_ + minY-1]);
+        if(maxY < depth_ && levelGrid[qint64(x)*depth_ + maxY] != NULL)
+          neighbours.insert(levelGrid[qint64(x)*depth_ + maxY]);
+      }
+      for(int y = minY; y < maxY; y++)
+      {
+        if(minX > 0 && levelGrid[qint64(minX-1)*depth_ + y] != NULL)
+          neighbours.insert(levelGrid[qint64(minX-1)*depth_ + y]);
+        if(maxX < width_ && levelGrid[qint64(maxX)*depth_ + y] != NULL)
+          neighbours.insert(levelGrid[qint64(maxX)*depth_ + y]);
+      }
+      neighbourhood_.insert(brick, neighbours);
+
+      //GRAPH: connections are only added towards the level below to prevent multigraph
+      if(level > 0)
+      {
+        QSet<LegoBrick*> connected;
+        for(int x = minX; x < maxX; x++)
+        {
+          for(int y = minY; y < maxY; y++)
+          {
+            LegoBrick* below = belowGrid[qint64(x)*depth_ + y];
+            if(below != NULL && !connected.contains(below))
+            {
+              connected.insert(below);
+              boost::add_edge(brickToVertex_[brick], brickToVertex_[below], graph_);
+            }
+          }
+        }
+      }
+    }
+
+    levelGrid.swap(belowGrid);
+  }
+  return true;
+}
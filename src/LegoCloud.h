@@ -7,14 +7,41 @@
 #include <QPair>
 #include <QMap>
 
+#include <iosfwd>
+#include <vector>
+
 #include "LegoBrick.h"
+#include "LegoBrickList.h"
 #include "LegoGraph.h"
+#include "LegoRandom.h"
+
+class LegoOperationLog;
 
 class LegoCloud
 {
 public:
 
   enum MergeStrategy{Random, MaxConnectivity};
+
+  //Estimated heap bytes of the structures, from the Qt 5 and libstdc++ node layouts and the glibc allocation sizes
+  struct MemoryReport
+  {
+    MemoryReport();
+
+    qint64 bricks;//bricks_
+    qint64 neighbourhood;//neighbourhood_ and its sets
+    qint64 graphVertices;
+    qint64 graphEdges;
+    qint64 brickToVertex;
+    qint64 brickLists;//outerBricks_ and innerBricks_
+    qint64 voxelGrid;
+    qint64 colorsAndLimits;//legalBricks_, legalColors_, brickLimitation_ and brickNumber_
+    qint64 peakResidentBytes;//Of the whole process, -1 if unknown or projected
+
+    qint64 total() const;
+    void print(std::ostream& stream) const;
+  };
+
   LegoCloud();
   ~LegoCloud();
 
@@ -22,7 +49,7 @@ public:
   inline int getLevelNumber() const {return levelNumber_;}
   inline int getConCompNumber() const {return conCompNumber_;}
   inline int getBadArtPointNumber() const {return badArtPointNumber_;}
-  inline const QList<LegoBrick>& getBricks(int level) const {return bricks_[level];}
+  inline const LegoBrickList& getBricks(int level) const {return bricks_[level];}
   inline const QList<LegoBrick*>& getOuterBricks() const {return outerBricks_;}
 
   LegoBrick* addBrick(int level, int posX, int posY);//Add a 1 by 1 brick
@@ -39,6 +66,12 @@ public:
 
   void solveBrickNumberLimitation();
   void setBrickLimit(BrickSize size, int value);
+  inline const QMap<BrickSize, int>& getBrickLimits() const {return brickLimitation_;}
+  inline const QMap<BrickSize, int>& getBrickTypeNumbers() const {return brickNumber_;}
+
+  //Native project format: bricks, colors and limits; the neighbourhood and the graph are rebuilt on load
+  bool saveProject(const QString& filename) const;
+  bool loadProject(const QString& filename);
 
 //  void loadColors(scenegraph::OpenMeshNode *meshNode);
 
@@ -46,6 +79,21 @@ public:
   void printBrickTypes();
   void printStats();
 
+  //Seed of the random choices of merge, findBestNeighbour and postHollow; set it before a run to reproduce it
+  void setSeed(quint64 seed);
+  inline quint64 getSeed() const {return seed_;}
+
+  //The operations are appended to log until setOperationLog(NULL); the log is not owned
+  void setOperationLog(LegoOperationLog* log);
+  //Applies the operations of a log recorded from the same initial state, without any decision
+  bool replay(const LegoOperationLog& log);
+
+  MemoryReport memoryReport() const;
+  //Structures of a resolution^3 voxelization with this ratio of filled voxels, right after buildNeighbourhood
+  //(all the bricks are still 1x1, this is the peak). Interior voxels are assumed: 4 neighbours and one connection.
+  MemoryReport projectMemory(int resolution, double fillRatio) const;
+  double getFillRatio() const;//Voxels covered by the bricks over the cube of the largest dimension
+
   float postHollow();
 
   inline int getWidth() const {return width_;}
@@ -62,27 +110,29 @@ public:
   void splitBiconComp();
   void loopBiconComp();
 
-  inline const QVector<Color3>& getLegalColor() {return legalColors_;}
+  inline const QVector<Color3>& getLegalColor() const {return legalColors_;}
 
 
 private:
   LegoBrick *addBrick(int level, int posX, int posY, int sizeX, int sizeY);//Level must already exist
   bool removeBrick(LegoBrick* brick);
   LegoBrick *mergeBricks(const QSet<LegoBrick *> brickToMerge);
-  bool splitBrick(LegoBrick* brick);
+  bool splitBrick(LegoBrick* brick, QList<LegoBrick*>* createdBricks = NULL);//createdBricks receives the 1x1 bricks
   bool areNeighbours(LegoBrick* brick1, LegoBrick* brick2);//This is for building the neighbourhood (it does not use neighbourhood_)
   bool areConnected(const LegoBrick *brick1, const LegoBrick *brick2);
   bool canMerge(LegoBrick* brick1, LegoBrick* brick2);
   int connectionNumber(LegoBrick* brick1, LegoBrick* brick2);
   LegoBrick* findBestNeighbour(LegoBrick* brick, MergeStrategy strategy);
 
-  bool cutBrick(LegoBrick *oldBrick, QPair<LegoBrick, LegoBrick> newBricks);
+  bool cutBrick(LegoBrick *oldBrick, QPair<LegoBrick, LegoBrick> newBricks, QList<LegoBrick*>* addedBricks = NULL);//addedBricks receives the two bricks
   QVector<QPair<LegoBrick, LegoBrick> > possibleCuts(LegoBrick* brick);
   int findBestCut(LegoBrick *brick, const QVector<QPair<LegoBrick, LegoBrick> >& cuts);//Returns the index of the best cut in "cuts" or -1 if there is no possible cut
 
   bool canRemoveBrick(LegoBrick *brick);
 
-  QVector<QList<LegoBrick> > bricks_;//by level
+  bool rebuildAdjacency();//Rebuilds neighbourhood_ and the graph edges of bricks of any size, fails if bricks overlap
+
+  std::vector<LegoBrickList> bricks_;//by level
   QHash<LegoBrick *, QSet<LegoBrick*> > neighbourhood_;
   QList<LegoBrick*> outerBricks_;
   QList<LegoBrick*> innerBricks_;
@@ -109,6 +159,10 @@ private:
   int conCompNumber_;
   int badArtPointNumber_;
 
+  LegoRandom random_;
+  quint64 seed_;
+  LegoOperationLog* operationLog_;//NULL when not recording
+
   bool merged_;//True after the first merge
   bool brickLimitConstraint_;//If true, then merge will not create more of the bricks that are above the limit
 
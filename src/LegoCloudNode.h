@@ -3,20 +3,27 @@
 
 #include "LegoGraph.h"
 #include "LegoCloud.h"
+#include "LegoExporter.h"
+#include "LegoGraphOverlay.h"
+#include "LegoRenderMesh.h"
 
 #include "Vector3.h"
 #include <QObject>
 
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-class LegoBrick;
 
-class QGraphicsScene;
+class LegoBrick;
 
 class LegoCloudNode : public QObject
 {
   Q_OBJECT
 
 public:
+  //The render mesh keeps one color stream per mode, in this order
   enum ColorRendering {RealColor, Random, ConnectedComp, BiconnectedComp};
 
   explicit LegoCloudNode();
@@ -34,7 +41,7 @@ public:
 
   //New
   inline LegoCloud* getLegoCloud(){ return legoCloud_;}
-  inline void setRenderLayerByLayer(bool v){renderLayerByLayer_ = v;}
+  inline void setRenderLayerByLayer(bool v){renderLayerByLayer_ = v; drawDirty_ = true;}
   inline void setRenderLayer(int layer){
     if(layer >= legoCloud_->getLevelNumber())
     {
@@ -53,33 +60,55 @@ public:
   inline void setRenderGraph(bool v){renderGraph_ = v;}
   inline void setColorRendering(ColorRendering col){colorRendering_ = col;}
 
-  void nodeUpdated() { drawDirty_ = true; recomputeAABB(); }
+  //Must be called after the cloud is modified, the render mesh is rebuilt in the background from the next frame
+  void nodeUpdated() { drawDirty_ = true; graphDirty_ = true; recomputeAABB(); }
 
-  void drawInstructions(QGraphicsScene* scene, bool hintLayerBelow);
-  void exportToObj(QString filename);
+  bool exportMesh(QString filename, const LegoExporter::Options& options = LegoExporter::Options());
 
   Vector3 minPoint() { return boundsMin_; }
   Vector3 maxPoint() { return boundsMax_; }
 
+signals:
+  //A new render mesh is ready to be displayed, emitted from the builder thread
+  void meshReady();
+
 private:
-  void drawLegoBrick(const LegoBrick& brick) const;
-  void drawBox(const Vector3& p1, const Vector3& p2) const;
-  void drawBrickOutline(const LegoBrick &brick) const;
-  void drawKnobs(const LegoBrick& brick, const Vector3 &p1) const;
+  //Copy of the displayed bricks and their colors in every mode, so that the mesh can be built while the cloud changes
+  struct RenderSnapshot
+  {
+    int levelNumber;
+    int width;
+    int depth;
+    bool separateLevels;
+    std::vector<std::vector<LegoBrick> > bricks;//Per level
+    std::vector<std::vector<LegoRenderMesh::BrickColors> > colors;
+  };
+
+  void startMeshBuild();
+  static void buildGeometry(const RenderSnapshot& snapshot, LegoRenderMesh::Geometry& geometry);
   void drawNeighbourhood(const LegoBrick& brick, const QSet<LegoBrick*>& neighbours) const;
-  void drawLegoGraph(const LegoGraph& graph) const;
-  void setColor(const LegoGraph::vertex_descriptor &vertex) const;
+  Color3 brickColor(const LegoGraph::vertex_descriptor &vertex, ColorRendering colorRendering) const;
+  LegoRenderMesh::BrickColors brickColors(const LegoGraph::vertex_descriptor &vertex) const;
 
   Vector3 boundsMin_, boundsMax_;
 
   LegoCloud* legoCloud_;
   bool renderLayerByLayer_;
   int renderLayer_;
-  uint32_t knobList_;
   bool renderBricks_;
   bool renderGraph_;
   ColorRendering colorRendering_;
   bool drawDirty_;
+  LegoRenderMesh renderMesh_;
+
+  //Background mesh build, at most one at a time
+  std::thread meshThread_;
+  std::mutex readyGeometryMutex_;
+  std::unique_ptr<LegoRenderMesh::Geometry> readyGeometry_;
+
+  //Rebuilt on the next frame it is displayed after the graph changes
+  bool graphDirty_;
+  LegoGraphOverlay graphOverlay_;
 };
 
 #endif
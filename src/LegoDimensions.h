@@ -13,4 +13,13 @@ const double LEGO_KNOB_RADIUS = 0.0024;
 const double LEGO_HORIZONTAL_TOLERANCE = 0.0001;//per side
 //const double LEGO_HORIZONTAL_TOLERANCE = 0.001;//per side
 
+//Knob circle used for display: (cos, sin) of -i*2*PI/KNOB_RESOLUTION_DISPLAY
+const int KNOB_RESOLUTION_DISPLAY = 16;
+const float KNOB_CIRCLE[KNOB_RESOLUTION_DISPLAY][2] = {
+  { 1.00000000f,  0.00000000f}, { 0.92387953f, -0.38268343f}, { 0.70710678f, -0.70710678f}, { 0.38268343f, -0.92387953f},
+  { 0.00000000f, -1.00000000f}, {-0.38268343f, -0.92387953f}, {-0.70710678f, -0.70710678f}, {-0.92387953f, -0.38268343f},
+  {-1.00000000f,  0.00000000f}, {-0.92387953f,  0.38268343f}, {-0.70710678f,  0.70710678f}, {-0.38268343f,  0.92387953f},
+  { 0.00000000f,  1.00000000f}, { 0.38268343f,  0.92387953f}, { 0.70710678f,  0.70710678f}, { 0.92387953f,  0.38268343f}
+};
+
 #endif
@@ -0,0 +1,743 @@
+#include "LegoExporter.h"
+
+#include "LegoCloud.h"
+#include "LegoDimensions.h"
+#include "LegoMesher.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <qmath.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#define KNOB_RESOLUTION_EXPORT 15
+#define EXPORT_VERTICAL_TOLERANCE 0.0001
+
+namespace
+{
+
+typedef std::pair<int, int> BrickType;//(sizeX, sizeY), the orientation matters for the geometry
+
+//Geometry of one brick type, relative to the brick origin (posX*pitch, level*height, posY*pitch)
+struct BrickTemplate
+{
+  std::vector<float> vertices;//x y z
+  std::vector<int> faceSizes;
+  std::vector<int> faceIndices;//0-based, relative to the first vertex of the brick
+  int smoothFaceStart;//Faces from this one on are the knob cylinders
+  int triangleNumber;
+
+  inline int vertexNumber() const {return int(vertices.size()/3);}
+  inline int faceNumber() const {return int(faceSizes.size());}
+};
+
+typedef std::map<BrickType, BrickTemplate> TemplateMap;
+
+void addFace(BrickTemplate& brickTemplate, int a, int b, int c, int d)
+{
+  brickTemplate.faceSizes.push_back(4);
+  brickTemplate.faceIndices.push_back(a);
+  brickTemplate.faceIndices.push_back(b);
+  brickTemplate.faceIndices.push_back(c);
+  brickTemplate.faceIndices.push_back(d);
+}
+
+//Knobs of the template whose box is already built, skipping the covered ones when occupancy is given
+void addKnobs(BrickTemplate& brickTemplate, const LegoBrick& brick, const LegoOccupancy* occupancy)
+{
+  const int firstKnobVertex = brickTemplate.vertexNumber();
+
+  //Knob vertices: a top and a bottom ring per knob
+  int knobNumber = 0;
+  const double knobCenter[3] = {LEGO_HORIZONTAL_TOLERANCE + LEGO_KNOB_DISTANCE/2.0, LEGO_HEIGHT + LEGO_KNOB_HEIGHT, LEGO_HORIZONTAL_TOLERANCE + LEGO_KNOB_DISTANCE/2.0};
+  for(int x = 0; x < brick.getSizeX(); ++x)
+  {
+    for(int y = 0; y < brick.getSizeY(); ++y)
+    {
+      if(LegoMesher::isKnobCovered(brick, x, y, occupancy))
+        continue;
+
+      for(int i = 0; i < KNOB_RESOLUTION_EXPORT; ++i)
+      {
+        const double angle = -i*(2*M_PI/double(KNOB_RESOLUTION_EXPORT));
+        const double vx = knobCenter[0] + x*LEGO_KNOB_DISTANCE + cos(angle)*LEGO_KNOB_RADIUS;
+        const double vz = knobCenter[2] + y*LEGO_KNOB_DISTANCE + sin(angle)*LEGO_KNOB_RADIUS;
+
+        brickTemplate.vertices.push_back(vx);
+        brickTemplate.vertices.push_back(knobCenter[1]);
+        brickTemplate.vertices.push_back(vz);
+
+        brickTemplate.vertices.push_back(vx);
+        brickTemplate.vertices.push_back(knobCenter[1] - LEGO_KNOB_HEIGHT);
+        brickTemplate.vertices.push_back(vz);
+      }
+      knobNumber++;
+    }
+  }
+
+  //Top caps
+  for(int knob = 0; knob < knobNumber; ++knob)
+  {
+    const int knobIndex = firstKnobVertex + knob*(2*KNOB_RESOLUTION_EXPORT);
+    brickTemplate.faceSizes.push_back(KNOB_RESOLUTION_EXPORT);
+    for(int i = 0; i < KNOB_RESOLUTION_EXPORT; ++i)
+    {
+      brickTemplate.faceIndices.push_back(knobIndex + 2*i);
+    }
+  }
+
+  //Cylinders
+  brickTemplate.smoothFaceStart = brickTemplate.faceNumber();
+  for(int knob = 0; knob < knobNumber; ++knob)
+  {
+    const int knobIndex = firstKnobVertex + knob*(2*KNOB_RESOLUTION_EXPORT);
+    for(int i = 0; i < KNOB_RESOLUTION_EXPORT; ++i)
+    {
+      const int next = (i+1) % KNOB_RESOLUTION_EXPORT;//The last face connects to the first vertices
+      addFace(brickTemplate, knobIndex + 2*i, knobIndex + 2*i+1, knobIndex + 2*next+1, knobIndex + 2*next);
+    }
+  }
+
+  brickTemplate.triangleNumber = 0;
+  for(int f = 0; f < brickTemplate.faceNumber(); f++)
+  {
+    brickTemplate.triangleNumber += brickTemplate.faceSizes[f] - 2;
+  }
+}
+
+//Full geometry of a brick type, shared by all the bricks of that type
+BrickTemplate buildTemplate(int sizeX, int sizeY)
+{
+  BrickTemplate brickTemplate;
+
+  const double p1[3] = {LEGO_HORIZONTAL_TOLERANCE, EXPORT_VERTICAL_TOLERANCE, LEGO_HORIZONTAL_TOLERANCE};//Back corner down left
+  const double p2[3] = {p1[0] + sizeX*LEGO_KNOB_DISTANCE - LEGO_HORIZONTAL_TOLERANCE,
+                        p1[1] + LEGO_HEIGHT - EXPORT_VERTICAL_TOLERANCE,
+                        p1[2] + sizeY*LEGO_KNOB_DISTANCE - LEGO_HORIZONTAL_TOLERANCE};//Front corner up right
+
+  //8 vertices of the box
+  for(int i = 0; i < 8; i++)
+  {
+    brickTemplate.vertices.push_back((i & 4) ? p2[0] : p1[0]);
+    brickTemplate.vertices.push_back((i & 2) ? p2[1] : p1[1]);
+    brickTemplate.vertices.push_back((i & 1) ? p2[2] : p1[2]);
+  }
+
+  addFace(brickTemplate, 0, 1, 3, 2);//left
+  addFace(brickTemplate, 4, 6, 7, 5);//right
+  addFace(brickTemplate, 0, 4, 5, 1);//bottom
+  addFace(brickTemplate, 2, 3, 7, 6);//top
+  addFace(brickTemplate, 0, 2, 6, 4);//back
+  addFace(brickTemplate, 1, 5, 7, 3);//front
+
+  addKnobs(brickTemplate, LegoBrick(0, 0, 0, sizeX, sizeY), NULL);
+  return brickTemplate;
+}
+
+//Culled geometry of a level: the uncovered knobs of each exported brick, and the visible box faces merged across
+//the bricks of the level in one template per color, with absolute positions
+struct CulledLevel
+{
+  std::vector<BrickTemplate> knobTemplates;
+  std::vector<std::pair<int, BrickTemplate> > faceTemplates;//(color id, faces)
+};
+
+void buildMergedFaces(const LegoCloud& legoCloud, int level, const LegoOccupancy& occupancy, bool outerOnly,
+                      std::vector<std::pair<int, BrickTemplate> >& faceTemplates)
+{
+  std::vector<LegoMesher::Quad> quads;
+  std::vector<int> colorIds;
+  LegoMesher::mergedLevelFaces(legoCloud, level, occupancy, outerOnly, quads, colorIds);
+
+  std::vector<size_t> order(quads.size());
+  for(size_t q = 0; q < order.size(); q++)
+    order[q] = q;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {return colorIds[a] < colorIds[b];});
+
+  std::map<std::tuple<float, float, float>, int> vertexIndices;//Corners shared by the quads of the current color
+  for(size_t i = 0; i < order.size(); i++)
+  {
+    const int colorId = colorIds[order[i]];
+    if(faceTemplates.empty() || faceTemplates.back().first != colorId)
+    {
+      faceTemplates.push_back(std::make_pair(colorId, BrickTemplate()));
+      faceTemplates.back().second.triangleNumber = 0;
+      vertexIndices.clear();
+    }
+
+    BrickTemplate& faceTemplate = faceTemplates.back().second;
+    const LegoMesher::Quad& quad = quads[order[i]];
+    int corners[4];
+    for(int c = 0; c < 4; c++)
+    {
+      const std::tuple<float, float, float> corner(quad.corners[c][0], quad.corners[c][1], quad.corners[c][2]);
+      std::map<std::tuple<float, float, float>, int>::iterator vertexIt = vertexIndices.find(corner);
+      if(vertexIt == vertexIndices.end())
+      {
+        vertexIt = vertexIndices.insert(std::make_pair(corner, faceTemplate.vertexNumber())).first;
+        for(int k = 0; k < 3; k++)
+          faceTemplate.vertices.push_back(quad.corners[c][k]);
+      }
+      corners[c] = vertexIt->second;
+    }
+    addFace(faceTemplate, corners[0], corners[1], corners[2], corners[3]);
+    faceTemplate.triangleNumber += 2;
+  }
+
+  for(size_t t = 0; t < faceTemplates.size(); t++)
+    faceTemplates[t].second.smoothFaceStart = faceTemplates[t].second.faceNumber();//No knob cylinders
+}
+
+//Text formatting straight into the output buffer, without locale or stream state
+inline void appendInt(QByteArray& out, long long value)
+{
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+
+  const bool negative = value < 0;
+  unsigned long long magnitude = negative ? -value : value;
+  do
+  {
+    *--p = char('0' + magnitude%10);
+    magnitude /= 10;
+  } while(magnitude != 0);
+
+  if(negative)
+    *--p = '-';
+
+  out.append(p, int(end - p));
+}
+
+//Fixed point with 7 decimals, trailing zeros removed
+inline void appendFloat(QByteArray& out, double value)
+{
+  char buffer[32];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+
+  const bool negative = value < 0.0;
+  unsigned long long scaled = (unsigned long long)((negative ? -value : value)*1e7 + 0.5);
+
+  int fractionDigits = 7;
+  while(fractionDigits > 0 && scaled % 10 == 0)
+  {
+    scaled /= 10;
+    fractionDigits--;
+  }
+
+  for(int i = 0; i < fractionDigits; i++)
+  {
+    *--p = char('0' + scaled%10);
+    scaled /= 10;
+  }
+  if(fractionDigits > 0)
+    *--p = '.';
+
+  do
+  {
+    *--p = char('0' + scaled%10);
+    scaled /= 10;
+  } while(scaled != 0);
+
+  if(negative && !(p[0] == '0' && p+1 == end))
+    *--p = '-';
+
+  out.append(p, int(end - p));
+}
+
+template<typename T>
+inline void appendLittleEndian(QByteArray& out, T value)
+{
+  T littleEndian = qToLittleEndian(value);
+  out.append(reinterpret_cast<const char*>(&littleEndian), sizeof(T));
+}
+
+inline void appendLittleEndian(QByteArray& out, float value)
+{
+  quint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  appendLittleEndian<quint32>(out, bits);
+}
+
+//What must be known about a level before it can be written independently of the others
+struct LevelInfo
+{
+  LevelInfo() : brickOffset(0), vertexOffset(0), faceNumber(0), triangleNumber(0) {}
+
+  long long brickOffset;
+  long long vertexOffset;
+  long long faceNumber;
+  long long triangleNumber;
+};
+
+struct LevelOutput
+{
+  QByteArray first;//Vertices (Ply), everything else for the other formats
+  QByteArray second;//Faces (Ply)
+};
+
+class LevelWriter
+{
+public:
+  //With an occupancy, every brick gets its own knobs and the box faces of each level are merged instead of the shared templates.
+  //The culled geometry of a level is built by count() and kept in culledLevels until write() has used it
+  LevelWriter(const LegoCloud& legoCloud, const LegoExporter::Options& options, const TemplateMap& templates, const std::vector<LevelInfo>& levelInfos,
+              const LegoOccupancy* occupancy, std::vector<CulledLevel>& culledLevels)
+    : legoCloud_(legoCloud), options_(options), templates_(templates), levelInfos_(levelInfos), occupancy_(occupancy), culledLevels_(culledLevels)
+  {
+  }
+
+  //Builds the culled geometry of a level and adds up its sizes, the offsets are left to the caller
+  void count(int level, LevelInfo& info) const
+  {
+    CulledLevel& culledLevel = culledLevels_[level];
+
+    const LegoBrickList& bricks = legoCloud_.getBricks(level);
+    culledLevel.knobTemplates.reserve(bricks.size());
+    for(LegoBrickList::const_iterator brickIt = bricks.constBegin(); brickIt != bricks.constEnd(); brickIt++)
+    {
+      if(options_.outerOnly && !brickIt->isOuter())
+        continue;
+
+      culledLevel.knobTemplates.push_back(BrickTemplate());
+      BrickTemplate& knobTemplate = culledLevel.knobTemplates.back();
+      addKnobs(knobTemplate, *brickIt, occupancy_);
+      info.brickOffset++;
+      info.vertexOffset += knobTemplate.vertexNumber();
+      info.faceNumber += knobTemplate.faceNumber();
+      info.triangleNumber += knobTemplate.triangleNumber;
+    }
+
+    buildMergedFaces(legoCloud_, level, *occupancy_, options_.outerOnly, culledLevel.faceTemplates);
+    for(size_t t = 0; t < culledLevel.faceTemplates.size(); t++)
+    {
+      const BrickTemplate& faceTemplate = culledLevel.faceTemplates[t].second;
+      info.vertexOffset += faceTemplate.vertexNumber();
+      info.faceNumber += faceTemplate.faceNumber();
+      info.triangleNumber += faceTemplate.triangleNumber;
+    }
+  }
+
+  void write(int level, LevelOutput& output) const
+  {
+    long long brickIndex = levelInfos_[level].brickOffset;
+    long long vertexIndex = levelInfos_[level].vertexOffset;
+
+    CulledLevel& culledLevel = culledLevels_[level];
+    size_t culledIndex = 0;
+
+    const LegoBrickList& bricks = legoCloud_.getBricks(level);
+    for(LegoBrickList::const_iterator brickIt = bricks.constBegin(); brickIt != bricks.constEnd(); brickIt++)
+    {
+      if(options_.outerOnly && !brickIt->isOuter())
+        continue;
+
+      const BrickTemplate& brickTemplate = occupancy_ ? culledLevel.knobTemplates[culledIndex++] : templates_.find(BrickType(brickIt->getSizeX(), brickIt->getSizeY()))->second;
+      const double origin[3] = {brickIt->getPosX()*LEGO_KNOB_DISTANCE, brickIt->getLevel()*LEGO_HEIGHT, brickIt->getPosY()*LEGO_KNOB_DISTANCE};
+
+      switch(options_.format)
+      {
+        case LegoExporter::Obj:
+          writeObjBrick(brickTemplate, origin, brickIndex, vertexIndex, output.first);
+          break;
+        case LegoExporter::InstancedObj:
+          writeInstance(*brickIt, origin, output.first);
+          break;
+        case LegoExporter::Ply:
+          writePlyBrick(brickIt->getColorId(), brickTemplate, origin, vertexIndex, output.first, output.second);
+          break;
+        case LegoExporter::Stl:
+          writeStlBrick(brickTemplate, origin, output.first);
+          break;
+      }
+
+      brickIndex++;
+      vertexIndex += brickTemplate.vertexNumber();
+    }
+
+    //The merged faces have absolute positions
+    const double noOrigin[3] = {0.0, 0.0, 0.0};
+    for(size_t t = 0; t < culledLevel.faceTemplates.size(); t++)
+    {
+      const int colorId = culledLevel.faceTemplates[t].first;
+      const BrickTemplate& faceTemplate = culledLevel.faceTemplates[t].second;
+
+      switch(options_.format)
+      {
+        case LegoExporter::Obj:
+          writeObjFaceGroup(faceTemplate, level, colorId, vertexIndex, output.first);
+          break;
+        case LegoExporter::InstancedObj:
+          break;//Never culled
+        case LegoExporter::Ply:
+          writePlyBrick(colorId, faceTemplate, noOrigin, vertexIndex, output.first, output.second);
+          break;
+        case LegoExporter::Stl:
+          writeStlBrick(faceTemplate, noOrigin, output.first);
+          break;
+      }
+
+      vertexIndex += faceTemplate.vertexNumber();
+    }
+
+    std::vector<BrickTemplate>().swap(culledLevel.knobTemplates);//Release the level geometry, the text holds it now
+    std::vector<std::pair<int, BrickTemplate> >().swap(culledLevel.faceTemplates);
+  }
+
+private:
+  static void writeObjVertices(const BrickTemplate& brickTemplate, const double origin[3], QByteArray& out)
+  {
+    for(size_t v = 0; v < brickTemplate.vertices.size(); v += 3)
+    {
+      out.append("v ");
+      appendFloat(out, origin[0] + brickTemplate.vertices[v]);
+      out.append(' ');
+      appendFloat(out, origin[1] + brickTemplate.vertices[v+1]);
+      out.append(' ');
+      appendFloat(out, origin[2] + brickTemplate.vertices[v+2]);
+      out.append('\n');
+    }
+  }
+
+  static void writeObjBrick(const BrickTemplate& brickTemplate, const double origin[3], long long brickIndex, long long firstVertex, QByteArray& out)
+  {
+    writeObjVertices(brickTemplate, origin, out);
+    out.append("g brick");
+    appendInt(out, brickIndex);
+    out.append("\ns off\n");
+    writeObjFaces(brickTemplate, firstVertex + 1, out);
+  }
+
+  static void writeObjFaceGroup(const BrickTemplate& faceTemplate, int level, int colorId, long long firstVertex, QByteArray& out)
+  {
+    const double noOrigin[3] = {0.0, 0.0, 0.0};
+    writeObjVertices(faceTemplate, noOrigin, out);
+    out.append("g level");
+    appendInt(out, level);
+    out.append("_color");
+    appendInt(out, colorId);
+    out.append("\ns off\n");
+    writeObjFaces(faceTemplate, firstVertex + 1, out);
+  }
+
+  static void writeInstance(const LegoBrick& brick, const double origin[3], QByteArray& out)
+  {
+    appendInt(out, brick.getSizeX());
+    out.append('x');
+    appendInt(out, brick.getSizeY());
+    out.append(' ');
+    appendFloat(out, origin[0]);
+    out.append(' ');
+    appendFloat(out, origin[1]);
+    out.append(' ');
+    appendFloat(out, origin[2]);
+    out.append(' ');
+    appendInt(out, brick.getColorId());
+    out.append('\n');
+  }
+
+  void writePlyBrick(int colorId, const BrickTemplate& brickTemplate, const double origin[3], long long firstVertex, QByteArray& vertexOut, QByteArray& faceOut) const
+  {
+    const Color3& color = legoCloud_.getLegalColor()[colorId];
+    const uchar rgb[3] = {uchar(color[0]*255.0f), uchar(color[1]*255.0f), uchar(color[2]*255.0f)};
+
+    for(size_t v = 0; v < brickTemplate.vertices.size(); v += 3)
+    {
+      appendLittleEndian(vertexOut, float(origin[0] + brickTemplate.vertices[v]));
+      appendLittleEndian(vertexOut, float(origin[1] + brickTemplate.vertices[v+1]));
+      appendLittleEndian(vertexOut, float(origin[2] + brickTemplate.vertices[v+2]));
+      vertexOut.append(reinterpret_cast<const char*>(rgb), 3);
+    }
+
+    int index = 0;
+    for(int f = 0; f < brickTemplate.faceNumber(); f++)
+    {
+      faceOut.append(char(brickTemplate.faceSizes[f]));
+      for(int i = 0; i < brickTemplate.faceSizes[f]; i++)
+      {
+        appendLittleEndian<qint32>(faceOut, qint32(firstVertex + brickTemplate.faceIndices[index++]));
+      }
+    }
+  }
+
+  static void writeStlBrick(const BrickTemplate& brickTemplate, const double origin[3], QByteArray& out)
+  {
+    int index = 0;
+    for(int f = 0; f < brickTemplate.faceNumber(); f++)
+    {
+      const int* face = &brickTemplate.faceIndices[index];
+      index += brickTemplate.faceSizes[f];
+
+      for(int i = 1; i+1 < brickTemplate.faceSizes[f]; i++)
+      {
+        const float* a = &brickTemplate.vertices[3*face[0]];
+        const float* b = &brickTemplate.vertices[3*face[i]];
+        const float* c = &brickTemplate.vertices[3*face[i+1]];
+
+        Vector3 normal = cross(Vector3(b[0]-a[0], b[1]-a[1], b[2]-a[2]), Vector3(c[0]-a[0], c[1]-a[1], c[2]-a[2]));
+        if(normal.squaredNorm() > 0.0f)
+          normal = normal.normalize();
+
+        for(int k = 0; k < 3; k++)
+          appendLittleEndian(out, normal[k]);
+
+        const float* corners[3] = {a, b, c};
+        for(int corner = 0; corner < 3; corner++)
+        {
+          for(int k = 0; k < 3; k++)
+            appendLittleEndian(out, float(origin[k] + corners[corner][k]));
+        }
+
+        appendLittleEndian<quint16>(out, 0);//Attribute byte count
+      }
+    }
+  }
+
+public:
+  static void writeObjFaces(const BrickTemplate& brickTemplate, long long firstVertex, QByteArray& out)
+  {
+    int index = 0;
+    for(int f = 0; f < brickTemplate.faceNumber(); f++)
+    {
+      if(f == brickTemplate.smoothFaceStart)
+        out.append("s 1\n");
+
+      out.append('f');
+      for(int i = 0; i < brickTemplate.faceSizes[f]; i++)
+      {
+        out.append(' ');
+        appendInt(out, firstVertex + brickTemplate.faceIndices[index++]);
+      }
+      out.append('\n');
+    }
+  }
+
+private:
+  const LegoCloud& legoCloud_;
+  const LegoExporter::Options& options_;
+  const TemplateMap& templates_;
+  const std::vector<LevelInfo>& levelInfos_;
+  const LegoOccupancy* occupancy_;
+  std::vector<CulledLevel>& culledLevels_;
+};
+
+//Runs function(level) for every level, the threads take the next level when they are done with one
+template<typename Function>
+void forEachLevel(int levelNumber, int threadCount, Function function)
+{
+  std::atomic<int> nextLevel(0);
+  std::vector<std::thread> threads;
+  for(int i = 0; i < threadCount; i++)
+  {
+    threads.push_back(std::thread([&]()
+    {
+      for(int level = nextLevel++; level < levelNumber; level = nextLevel++)
+      {
+        function(level);
+      }
+    }));
+  }
+  for(size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i].join();
+  }
+}
+
+QByteArray plyHeader(long long vertexNumber, long long faceNumber)
+{
+  QByteArray header;
+  header.append("ply\nformat binary_little_endian 1.0\ncomment brickr export\n");
+  header.append("element vertex " + QByteArray::number(vertexNumber) + "\n");
+  header.append("property float x\nproperty float y\nproperty float z\n");
+  header.append("property uchar red\nproperty uchar green\nproperty uchar blue\n");
+  header.append("element face " + QByteArray::number(faceNumber) + "\n");
+  header.append("property list uchar int vertex_indices\nend_header\n");
+  return header;
+}
+
+QByteArray stlHeader(long long triangleNumber)
+{
+  QByteArray header("brickr binary STL");
+  header.append(QByteArray(80 - header.size(), '\0'));
+  appendLittleEndian<quint32>(header, quint32(triangleNumber));
+  return header;
+}
+
+QByteArray instancedObjPrototypes(const TemplateMap& templates)
+{
+  QByteArray out("# One object per brick type, placed at the origin.\n"
+                 "# The bricks are listed in the .instances.txt file: <type> <translation x y z> <color id>\n");
+
+  long long firstVertex = 1;
+  for(TemplateMap::const_iterator templateIt = templates.begin(); templateIt != templates.end(); ++templateIt)
+  {
+    const BrickTemplate& brickTemplate = templateIt->second;
+
+    out.append("o brick_");
+    appendInt(out, templateIt->first.first);
+    out.append('x');
+    appendInt(out, templateIt->first.second);
+    out.append('\n');
+
+    for(size_t v = 0; v < brickTemplate.vertices.size(); v += 3)
+    {
+      out.append("v ");
+      appendFloat(out, brickTemplate.vertices[v]);
+      out.append(' ');
+      appendFloat(out, brickTemplate.vertices[v+1]);
+      out.append(' ');
+      appendFloat(out, brickTemplate.vertices[v+2]);
+      out.append('\n');
+    }
+
+    out.append("s off\n");
+    LevelWriter::writeObjFaces(brickTemplate, firstVertex, out);
+    firstVertex += brickTemplate.vertexNumber();
+  }
+
+  return out;
+}
+
+}
+
+bool LegoExporter::exportCloud(const LegoCloud& legoCloud, const QString& filename, const Options& options)
+{
+  const int levelNumber = legoCloud.getLevelNumber();
+
+  int threadCount = options.threadCount > 0 ? options.threadCount : int(std::max(1u, std::thread::hardware_concurrency()));
+  threadCount = std::max(1, std::min(threadCount, levelNumber));
+
+  //The instanced prototypes are shared by all the bricks, they cannot be culled
+  std::unique_ptr<LegoOccupancy> occupancy;
+  if(options.cullHidden && options.format != InstancedObj)
+    occupancy.reset(new LegoOccupancy(legoCloud, options.outerOnly));
+
+  //Tessellate each brick type once (or build the culled geometry of every level) and compute the offsets of every level
+  TemplateMap templates;
+  std::vector<LevelInfo> levelInfos(levelNumber);
+  std::vector<CulledLevel> culledLevels(levelNumber);
+  const LevelWriter writer(legoCloud, options, templates, levelInfos, occupancy.get(), culledLevels);
+
+  if(occupancy)
+  {
+    forEachLevel(levelNumber, threadCount, [&](int level) {writer.count(level, levelInfos[level]);});
+  }
+  else
+  {
+    for(int level = 0; level < levelNumber; level++)
+    {
+      const LegoBrickList& bricks = legoCloud.getBricks(level);
+      for(LegoBrickList::const_iterator brickIt = bricks.constBegin(); brickIt != bricks.constEnd(); brickIt++)
+      {
+        if(options.outerOnly && !brickIt->isOuter())
+          continue;
+
+        const BrickType type(brickIt->getSizeX(), brickIt->getSizeY());
+        TemplateMap::iterator templateIt = templates.find(type);
+        if(templateIt == templates.end())
+          templateIt = templates.insert(std::make_pair(type, buildTemplate(type.first, type.second))).first;
+
+        levelInfos[level].brickOffset++;
+        levelInfos[level].vertexOffset += templateIt->second.vertexNumber();
+        levelInfos[level].faceNumber += templateIt->second.faceNumber();
+        levelInfos[level].triangleNumber += templateIt->second.triangleNumber;
+      }
+    }
+  }
+
+  //Level sizes to offsets
+  LevelInfo total;
+  for(int level = 0; level < levelNumber; level++)
+  {
+    const LevelInfo size = levelInfos[level];
+    levelInfos[level].brickOffset = total.brickOffset;
+    levelInfos[level].vertexOffset = total.vertexOffset;
+
+    total.brickOffset += size.brickOffset;
+    total.vertexOffset += size.vertexOffset;
+    total.faceNumber += size.faceNumber;
+    total.triangleNumber += size.triangleNumber;
+  }
+
+  //Write the levels in parallel
+  std::vector<LevelOutput> outputs(levelNumber);
+  forEachLevel(levelNumber, threadCount, [&](int level) {writer.write(level, outputs[level]);});
+
+  //Concatenate
+  QFile file(filename);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    std::cerr << "LegoExporter: unable to create or open the file: " << qPrintable(filename) << std::endl;
+    return false;
+  }
+
+  QFile instanceFile;
+  QFile* chunkFile = &file;
+
+  switch(options.format)
+  {
+    case Obj:
+      file.write("# brickr export\n");
+      break;
+    case InstancedObj:
+    {
+      const QFileInfo fileInfo(filename);
+      instanceFile.setFileName(fileInfo.absolutePath() + "/" + fileInfo.completeBaseName() + ".instances.txt");
+      if(!instanceFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+      {
+        std::cerr << "LegoExporter: unable to create or open the file: " << qPrintable(instanceFile.fileName()) << std::endl;
+        return false;
+      }
+      file.write(instancedObjPrototypes(templates));
+      chunkFile = &instanceFile;
+      break;
+    }
+    case Ply:
+      file.write(plyHeader(total.vertexOffset, total.faceNumber));
+      break;
+    case Stl:
+      file.write(stlHeader(total.triangleNumber));
+      break;
+  }
+
+  for(int level = 0; level < levelNumber; level++)
+  {
+    chunkFile->write(outputs[level].first);
+    outputs[level].first.clear();
+  }
+
+  for(int level = 0; level < levelNumber; level++)
+  {
+    chunkFile->write(outputs[level].second);
+    outputs[level].second.clear();
+  }
+
+  const bool ok = file.error() == QFile::NoError && chunkFile->error() == QFile::NoError;
+  file.close();
+  if(instanceFile.isOpen())
+    instanceFile.close();
+
+  std::cout << "Exported " << total.brickOffset << " bricks (" << total.triangleNumber << " triangles) to " << qPrintable(filename) << std::endl;
+
+  return ok;
+}
+
+LegoExporter::Format LegoExporter::formatFromFileName(const QString& filename)
+{
+  const QString suffix = QFileInfo(filename).suffix();
+  if(suffix.compare("ply", Qt::CaseInsensitive) == 0)
+    return Ply;
+  if(suffix.compare("stl", Qt::CaseInsensitive) == 0)
+    return Stl;
+  return Obj;
+}
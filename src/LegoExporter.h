@@ -0,0 +1,40 @@
+#ifndef LEGO_EXPORTER_H
+#define LEGO_EXPORTER_H
+
+#include <QString>
+
+class LegoCloud;
+
+//Mesh export of a LegoCloud.
+//Every brick type (size and orientation) is tessellated once; bricks only translate that geometry.
+//When hidden faces are culled, each brick only keeps its uncovered knobs and the visible box faces of each level are
+//merged across the bricks of the same color.
+//Levels are written in parallel into separate buffers that are concatenated in the file at the end.
+class LegoExporter
+{
+public:
+  enum Format
+  {
+    Obj,//One group per brick, and one per level and color for the merged faces when culled
+    InstancedObj,//One object per brick type plus a "<name>.instances.txt" transform list
+    Ply,//Binary little endian, per-vertex colors
+    Stl//Binary
+  };
+
+  struct Options
+  {
+    Options() : format(Obj), outerOnly(false), cullHidden(true), threadCount(0) {}
+
+    Format format;
+    bool outerOnly;//Skip the bricks that cannot be seen from outside
+    bool cullHidden;//Drop the faces and knobs against other exported bricks and merge the coplanar faces of the same color (not for InstancedObj)
+    int threadCount;//<= 0 means one thread per core
+  };
+
+  static bool exportCloud(const LegoCloud& legoCloud, const QString& filename, const Options& options = Options());
+
+  //Guess the format from the file suffix (.obj, .ply, .stl), Obj if unknown
+  static Format formatFromFileName(const QString& filename);
+};
+
+#endif // LEGO_EXPORTER_H
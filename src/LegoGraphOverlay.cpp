@@ -0,0 +1,211 @@
+#include "LegoGraphOverlay.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "LegoDimensions.h"
+
+#define GRAPH_HIGHLIGHTED_POINT_SIZE 6.0f
+
+namespace
+{
+
+inline void nodePosition(const LegoBrick& brick, float position[3])
+{
+  position[0] = brick.getPosX()*LEGO_KNOB_DISTANCE + (brick.getSizeX()*LEGO_KNOB_DISTANCE)/2.0;
+  position[1] = brick.getLevel()*LEGO_HEIGHT + LEGO_HEIGHT;
+  position[2] = brick.getPosY()*LEGO_KNOB_DISTANCE + (brick.getSizeY()*LEGO_KNOB_DISTANCE)/2.0;
+}
+
+}
+
+LegoGraphOverlay::PointSet::PointSet()
+  : positionBuffer(QGLBuffer::VertexBuffer), colorBuffer(QGLBuffer::VertexBuffer), number(0)
+{
+}
+
+LegoGraphOverlay::LegoGraphOverlay()
+  : levelNumber_(0), edgeBuffer_(QGLBuffer::VertexBuffer), edgeVertexNumber_(0)
+{
+}
+
+void LegoGraphOverlay::upload(const LegoGraph& graph, int levelNumber, const VertexColors& vertexColors)
+{
+  levelNumber_ = levelNumber;
+
+  std::vector<Point> points, highlightedPoints;
+  LegoGraph::vertex_iterator vertexIt, vertexItEnd;
+  for (boost::tie(vertexIt, vertexItEnd) = boost::vertices(graph); vertexIt != vertexItEnd; ++vertexIt)
+  {
+    Point point;
+    point.level = graph[*vertexIt].brick->getLevel();
+    nodePosition(*graph[*vertexIt].brick, point.position);
+    point.colors = vertexColors(*vertexIt);
+
+    if(graph[*vertexIt].articulationPoint || graph[*vertexIt].badArticulationPoint)
+      highlightedPoints.push_back(point);
+    else
+      points.push_back(point);
+  }
+
+  uploadPoints(points, levelNumber_, points_);
+  uploadPoints(highlightedPoints, levelNumber_, highlightedPoints_);
+
+  //Edges sorted by (lower level, level difference) so that the edges displayed with a layer are in 2 ranges
+  std::vector<Edge> edges;
+  edges.reserve(boost::num_edges(graph));
+  LegoGraph::edge_iterator edgeIt, edgeEnd;
+  for (boost::tie(edgeIt, edgeEnd) = boost::edges(graph); edgeIt != edgeEnd; ++edgeIt)
+  {
+    const LegoBrick* source = graph[boost::source(*edgeIt, graph)].brick;
+    const LegoBrick* target = graph[boost::target(*edgeIt, graph)].brick;
+    const int lower = std::min(source->getLevel(), target->getLevel());
+    const int span = std::abs(source->getLevel() - target->getLevel());
+
+    Edge edge;
+    edge.key = span < 2 ? lower*2 + span : levelNumber_*2;
+    nodePosition(*source, edge.positions);
+    nodePosition(*target, edge.positions + 3);
+    edges.push_back(edge);
+  }
+  std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {return a.key < b.key;});
+
+  sameLevelEdges_.assign(levelNumber_, Range());
+  nextLevelEdges_.assign(levelNumber_, Range());
+  otherEdges_ = Range();
+  edgeVertexNumber_ = edges.size()*2;
+  std::vector<float> edgeVertices(edges.size()*6);
+  for(size_t i = 0; i < edges.size(); i++)
+  {
+    std::copy(edges[i].positions, edges[i].positions + 6, &edgeVertices[i*6]);
+
+    const int level = edges[i].key/2;
+    Range& range = level >= levelNumber_ ? otherEdges_ : (edges[i].key % 2 == 0 ? sameLevelEdges_[level] : nextLevelEdges_[level]);
+    if(range.count == 0)
+      range.first = i*2;
+    range.count += 2;
+  }
+
+  if(!edgeBuffer_.isCreated())
+    edgeBuffer_.create();
+  edgeBuffer_.bind();
+  edgeBuffer_.allocate(edgeVertices.empty() ? NULL : &edgeVertices[0], edgeVertices.size()*sizeof(float));
+  edgeBuffer_.release();
+}
+
+void LegoGraphOverlay::uploadPoints(std::vector<Point>& points, int levelNumber, PointSet& pointSet)
+{
+  std::stable_sort(points.begin(), points.end(), [](const Point& a, const Point& b) {return a.level < b.level;});
+
+  pointSet.number = points.size();
+  pointSet.levels.assign(levelNumber, Range());
+
+  std::vector<float> positions(points.size()*3);
+  std::vector<unsigned char> colors(LegoRenderMesh::COLOR_MODE_NUMBER*points.size()*4);
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    std::copy(points[i].position, points[i].position + 3, &positions[i*3]);
+    for(int mode = 0; mode < LegoRenderMesh::COLOR_MODE_NUMBER; mode++)
+    {
+      std::copy(points[i].colors.rgba[mode], points[i].colors.rgba[mode] + 4, &colors[(mode*points.size() + i)*4]);
+    }
+
+    if(points[i].level < 0 || points[i].level >= levelNumber)
+      continue;
+    Range& range = pointSet.levels[points[i].level];
+    if(range.count == 0)
+      range.first = i;
+    range.count++;
+  }
+
+  if(!pointSet.positionBuffer.isCreated())
+  {
+    pointSet.positionBuffer.create();
+    pointSet.colorBuffer.create();
+  }
+
+  pointSet.positionBuffer.bind();
+  pointSet.positionBuffer.allocate(positions.empty() ? NULL : &positions[0], positions.size()*sizeof(float));
+  pointSet.positionBuffer.release();
+
+  pointSet.colorBuffer.bind();
+  pointSet.colorBuffer.allocate(colors.empty() ? NULL : &colors[0], colors.size());
+  pointSet.colorBuffer.release();
+}
+
+void LegoGraphOverlay::draw(int colorMode, int layer)
+{
+  if(!edgeBuffer_.isCreated())
+    return;
+
+  const int firstLevel = layer >= 0 ? layer : 0;
+  const int endLevel = layer >= 0 ? std::min(layer+2, levelNumber_) : levelNumber_;
+
+  glPushAttrib(GL_LIGHTING_BIT | GL_POINT_BIT | GL_CURRENT_BIT);
+  glDisable(GL_LIGHTING);
+  glEnableClientState(GL_VERTEX_ARRAY);
+
+  //Edges
+  glColor3d(0,0,1);
+  edgeBuffer_.bind();
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  if(layer < 0)
+  {
+    if(edgeVertexNumber_ > 0)
+      glDrawArrays(GL_LINES, 0, edgeVertexNumber_);
+  }
+  else if(layer < levelNumber_)
+  {
+    //Edges in the layer and to the next one are consecutive, then the edges in the next layer
+    Range ranges[2];
+    ranges[0].first = sameLevelEdges_[layer].count > 0 ? sameLevelEdges_[layer].first : nextLevelEdges_[layer].first;
+    ranges[0].count = sameLevelEdges_[layer].count + nextLevelEdges_[layer].count;
+    if(layer+1 < levelNumber_)
+      ranges[1] = sameLevelEdges_[layer+1];
+    for(int i = 0; i < 2; i++)
+    {
+      if(ranges[i].count > 0)
+        glDrawArrays(GL_LINES, ranges[i].first, ranges[i].count);
+    }
+  }
+  edgeBuffer_.release();
+
+  //Vertices, the articulation points over the others
+  glEnableClientState(GL_COLOR_ARRAY);
+  drawPoints(points_, colorMode, firstLevel, endLevel);
+  glPointSize(GRAPH_HIGHLIGHTED_POINT_SIZE);
+  drawPoints(highlightedPoints_, colorMode, firstLevel, endLevel);
+  glDisableClientState(GL_COLOR_ARRAY);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glPopAttrib();
+}
+
+void LegoGraphOverlay::drawPoints(PointSet& pointSet, int colorMode, int firstLevel, int endLevel)
+{
+  if(pointSet.number == 0 || firstLevel >= endLevel)
+    return;
+
+  //Levels are consecutive in the buffer
+  Range range;
+  for(int level = firstLevel; level < endLevel; level++)
+  {
+    const Range& levelRange = pointSet.levels[level];
+    if(levelRange.count == 0)
+      continue;
+    if(range.count == 0)
+      range.first = levelRange.first;
+    range.count = levelRange.first + levelRange.count - range.first;
+  }
+  if(range.count == 0)
+    return;
+
+  pointSet.colorBuffer.bind();
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, (const GLvoid*)(size_t(colorMode)*pointSet.number*4));
+  pointSet.colorBuffer.release();
+
+  pointSet.positionBuffer.bind();
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  glDrawArrays(GL_POINTS, range.first, range.count);
+  pointSet.positionBuffer.release();
+}
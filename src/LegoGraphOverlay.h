@@ -0,0 +1,76 @@
+#ifndef LEGO_GRAPH_OVERLAY_H
+#define LEGO_GRAPH_OVERLAY_H
+
+#include <QGLBuffer>
+
+#include <functional>
+#include <vector>
+
+#include "LegoGraph.h"
+#include "LegoRenderMesh.h"
+
+//Connectivity graph displayed over the bricks: a point per brick and a line per connection.
+//Kept in vertex buffers, rebuilt only when the graph changes, with per level ranges for the layer by layer display.
+//Articulation points are in a separate buffer, drawn larger on top of the others.
+class LegoGraphOverlay
+{
+public:
+  typedef std::function<LegoRenderMesh::BrickColors(const LegoGraph::vertex_descriptor&)> VertexColors;
+
+  LegoGraphOverlay();
+
+  //Replaces the buffers with the graph, needs a current GL context
+  void upload(const LegoGraph& graph, int levelNumber, const VertexColors& vertexColors);
+
+  //Points colored with the stream colorMode and blue lines, without depth test nor lighting.
+  //Only the levels layer and layer+1 and the edges between them if layer >= 0.
+  void draw(int colorMode, int layer = -1);
+
+private:
+  struct Range
+  {
+    Range() : first(0), count(0) {}
+    int first;
+    int count;
+  };
+
+  struct Point
+  {
+    int level;
+    float position[3];
+    LegoRenderMesh::BrickColors colors;
+  };
+
+  struct Edge
+  {
+    int key;//Position in the buffer, see upload
+    float positions[6];
+  };
+
+  struct PointSet
+  {
+    PointSet();
+
+    QGLBuffer positionBuffer;
+    QGLBuffer colorBuffer;//One stream per color mode, one after the other
+    int number;
+    std::vector<Range> levels;
+  };
+
+  static void uploadPoints(std::vector<Point>& points, int levelNumber, PointSet& pointSet);
+  static void drawPoints(PointSet& pointSet, int colorMode, int firstLevel, int endLevel);
+
+  int levelNumber_;
+  PointSet points_;
+  PointSet highlightedPoints_;
+
+  //Edges between bricks of the same level, then between a level and the next one, level by level.
+  //Other edges are never in a layer pair, they come last.
+  QGLBuffer edgeBuffer_;
+  int edgeVertexNumber_;
+  std::vector<Range> sameLevelEdges_;
+  std::vector<Range> nextLevelEdges_;
+  Range otherEdges_;
+};
+
+#endif // LEGO_GRAPH_OVERLAY_H
@@ -0,0 +1,267 @@
+#include "LegoMesher.h"
+
+#include "LegoCloud.h"
+#include "LegoDimensions.h"
+
+#include <algorithm>
+
+namespace
+{
+
+inline void setFaceCoord(float* faceCoord, int u, int v, int nu, int nv)
+{
+  faceCoord[0] = float(u)/nu;
+  faceCoord[1] = float(v)/nv;
+}
+
+//Rectangles over a grid of nu x nv cells, scanned row by row: each rectangle is grown as far as its cells have
+//the same key, first along u then along v. Cells of key -1 are left out. rectangle(u, v, uEnd, vEnd, key) gets each one.
+template<typename Key, typename Rectangle>
+void greedyRectangles(int nu, int nv, Key key, Rectangle rectangle)
+{
+  std::vector<int> keys(nu*nv);//[v*nu + u], -1 once in a rectangle
+  for(int v = 0; v < nv; v++)
+  {
+    for(int u = 0; u < nu; u++)
+    {
+      keys[v*nu + u] = key(u, v);
+    }
+  }
+
+  for(int v = 0; v < nv; v++)
+  {
+    for(int u = 0; u < nu; u++)
+    {
+      const int k = keys[v*nu + u];
+      if(k < 0)
+        continue;
+
+      int uEnd = u+1;
+      while(uEnd < nu && keys[v*nu + uEnd] == k)
+        uEnd++;
+
+      int vEnd = v+1;
+      bool rowFree = true;
+      while(vEnd < nv && rowFree)
+      {
+        for(int i = u; i < uEnd && rowFree; i++)
+          rowFree = keys[vEnd*nu + i] == k;
+        if(rowFree)
+          vEnd++;
+      }
+
+      for(int j = v; j < vEnd; j++)
+      {
+        for(int i = u; i < uEnd; i++)
+          keys[j*nu + i] = -1;
+      }
+
+      rectangle(u, v, uEnd, vEnd, k);
+    }
+  }
+}
+
+//Quad of the cells [u, uEnd) x [v, vEnd) of a face of nu x nv cells
+template<typename Corner>
+void addRectangle(int u, int v, int uEnd, int vEnd, int nu, int nv, Corner corner, const Vector3& normal, std::vector<LegoMesher::Quad>& quads)
+{
+  LegoMesher::Quad quad;
+  quad.normal = normal;
+  quad.corners[0] = corner(u, v);
+  quad.corners[1] = corner(uEnd, v);
+  quad.corners[2] = corner(uEnd, vEnd);
+  quad.corners[3] = corner(u, vEnd);
+  setFaceCoord(quad.faceCoords[0], u, v, nu, nv);
+  setFaceCoord(quad.faceCoords[1], uEnd, v, nu, nv);
+  setFaceCoord(quad.faceCoords[2], uEnd, vEnd, nu, nv);
+  setFaceCoord(quad.faceCoords[3], u, vEnd, nu, nv);
+
+  //Make the winding agree with the normal
+  if(dot(cross(quad.corners[1] - quad.corners[0], quad.corners[2] - quad.corners[0]), normal) < 0.0f)
+  {
+    std::swap(quad.corners[1], quad.corners[3]);
+    std::swap(quad.faceCoords[1][0], quad.faceCoords[3][0]);
+    std::swap(quad.faceCoords[1][1], quad.faceCoords[3][1]);
+  }
+
+  quads.push_back(quad);
+}
+
+//Visible part of one face of a brick, as rectangles: a fully visible face is one quad, a partly hidden one
+//is split along the hidden cells.
+//The face has nu x nv cells; corner(u, v) is the position of the grid point (u, v) with u in [0, nu] and v in [0, nv].
+template<typename Hidden, typename Corner>
+void visibleFaceRectangles(int nu, int nv, Hidden hidden, Corner corner, const Vector3& normal, std::vector<LegoMesher::Quad>& quads)
+{
+  greedyRectangles(nu, nv,
+                   [&](int u, int v) {return hidden(u, v) ? -1 : 0;},
+                   [&](int u, int v, int uEnd, int vEnd, int) {addRectangle(u, v, uEnd, vEnd, nu, nv, corner, normal, quads);});
+}
+
+//Faces of a whole plane of the level, merged by color: color(u, v) is the color of the visible cell, -1 if there is no face
+template<typename Color, typename Corner>
+void mergedPlaneRectangles(int nu, int nv, Color color, Corner corner, const Vector3& normal, std::vector<LegoMesher::Quad>& quads, std::vector<int>& colorIds)
+{
+  greedyRectangles(nu, nv, color,
+                   [&](int u, int v, int uEnd, int vEnd, int colorId)
+  {
+    addRectangle(u, v, uEnd, vEnd, nu, nv, corner, normal, quads);
+    colorIds.push_back(colorId);
+  });
+}
+
+}
+
+LegoOccupancy::LegoOccupancy(const LegoCloud& legoCloud, bool outerOnly, bool separateLevels)
+  : levelNumber_(legoCloud.getLevelNumber()), width_(legoCloud.getWidth()), depth_(legoCloud.getDepth()), separateLevels_(separateLevels),
+    cells_(size_t(levelNumber_)*width_*depth_, 0)
+{
+  for(int level = 0; level < levelNumber_; level++)
+  {
+    const LegoBrickList& bricks = legoCloud.getBricks(level);
+    for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+    {
+      if(!outerOnly || brick->isOuter())
+        addBrick(*brick);
+    }
+  }
+}
+
+LegoOccupancy::LegoOccupancy(int levelNumber, int width, int depth, bool separateLevels)
+  : levelNumber_(levelNumber), width_(width), depth_(depth), separateLevels_(separateLevels),
+    cells_(size_t(levelNumber_)*width_*depth_, 0)
+{
+}
+
+void LegoOccupancy::addBrick(const LegoBrick& brick)
+{
+  for(int x = brick.getPosX(); x < brick.getPosX() + brick.getSizeX(); x++)
+  {
+    unsigned char* column = &cells_[(brick.getLevel()*width_ + x)*depth_];
+    std::fill(column + brick.getPosY(), column + brick.getPosY() + brick.getSizeY(), 1);
+  }
+}
+
+void LegoMesher::brickFaces(const LegoBrick& brick, const LegoOccupancy* occupancy, std::vector<Quad>& quads)
+{
+  const int level = brick.getLevel();
+  const int posX = brick.getPosX();
+  const int posY = brick.getPosY();
+  const int sizeX = brick.getSizeX();
+  const int sizeY = brick.getSizeY();
+
+  //Grid lines of the box, the first ones are moved by the tolerance
+  std::vector<float> gridX(sizeX+1), gridZ(sizeY+1);
+  for(int i = 0; i <= sizeX; i++)
+    gridX[i] = (posX + i)*LEGO_KNOB_DISTANCE + (i == 0 ? LEGO_HORIZONTAL_TOLERANCE : 0.0);
+  for(int i = 0; i <= sizeY; i++)
+    gridZ[i] = (posY + i)*LEGO_KNOB_DISTANCE + (i == 0 ? LEGO_HORIZONTAL_TOLERANCE : 0.0);
+
+  const float bottom = level*LEGO_HEIGHT;
+  const float top = bottom + LEGO_HEIGHT;
+  const float heights[2] = {bottom, top};
+
+  const float minX = gridX[0];
+  const float maxX = gridX[sizeX];
+  const float minZ = gridZ[0];
+  const float maxZ = gridZ[sizeY];
+
+  //Left and right: cells along z
+  visibleFaceRectangles(sizeY, 1,
+                        [&](int u, int) {return occupancy && occupancy->hides(level, level, posX-1, posY+u);},
+                        [&](int u, int v) {return Vector3(minX, heights[v], gridZ[u]);},
+                        Vector3(-1, 0, 0), quads);
+  visibleFaceRectangles(sizeY, 1,
+                        [&](int u, int) {return occupancy && occupancy->hides(level, level, posX+sizeX, posY+u);},
+                        [&](int u, int v) {return Vector3(maxX, heights[v], gridZ[u]);},
+                        Vector3(1, 0, 0), quads);
+
+  //Back and front: cells along x
+  visibleFaceRectangles(sizeX, 1,
+                        [&](int u, int) {return occupancy && occupancy->hides(level, level, posX+u, posY-1);},
+                        [&](int u, int v) {return Vector3(gridX[u], heights[v], minZ);},
+                        Vector3(0, 0, -1), quads);
+  visibleFaceRectangles(sizeX, 1,
+                        [&](int u, int) {return occupancy && occupancy->hides(level, level, posX+u, posY+sizeY);},
+                        [&](int u, int v) {return Vector3(gridX[u], heights[v], maxZ);},
+                        Vector3(0, 0, 1), quads);
+
+  //Bottom and top
+  visibleFaceRectangles(sizeX, sizeY,
+                        [&](int u, int v) {return occupancy && occupancy->hides(level, level-1, posX+u, posY+v);},
+                        [&](int u, int v) {return Vector3(gridX[u], bottom, gridZ[v]);},
+                        Vector3(0, -1, 0), quads);
+  visibleFaceRectangles(sizeX, sizeY,
+                        [&](int u, int v) {return occupancy && occupancy->hides(level, level+1, posX+u, posY+v);},
+                        [&](int u, int v) {return Vector3(gridX[u], top, gridZ[v]);},
+                        Vector3(0, 1, 0), quads);
+}
+
+void LegoMesher::mergedLevelFaces(const LegoCloud& legoCloud, int level, const LegoOccupancy& occupancy, bool outerOnly,
+                                  std::vector<Quad>& quads, std::vector<int>& colorIds)
+{
+  const int width = legoCloud.getWidth();
+  const int depth = legoCloud.getDepth();
+
+  //Color of the brick of each cell of the level, -1 if no exported brick covers it
+  std::vector<int> colors(size_t(width)*depth, -1);
+  const LegoBrickList& bricks = legoCloud.getBricks(level);
+  for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+  {
+    if(outerOnly && !brick->isOuter())
+      continue;
+
+    for(int x = brick->getPosX(); x < brick->getPosX() + brick->getSizeX(); x++)
+    {
+      std::vector<int>::iterator column = colors.begin() + size_t(x)*depth;
+      std::fill(column + brick->getPosY(), column + brick->getPosY() + brick->getSizeY(), brick->getColorId());
+    }
+  }
+
+  //Color of the cell when its face towards the cell (x+dx, level+dLevel, y+dy) is visible
+  auto faceColor = [&](int x, int y, int dx, int dLevel, int dy)
+  {
+    const int color = colors[size_t(x)*depth + y];
+    return color >= 0 && !occupancy.hides(level, level+dLevel, x+dx, y+dy) ? color : -1;
+  };
+
+  const float bottom = level*LEGO_HEIGHT;
+  const float top = bottom + LEGO_HEIGHT;
+  const float heights[2] = {bottom, top};
+
+  //Left and right: one plane per grid line along x, cells along z
+  for(int x = 0; x < width; x++)
+  {
+    mergedPlaneRectangles(depth, 1,
+                          [&](int u, int) {return faceColor(x, u, -1, 0, 0);},
+                          [&](int u, int v) {return Vector3(x*LEGO_KNOB_DISTANCE, heights[v], u*LEGO_KNOB_DISTANCE);},
+                          Vector3(-1, 0, 0), quads, colorIds);
+    mergedPlaneRectangles(depth, 1,
+                          [&](int u, int) {return faceColor(x, u, 1, 0, 0);},
+                          [&](int u, int v) {return Vector3((x+1)*LEGO_KNOB_DISTANCE, heights[v], u*LEGO_KNOB_DISTANCE);},
+                          Vector3(1, 0, 0), quads, colorIds);
+  }
+
+  //Back and front: one plane per grid line along z, cells along x
+  for(int y = 0; y < depth; y++)
+  {
+    mergedPlaneRectangles(width, 1,
+                          [&](int u, int) {return faceColor(u, y, 0, 0, -1);},
+                          [&](int u, int v) {return Vector3(u*LEGO_KNOB_DISTANCE, heights[v], y*LEGO_KNOB_DISTANCE);},
+                          Vector3(0, 0, -1), quads, colorIds);
+    mergedPlaneRectangles(width, 1,
+                          [&](int u, int) {return faceColor(u, y, 0, 0, 1);},
+                          [&](int u, int v) {return Vector3(u*LEGO_KNOB_DISTANCE, heights[v], (y+1)*LEGO_KNOB_DISTANCE);},
+                          Vector3(0, 0, 1), quads, colorIds);
+  }
+
+  //Bottom and top
+  mergedPlaneRectangles(width, depth,
+                        [&](int u, int v) {return faceColor(u, v, 0, -1, 0);},
+                        [&](int u, int v) {return Vector3(u*LEGO_KNOB_DISTANCE, bottom, v*LEGO_KNOB_DISTANCE);},
+                        Vector3(0, -1, 0), quads, colorIds);
+  mergedPlaneRectangles(width, depth,
+                        [&](int u, int v) {return faceColor(u, v, 0, 1, 0);},
+                        [&](int u, int v) {return Vector3(u*LEGO_KNOB_DISTANCE, top, v*LEGO_KNOB_DISTANCE);},
+                        Vector3(0, 1, 0), quads, colorIds);
+}
@@ -0,0 +1,73 @@
+#ifndef LEGO_MESHER_H
+#define LEGO_MESHER_H
+
+#include <vector>
+
+#include "LegoBrick.h"
+
+class LegoCloud;
+
+//Which cells of the voxel grid are covered by a brick
+class LegoOccupancy
+{
+public:
+  //outerOnly restricts the occupancy to the outer bricks.
+  //With separateLevels, a brick only hides faces of the bricks of its own level (levels displayed one at a time).
+  explicit LegoOccupancy(const LegoCloud& legoCloud, bool outerOnly = false, bool separateLevels = false);
+  //Empty grid, filled with addBrick
+  LegoOccupancy(int levelNumber, int width, int depth, bool separateLevels = false);
+
+  void addBrick(const LegoBrick& brick);
+
+  inline bool isOccupied(int level, int x, int y) const
+  {
+    if(level < 0 || level >= levelNumber_ || x < 0 || x >= width_ || y < 0 || y >= depth_)
+      return false;
+    return cells_[(level*width_ + x)*depth_ + y] != 0;
+  }
+
+  //True when the cell hides the faces of a brick of brickLevel
+  inline bool hides(int brickLevel, int level, int x, int y) const
+  {
+    return (!separateLevels_ || level == brickLevel) && isOccupied(level, x, y);
+  }
+
+private:
+  int levelNumber_;
+  int width_;
+  int depth_;
+  bool separateLevels_;
+  std::vector<unsigned char> cells_;
+};
+
+//Surface of the bricks without the faces that touch another brick.
+//brickFaces keeps the faces of each brick apart, for the display where every brick has its own color and edges.
+//mergedLevelFaces also merges the coplanar faces of the same color across bricks, for the export.
+class LegoMesher
+{
+public:
+  struct Quad
+  {
+    Vector3 corners[4];//Counter clockwise seen from outside
+    Vector3 normal;
+    float faceCoords[4][2];//(u, v) of the corners across the whole brick face, the sides at 0 or 1 are edges of the brick
+  };
+
+  //Visible faces of the brick box (same box as the display: tolerance on the lower sides).
+  //All 6 faces when occupancy is NULL.
+  static void brickFaces(const LegoBrick& brick, const LegoOccupancy* occupancy, std::vector<Quad>& quads);
+
+  //Visible faces of the bricks of a level, with the coplanar faces of the same color greedily merged across bricks
+  //(colorIds gets the color of each quad). The faces lie on the grid lines, without the tolerance between bricks
+  //that would open slits where the faces between them are culled. The face coordinates span the whole plane.
+  static void mergedLevelFaces(const LegoCloud& legoCloud, int level, const LegoOccupancy& occupancy, bool outerOnly,
+                               std::vector<Quad>& quads, std::vector<int>& colorIds);
+
+  //True when the knob (x, y) of the brick (relative to its corner) is under another brick
+  static inline bool isKnobCovered(const LegoBrick& brick, int x, int y, const LegoOccupancy* occupancy)
+  {
+    return occupancy && occupancy->hides(brick.getLevel(), brick.getLevel()+1, brick.getPosX()+x, brick.getPosY()+y);
+  }
+};
+
+#endif // LEGO_MESHER_H
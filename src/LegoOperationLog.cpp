@@ -0,0 +1,195 @@
+#include "LegoOperationLog.h"
+
+#include "LegoBrick.h"
+
+#include <QDataStream>
+#include <QFile>
+
+#include <iostream>
+
+#define LOG_MAGIC 0x42524b4c //"BRKL"
+#define LOG_VERSION 3 //2: BrickLimits, 3: with the limit values
+#define OPERATION_BYTES (4 + 2*5*4) //Type and two brick handles, at least
+
+LegoOperationLog::BrickHandle::BrickHandle(const LegoBrick& brick)
+  : level(brick.getLevel()), posX(brick.getPosX()), posY(brick.getPosY()), sizeX(brick.getSizeX()), sizeY(brick.getSizeY())
+{
+}
+
+LegoOperationLog::LegoOperationLog()
+  : seed_(0)
+{
+}
+
+void LegoOperationLog::clear()
+{
+  operations_.clear();
+}
+
+void LegoOperationLog::append(Type type)
+{
+  Operation operation;
+  operation.type = type;
+  operations_.append(operation);
+}
+
+void LegoOperationLog::append(Type type, const QMap<BrickSize, int>& limits)
+{
+  Operation operation;
+  operation.type = type;
+  operation.limits = limits;
+  operations_.append(operation);
+}
+
+void LegoOperationLog::append(Type type, const LegoBrick& brick)
+{
+  Operation operation;
+  operation.type = type;
+  operation.bricks[0] = BrickHandle(brick);
+  operations_.append(operation);
+}
+
+void LegoOperationLog::append(Type type, const LegoBrick& brick1, const LegoBrick& brick2)
+{
+  Operation operation;
+  operation.type = type;
+  operation.bricks[0] = BrickHandle(brick1);
+  operation.bricks[1] = BrickHandle(brick2);
+  operations_.append(operation);
+}
+
+bool LegoOperationLog::save(const QString& filename) const
+{
+  QFile file(filename);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    std::cerr << "LegoOperationLog: unable to create or open the file: " << qPrintable(filename) << std::endl;
+    return false;
+  }
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_4_8);
+
+  out << quint32(LOG_MAGIC) << quint32(LOG_VERSION) << seed_ << qint32(operations_.size());
+  foreach(const Operation& operation, operations_)
+  {
+    out << qint32(operation.type);
+    for(int i = 0; i < 2; i++)
+    {
+      const BrickHandle& brick = operation.bricks[i];
+      out << brick.level << brick.posX << brick.posY << brick.sizeX << brick.sizeY;
+    }
+    if(operation.type == BrickLimits)
+    {
+      out << qint32(operation.limits.size());
+      for(QMap<BrickSize, int>::const_iterator limitIt = operation.limits.constBegin(); limitIt != operation.limits.constEnd(); ++limitIt)
+        out << qint32(limitIt.key().first) << qint32(limitIt.key().second) << qint32(limitIt.value());
+    }
+  }
+
+  file.close();
+  return out.status() == QDataStream::Ok;
+}
+
+bool LegoOperationLog::load(const QString& filename)
+{
+  QFile file(filename);
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    std::cerr << "LegoOperationLog: unable to open the file: " << qPrintable(filename) << std::endl;
+    return false;
+  }
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_4_8);
+
+  quint32 magic, version;
+  in >> magic >> version;
+  if(magic != LOG_MAGIC)
+  {
+    std::cerr << "LegoOperationLog: " << qPrintable(filename) << " is not an operation log." << std::endl;
+    return false;
+  }
+  if(version > LOG_VERSION)
+  {
+    std::cerr << "LegoOperationLog: " << qPrintable(filename) << " was saved by a newer version (" << version << ")." << std::endl;
+    return false;
+  }
+
+  qint32 operationNumber;
+  in >> seed_ >> operationNumber;
+  operations_.clear();
+  //The count is only trusted as far as the file can hold it
+  if(in.status() != QDataStream::Ok || operationNumber < 0 || operationNumber > (file.size() - file.pos())/OPERATION_BYTES)
+  {
+    std::cerr << "LegoOperationLog: " << qPrintable(filename) << " is truncated or corrupted." << std::endl;
+    return false;
+  }
+  operations_.reserve(operationNumber);
+  for(int o = 0; o < operationNumber && in.status() == QDataStream::Ok; o++)
+  {
+    qint32 type;
+    Operation operation;
+    in >> type;
+    for(int i = 0; i < 2; i++)
+    {
+      BrickHandle& brick = operation.bricks[i];
+      in >> brick.level >> brick.posX >> brick.posY >> brick.sizeX >> brick.sizeY;
+    }
+    if(type < Merge || type > BrickLimits)
+    {
+      std::cerr << "LegoOperationLog: unknown operation " << type << " in " << qPrintable(filename) << std::endl;
+      return false;
+    }
+    operation.type = Type(type);
+    //Before version 3 the limit values were not recorded
+    if(operation.type == BrickLimits && version >= 3)
+    {
+      qint32 limitNumber;
+      in >> limitNumber;
+      if(in.status() != QDataStream::Ok || limitNumber < 0 || limitNumber > (file.size() - file.pos())/(3*4))
+      {
+        std::cerr << "LegoOperationLog: " << qPrintable(filename) << " is truncated or corrupted." << std::endl;
+        operations_.clear();
+        return false;
+      }
+      for(int l = 0; l < limitNumber; l++)
+      {
+        qint32 sizeX, sizeY, limit;
+        in >> sizeX >> sizeY >> limit;
+        operation.limits[BrickSize(sizeX, sizeY)] = limit;
+      }
+    }
+    operations_.append(operation);
+  }
+
+  if(in.status() != QDataStream::Ok)
+  {
+    std::cerr << "LegoOperationLog: " << qPrintable(filename) << " is truncated." << std::endl;
+    operations_.clear();
+    return false;
+  }
+  return true;
+}
+
+const char* LegoOperationLog::typeName(Type type)
+{
+  switch(type)
+  {
+  case Merge:
+    return "merge";
+  case Split:
+    return "split";
+  case Cut:
+    return "cut";
+  case Remove:
+    return "remove";
+  case ConnectedComponents:
+    return "connectedComponents";
+  case BiconnectedComponents:
+    return "biconnectedComponents";
+  case BrickLimits:
+    return "brickLimits";
+  }
+  return "unknown";
+}
@@ -0,0 +1,83 @@
+#ifndef LEGO_OPERATION_LOG_H
+#define LEGO_OPERATION_LOG_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "LegoBrick.h" //For BrickSize
+
+//Structural operations applied to a LegoCloud, in order: merges, splits, cuts, the bricks removed by postHollow,
+//the component analyses and the activation of the brick limits. A brick is designated by its level, position and size, which are unique in a cloud.
+//LegoCloud::replay applies a log to a cloud in the same initial state (same voxels and preHollow) without
+//taking any decision, which measures the cost of the data structures on a fixed trajectory.
+class LegoOperationLog
+{
+public:
+  enum Type{Merge, Split, Cut, Remove, ConnectedComponents, BiconnectedComponents, BrickLimits};
+
+  struct BrickHandle
+  {
+    BrickHandle() : level(0), posX(0), posY(0), sizeX(0), sizeY(0) {}
+    explicit BrickHandle(const LegoBrick& brick);
+    BrickHandle(int level, int posX, int posY, int sizeX, int sizeY)
+      : level(level), posX(posX), posY(posY), sizeX(sizeX), sizeY(sizeY) {}
+
+    inline bool operator==(const BrickHandle& other) const {
+      return level == other.level && posX == other.posX && posY == other.posY && sizeX == other.sizeX && sizeY == other.sizeY;}
+
+    qint32 level;
+    qint32 posX;
+    qint32 posY;
+    qint32 sizeX;
+    qint32 sizeY;
+  };
+
+  struct Operation
+  {
+    Type type;
+    //Merge: the two bricks. Split and Remove: the brick. Cut: the brick and the first new brick (the second is the rest).
+    //None for the others
+    BrickHandle bricks[2];
+    //BrickLimits: the limit of each brick size, -1 for none
+    QMap<BrickSize, int> limits;
+  };
+
+  LegoOperationLog();
+
+  void clear();
+  void append(Type type);
+  void append(Type type, const QMap<BrickSize, int>& limits);
+  void append(Type type, const LegoBrick& brick);
+  void append(Type type, const LegoBrick& brick1, const LegoBrick& brick2);
+
+  inline const QVector<Operation>& getOperations() const {return operations_;}
+  inline int size() const {return operations_.size();}
+
+  //The seed of the recorded run, for reference
+  inline void setSeed(quint64 seed) {seed_ = seed;}
+  inline quint64 getSeed() const {return seed_;}
+
+  bool save(const QString& filename) const;
+  bool load(const QString& filename);
+
+  static const char* typeName(Type type);
+
+private:
+  QVector<Operation> operations_;
+  quint64 seed_;
+};
+
+inline uint qHash(const LegoOperationLog::BrickHandle& handle)
+{
+  uint hash = 1;
+  hash = hash*31 + handle.level;
+  hash = hash*31 + handle.posX;
+  hash = hash*31 + handle.posY;
+  hash = hash*31 + handle.sizeX;
+  hash = hash*31 + handle.sizeY;
+  return hash;
+}
+
+#endif // LEGO_OPERATION_LOG_H
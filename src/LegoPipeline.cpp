@@ -0,0 +1,150 @@
+#include "LegoPipeline.h"
+
+#include "BinvoxParser.h"
+#include "LegoCloud.h"
+#include "Trace.h"
+
+#include <QTime>
+
+#include <iostream>
+
+#define AUTO_OPTIMIZE_MAX_STEPS 50
+
+bool LegoPipeline::loadVoxelization(const QString& binvoxFilePath, LegoCloud& legoCloud)
+{
+  BRICKR_TRACE_SCOPE("LegoPipeline::loadVoxelization");
+  std::cout << "Opening file: " << qPrintable(binvoxFilePath) << std::endl;
+  const bool ok = BinvoxParser::parse(binvoxFilePath.toStdString(), legoCloud);
+  legoCloud.buildNeighbourhood();
+  BRICKR_TRACE_ARG("voxels", legoCloud.getBrickNumber());
+  return ok;
+}
+
+LegoPipeline::OptimizeResult LegoPipeline::autoOptimize(LegoCloud& legoCloud)
+{
+  BRICKR_TRACE_SCOPE("LegoPipeline::autoOptimize");
+
+//  progress::setNumberOfSteps(AUTO_OPTIMIZE_MAX_STEPS, "Optimizing...");
+//  progress::setProgress(0);
+
+  std::cout << "Optimization started, please wait..." << std::endl;
+  QTime time;
+  time.start();
+
+  //Step1: merge
+  legoCloud.merge();
+
+  int conCompNumber = legoCloud.getConCompNumber();
+  int minConCompNumber = conCompNumber;
+  int iterationCon = 0;
+  int totalConCompIter = 0;
+  int totalArtPointIter = 0;
+
+  //Step2: find the minimum number of connected components
+  while(iterationCon < AUTO_OPTIMIZE_MAX_STEPS*2 && (conCompNumber > 1 || conCompNumber > minConCompNumber))
+  {
+    BRICKR_TRACE_SCOPE("conComp iteration");
+    BRICKR_TRACE_ARG("iteration", totalConCompIter);
+    legoCloud.splitConComp();
+    legoCloud.merge();
+    conCompNumber = legoCloud.getConCompNumber();
+    BRICKR_TRACE_ARG("components", conCompNumber);
+    BRICKR_TRACE_ARG("bricks", legoCloud.getBrickNumber());
+
+    if(conCompNumber < minConCompNumber)
+      minConCompNumber = conCompNumber;
+
+    iterationCon++;
+    totalConCompIter++;
+  }
+
+  //std::cout << minConCompNumber << " " << legoCloud.getConCompNumber() << std::endl;
+
+  //Step3: reduce the bad articulation points then if the connected component number increase try to reduce it
+  int badArtPointNumber = legoCloud.getBadArtPointNumber();
+  int iterationBicon = 0;
+  while(badArtPointNumber > 0 && iterationBicon < AUTO_OPTIMIZE_MAX_STEPS)
+  {
+    BRICKR_TRACE_SCOPE("artPoint iteration");
+    BRICKR_TRACE_ARG("iteration", totalArtPointIter);
+    legoCloud.splitBiconComp();
+    legoCloud.merge();
+    conCompNumber = legoCloud.getConCompNumber();
+    badArtPointNumber = legoCloud.getBadArtPointNumber();
+
+    if(conCompNumber < minConCompNumber)
+      minConCompNumber = conCompNumber;
+
+    iterationCon = 0;
+    while(conCompNumber > minConCompNumber && iterationCon < AUTO_OPTIMIZE_MAX_STEPS*2)
+    {
+      BRICKR_TRACE_SCOPE("conComp iteration");
+      BRICKR_TRACE_ARG("iteration", totalConCompIter);
+      legoCloud.splitConComp();
+      legoCloud.merge();
+      conCompNumber = legoCloud.getConCompNumber();
+      badArtPointNumber = legoCloud.getBadArtPointNumber();
+      BRICKR_TRACE_ARG("components", conCompNumber);
+      BRICKR_TRACE_ARG("bricks", legoCloud.getBrickNumber());
+
+      iterationCon++;
+      totalConCompIter++;
+    }
+
+    BRICKR_TRACE_ARG("components", conCompNumber);
+    BRICKR_TRACE_ARG("weakArticulationPoints", badArtPointNumber);
+    iterationBicon++;
+    totalArtPointIter++;
+//    progress::setProgress(iterationBicon);
+  }
+
+  //int end = QTime::currentTime().msec();
+
+  //std::cout << "conIter: " << totalConCompIter << ", artIter: " << totalArtPointIter << std::endl;
+
+  badArtPointNumber = legoCloud.getBadArtPointNumber();
+//  progress::finish();
+
+  std::cout << "Optimization ended; results:" << std::endl;
+
+  std::cout << "Brick count: " << legoCloud.getBrickNumber() << std::endl;
+
+  if(conCompNumber == 1)
+  {
+    std::cout << "This model is fully connected." << std::endl;
+  }
+  else
+  {
+    std::cout << "   There are " << conCompNumber << " connected components." << std::endl;
+    std::cout << "   Warning, there are more than 1 connected component, this model will have disconnected pieces. Consider doing another optimization." << std::endl;
+  }
+
+  if(badArtPointNumber == 0)
+  {
+    std::cout << "There are no weak articulation points." << std::endl;
+  }
+  else
+  {
+    std::cout << "   There are " << badArtPointNumber << " weak articulation points." << std::endl;
+    std::cout << "   Warning, there are some weak articulation points in this model. Consider doing another optimization." << std::endl;
+  }
+
+  std::cout << "Time: " << time.elapsed()/1000.0 << " seconds." << std::endl;
+
+  OptimizeResult result;
+  result.seconds = time.elapsed()/1000.0;
+  result.conCompIterations = totalConCompIter;
+  result.artPointIterations = totalArtPointIter;
+  BRICKR_TRACE_ARG("conCompIterations", totalConCompIter);
+  BRICKR_TRACE_ARG("artPointIterations", totalArtPointIter);
+  BRICKR_TRACE_ARG("bricks", legoCloud.getBrickNumber());
+  return result;
+}
+
+void LegoPipeline::finalize(LegoCloud& legoCloud)
+{
+  BRICKR_TRACE_SCOPE("LegoPipeline::finalize");
+  legoCloud.postHollow();
+  legoCloud.solveBrickNumberLimitation();
+  legoCloud.merge();
+}
@@ -0,0 +1,33 @@
+#ifndef LEGO_PIPELINE_H
+#define LEGO_PIPELINE_H
+
+#include <QString>
+
+class LegoCloud;
+
+//Steps of the brick layout pipeline on a LegoCloud, without any display:
+//shared by the GUI (AssemblyPlugin, AssemblyWidget) and the command line driver.
+class LegoPipeline
+{
+public:
+  struct OptimizeResult
+  {
+    OptimizeResult() : seconds(0.0f), conCompIterations(0), artPointIterations(0) {}
+
+    float seconds;
+    int conCompIterations;
+    int artPointIterations;
+  };
+
+  //Binvox file to 1x1 bricks, with the neighbourhood built
+  static bool loadVoxelization(const QString& binvoxFilePath, LegoCloud& legoCloud);
+
+  //Merge, then split and merge again until there is one connected component and no weak articulation point,
+  //or until the step limit
+  static OptimizeResult autoOptimize(LegoCloud& legoCloud);
+
+  //Post hollow, brick limits and a last merge: the layout is then ready for the instructions
+  static void finalize(LegoCloud& legoCloud);
+};
+
+#endif // LEGO_PIPELINE_H
@@ -0,0 +1,36 @@
+#ifndef LEGO_RANDOM_H
+#define LEGO_RANDOM_H
+
+#include <QtGlobal>
+
+//Random generator of the optimization choices (SplitMix64).
+//Each LegoCloud owns one: a run is reproducible from its seed and clouds in different threads do not share any state.
+class LegoRandom
+{
+public:
+  explicit LegoRandom(quint64 seed = 0)
+    : state_(seed)
+  {
+  }
+
+  inline void seed(quint64 seed) {state_ = seed;}
+
+  inline quint64 next()
+  {
+    quint64 z = (state_ += Q_UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30))*Q_UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27))*Q_UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+  }
+
+  //Uniform in [0, bound), bound must be positive
+  inline int bounded(int bound)
+  {
+    return int(((next() >> 32)*quint64(bound)) >> 32);
+  }
+
+private:
+  quint64 state_;
+};
+
+#endif // LEGO_RANDOM_H
@@ -0,0 +1,818 @@
+#include "LegoRenderMesh.h"
+
+#include <QGLShaderProgram>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <iostream>
+
+#include "LegoDimensions.h"
+
+namespace
+{
+
+struct KnobVertex
+{
+  float position[3];//Relative to the center of the knob top
+  float normal[3];
+};
+
+//Knobs are drawn in full above this size on screen (diameter in pixels), as caps above the second one
+#define KNOB_LOD_FULL_PIXELS 6.0f
+#define KNOB_LOD_CAP_PIXELS 1.0f
+
+//GLSL 1.20 so that the fixed function matrices and light stay available
+#define LIGHTING_FUNCTION \
+    "vec4 lighting(vec4 position, vec3 objectNormal, vec4 materialColor)\n" \
+    "{\n" \
+    "  vec3 normal = normalize(gl_NormalMatrix * objectNormal);\n" \
+    "  vec4 eyePosition = gl_ModelViewMatrix * position;\n" \
+    "  vec4 light = gl_LightSource[0].position;\n" \
+    "  vec3 lightDirection = normalize(light.w == 0.0 ? light.xyz : light.xyz - eyePosition.xyz);\n" \
+    "  float diffuse = max(dot(normal, lightDirection), 0.0);\n" \
+    "  return vec4(materialColor.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb + gl_LightSource[0].diffuse.rgb * diffuse), materialColor.a);\n" \
+    "}\n"
+
+const char* KNOB_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 instanceOffset;\n"
+    "attribute vec4 instanceColor;\n"
+    "uniform float lit;\n"
+    "varying vec4 color;\n"
+    LIGHTING_FUNCTION
+    "void main()\n"
+    "{\n"
+    "  vec4 position = gl_Vertex + vec4(instanceOffset, 0.0);\n"
+    "  gl_Position = gl_ModelViewProjectionMatrix * position;\n"
+    "  color = lit > 0.5 ? lighting(position, gl_Normal, instanceColor) : vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+const char* KNOB_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = color;\n"
+    "}\n";
+
+//Brick faces darkened within a pixel of their border, instead of drawing the outlines as lines
+const char* FACE_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec2 faceCoord;\n"
+    "varying vec4 color;\n"
+    "varying vec2 edgeCoord;\n"
+    LIGHTING_FUNCTION
+    "void main()\n"
+    "{\n"
+    "  gl_Position = ftransform();\n"
+    "  color = lighting(gl_Vertex, gl_Normal, gl_Color);\n"
+    "  edgeCoord = faceCoord;\n"
+    "}\n";
+
+const char* FACE_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 color;\n"
+    "varying vec2 edgeCoord;\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 pixels = min(edgeCoord, 1.0 - edgeCoord) / max(fwidth(edgeCoord), vec2(1e-6));\n"
+    "  float edge = clamp(min(pixels.x, pixels.y) - 0.5, 0.0, 1.0);\n"
+    "  gl_FragColor = vec4(color.rgb * edge, color.a);\n"
+    "}\n";
+
+inline Vector3 knobRing(int i)
+{
+  return Vector3(KNOB_CIRCLE[i][0]*LEGO_KNOB_RADIUS, 0.0, KNOB_CIRCLE[i][1]*LEGO_KNOB_RADIUS);
+}
+
+void addKnobVertex(std::vector<KnobVertex>& vertices, const Vector3& position, const Vector3& normal)
+{
+  KnobVertex vertex;
+  for(int i = 0; i < 3; i++)
+  {
+    vertex.position[i] = position[i];
+    vertex.normal[i] = normal[i];
+  }
+  vertices.push_back(vertex);
+}
+
+//Non indexed: cap triangles, cylinder triangles, then the two outline loops as lines
+void buildKnobMesh(std::vector<KnobVertex>& vertices, int& capVertexNumber, int& triangleVertexNumber, int& lineVertexNumber)
+{
+  const Vector3 up(0, 1, 0);
+  const Vector3 height(0, LEGO_KNOB_HEIGHT, 0);
+
+  for(int i = 1; i+1 < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    addKnobVertex(vertices, knobRing(0), up);
+    addKnobVertex(vertices, knobRing(i), up);
+    addKnobVertex(vertices, knobRing(i+1), up);
+  }
+
+  capVertexNumber = vertices.size();
+
+  for(int i = 0; i < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    const int next = (i+1) % KNOB_RESOLUTION_DISPLAY;
+    const Vector3 normal(KNOB_CIRCLE[i][0], 0.0, KNOB_CIRCLE[i][1]);
+    const Vector3 nextNormal(KNOB_CIRCLE[next][0], 0.0, KNOB_CIRCLE[next][1]);
+
+    addKnobVertex(vertices, knobRing(i), normal);
+    addKnobVertex(vertices, knobRing(i) - height, normal);
+    addKnobVertex(vertices, knobRing(next) - height, nextNormal);
+    addKnobVertex(vertices, knobRing(i), normal);
+    addKnobVertex(vertices, knobRing(next) - height, nextNormal);
+    addKnobVertex(vertices, knobRing(next), nextNormal);
+  }
+
+  triangleVertexNumber = vertices.size();
+
+  for(int i = 0; i < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    const int next = (i+1) % KNOB_RESOLUTION_DISPLAY;
+    addKnobVertex(vertices, knobRing(i), up);
+    addKnobVertex(vertices, knobRing(next), up);
+    addKnobVertex(vertices, knobRing(i) - height, up);
+    addKnobVertex(vertices, knobRing(next) - height, up);
+  }
+
+  lineVertexNumber = vertices.size() - triangleVertexNumber;
+}
+
+//What the chunks need from the current GL matrices to be culled and to choose their level of detail
+struct View
+{
+  View()
+  {
+    GLfloat projection[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    float m[16];//Column major, as GL
+    for(int column = 0; column < 4; column++)
+    {
+      for(int row = 0; row < 4; row++)
+      {
+        m[column*4 + row] = 0.0f;
+        for(int k = 0; k < 4; k++)
+        {
+          m[column*4 + row] += projection[k*4 + row]*modelView[column*4 + k];
+        }
+      }
+    }
+
+    //Left, right, bottom, top, near, far: row 3 +- row i
+    for(int i = 0; i < 3; i++)
+    {
+      for(int j = 0; j < 4; j++)
+      {
+        planes[2*i][j] = m[j*4 + 3] + m[j*4 + i];
+        planes[2*i+1][j] = m[j*4 + 3] - m[j*4 + i];
+      }
+    }
+
+    //The scene scale is uniform, and 0 is the perspective term of an orthographic projection
+    const float scale = Vector3(modelView[0], modelView[1], modelView[2]).norm();
+    knobPixels = projection[11] != 0.0f ? 2.0f*LEGO_KNOB_RADIUS*scale*projection[5]*viewport[3]/2.0f : 0.0f;
+  }
+
+  bool isBoxVisible(const Vector3& boundsMin, const Vector3& boundsMax) const
+  {
+    for(int i = 0; i < 6; i++)
+    {
+      //Corner of the box the furthest along the plane normal
+      const float x = planes[i][0] >= 0.0f ? boundsMax[0] : boundsMin[0];
+      const float y = planes[i][1] >= 0.0f ? boundsMax[1] : boundsMin[1];
+      const float z = planes[i][2] >= 0.0f ? boundsMax[2] : boundsMin[2];
+      if(planes[i][0]*x + planes[i][1]*y + planes[i][2]*z + planes[i][3] < 0.0f)
+        return false;
+    }
+    return true;
+  }
+
+  //Diameter on screen of the nearest knob the box can contain
+  float knobSizeInPixels(const Vector3& boundsMin, const Vector3& boundsMax) const
+  {
+    if(knobPixels == 0.0f)
+      return FLT_MAX;
+
+    float depth = FLT_MAX;
+    for(int corner = 0; corner < 8; corner++)
+    {
+      const float x = (corner & 1) ? boundsMax[0] : boundsMin[0];
+      const float y = (corner & 2) ? boundsMax[1] : boundsMin[1];
+      const float z = (corner & 4) ? boundsMax[2] : boundsMin[2];
+      depth = std::min(depth, -(modelView[2]*x + modelView[6]*y + modelView[10]*z + modelView[14]));
+    }
+
+    return depth > 0.0f ? knobPixels/depth : FLT_MAX;
+  }
+
+  float planes[6][4];//(a, b, c, d) in world space, a*x + b*y + c*z + d >= 0 inside
+  GLfloat modelView[16];
+  float knobPixels;//Knob diameter on screen at an eye space depth of 1
+};
+
+}
+
+LegoRenderMesh::Chunk::Chunk()
+  : boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX)
+{
+}
+
+LegoRenderMesh::LegoRenderMesh()
+  : vertexBuffer_(QGLBuffer::VertexBuffer), colorBuffer_(QGLBuffer::VertexBuffer), indexBuffer_(QGLBuffer::IndexBuffer), lineBuffer_(QGLBuffer::VertexBuffer),
+    vertexNumber_(0), instancingSupport_(InstancingUnknown), knobMeshBuffer_(QGLBuffer::VertexBuffer), knobInstanceBuffer_(QGLBuffer::VertexBuffer),
+    knobColorBuffer_(QGLBuffer::VertexBuffer), knobNumber_(0), knobCapVertexNumber_(0), knobTriangleVertexNumber_(0), knobLineVertexNumber_(0),
+    vertexAttribDivisor_(NULL), drawArraysInstanced_(NULL)
+{
+}
+
+LegoRenderMesh::~LegoRenderMesh()
+{
+}
+
+void LegoRenderMesh::Geometry::clear()
+{
+  std::vector<Vertex>().swap(vertices_);
+  std::vector<unsigned int>().swap(triangleIndices_);
+  std::vector<float>().swap(lineVertices_);
+  std::vector<KnobInstance>().swap(knobInstances_);
+  std::vector<BrickColors>().swap(knobColors_);
+  std::vector<Chunk>().swap(chunks_);
+  for(int mode = 0; mode < COLOR_MODE_NUMBER; mode++)
+  {
+    std::vector<unsigned char>().swap(vertexColors_[mode]);
+  }
+}
+
+void LegoRenderMesh::Geometry::beginChunk()
+{
+  Chunk chunk;
+  chunk.triangleIndices.first = triangleIndices_.size();
+  chunk.lineVertices.first = lineVertices_.size()/3;
+  chunk.knobInstances.first = knobInstances_.size();
+  chunks_.push_back(chunk);
+}
+
+LegoRenderMesh::BrickColors LegoRenderMesh::toBrickColors(const Color3 colors[COLOR_MODE_NUMBER])
+{
+  BrickColors brickColors;
+  for(int mode = 0; mode < COLOR_MODE_NUMBER; mode++)
+  {
+    for(int i = 0; i < 3; i++)
+    {
+      brickColors.rgba[mode][i] = (unsigned char)(colors[mode][i]*255);
+    }
+    brickColors.rgba[mode][3] = 255;
+  }
+  return brickColors;
+}
+
+void LegoRenderMesh::Geometry::addBrick(const LegoBrick& brick, const BrickColors& colors, const LegoOccupancy* occupancy)
+{
+  Vector3 p1;//Back corner down left
+  p1[0] = brick.getPosX()*LEGO_KNOB_DISTANCE + LEGO_HORIZONTAL_TOLERANCE;
+  p1[1] = brick.getLevel()*LEGO_HEIGHT;
+  p1[2] = brick.getPosY()*LEGO_KNOB_DISTANCE + LEGO_HORIZONTAL_TOLERANCE;
+
+  Vector3 p2;//Front corner up right
+  p2[0] = p1[0] + brick.getSizeX()*LEGO_KNOB_DISTANCE - LEGO_HORIZONTAL_TOLERANCE;
+  p2[1] = p1[1] + LEGO_HEIGHT;
+  p2[2] = p1[2] + brick.getSizeY()*LEGO_KNOB_DISTANCE - LEGO_HORIZONTAL_TOLERANCE;
+
+  if(chunks_.empty())
+    beginChunk();
+
+  Chunk& chunk = chunks_.back();
+  chunk.boundsMin = chunk.boundsMin.min(p1);
+  chunk.boundsMax = chunk.boundsMax.max(p2 + Vector3(0, LEGO_KNOB_HEIGHT, 0));
+
+  //Box, without the faces against other bricks
+  quads_.clear();
+  LegoMesher::brickFaces(brick, occupancy, quads_);
+  for(size_t i = 0; i < quads_.size(); i++)
+  {
+    const LegoMesher::Quad& quad = quads_[i];
+    addQuad(quad.corners, quad.faceCoords, quad.normal, colors);
+  }
+
+  //Box outline
+  addLine(Vector3(p2[0], p1[1], p1[2]), Vector3(p2[0], p2[1], p1[2]));//Right
+  addLine(Vector3(p2[0], p2[1], p1[2]), Vector3(p2[0], p2[1], p2[2]));
+  addLine(Vector3(p2[0], p2[1], p2[2]), Vector3(p2[0], p1[1], p2[2]));
+  addLine(Vector3(p2[0], p1[1], p2[2]), Vector3(p2[0], p1[1], p1[2]));
+  addLine(Vector3(p1[0], p1[1], p1[2]), Vector3(p1[0], p1[1], p2[2]));//Left
+  addLine(Vector3(p1[0], p1[1], p2[2]), Vector3(p1[0], p2[1], p2[2]));
+  addLine(Vector3(p1[0], p2[1], p2[2]), Vector3(p1[0], p2[1], p1[2]));
+  addLine(Vector3(p1[0], p2[1], p1[2]), Vector3(p1[0], p1[1], p1[2]));
+  addLine(Vector3(p1[0], p1[1], p1[2]), Vector3(p2[0], p1[1], p1[2]));
+  addLine(Vector3(p1[0], p1[1], p2[2]), Vector3(p2[0], p1[1], p2[2]));
+  addLine(Vector3(p1[0], p2[1], p2[2]), Vector3(p2[0], p2[1], p2[2]));
+  addLine(Vector3(p1[0], p2[1], p1[2]), Vector3(p2[0], p2[1], p1[2]));
+
+  //Knobs, as instances of the knob mesh
+  KnobInstance knob;
+  knob.offset[1] = p1[1] + LEGO_HEIGHT + LEGO_KNOB_HEIGHT;
+
+  for(int x = 0; x < brick.getSizeX(); ++x)
+  {
+    for(int y = 0; y < brick.getSizeY(); ++y)
+    {
+      if(LegoMesher::isKnobCovered(brick, x, y, occupancy))
+        continue;
+
+      knob.offset[0] = p1[0] + LEGO_KNOB_DISTANCE/2.0 + x*LEGO_KNOB_DISTANCE;
+      knob.offset[2] = p1[2] + LEGO_KNOB_DISTANCE/2.0 + y*LEGO_KNOB_DISTANCE;
+      knobInstances_.push_back(knob);
+      knobColors_.push_back(colors);
+    }
+  }
+
+  chunk.triangleIndices.count = triangleIndices_.size() - chunk.triangleIndices.first;
+  chunk.lineVertices.count = lineVertices_.size()/3 - chunk.lineVertices.first;
+  chunk.knobInstances.count = knobInstances_.size() - chunk.knobInstances.first;
+}
+
+void LegoRenderMesh::Geometry::addKnobCap(const KnobInstance& knob, const BrickColors& colors)
+{
+  const Vector3 center(knob.offset[0], knob.offset[1], knob.offset[2]);
+  const Vector3 up(0, 1, 0);
+
+  const unsigned int capStart = vertices_.size();
+  for(int i = 0; i < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    addVertex(center + knobRing(i), up, colors);
+  }
+
+  for(int i = 1; i+1 < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    triangleIndices_.push_back(capStart);
+    triangleIndices_.push_back(capStart + i);
+    triangleIndices_.push_back(capStart + i+1);
+  }
+}
+
+void LegoRenderMesh::Geometry::addKnobSide(const KnobInstance& knob, const BrickColors& colors)
+{
+  const Vector3 center(knob.offset[0], knob.offset[1], knob.offset[2]);
+  const Vector3 height(0, LEGO_KNOB_HEIGHT, 0);
+
+  //(top, bottom) pairs
+  const unsigned int cylinderStart = vertices_.size();
+  for(int i = 0; i < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    const Vector3 normal(KNOB_CIRCLE[i][0], 0.0, KNOB_CIRCLE[i][1]);
+    addVertex(center + knobRing(i), normal, colors);
+    addVertex(center + knobRing(i) - height, normal, colors);
+  }
+
+  for(int i = 0; i < KNOB_RESOLUTION_DISPLAY; ++i)
+  {
+    const int next = (i+1) % KNOB_RESOLUTION_DISPLAY;
+    const unsigned int top = cylinderStart + 2*i;
+    const unsigned int nextTop = cylinderStart + 2*next;
+    triangleIndices_.push_back(top);
+    triangleIndices_.push_back(top+1);
+    triangleIndices_.push_back(nextTop+1);
+    triangleIndices_.push_back(top);
+    triangleIndices_.push_back(nextTop+1);
+    triangleIndices_.push_back(nextTop);
+  }
+}
+
+void LegoRenderMesh::Geometry::expandKnobs()
+{
+  //After all the boxes: the caps of every chunk, then the sides, then the outlines.
+  //Each kind stays contiguous across chunks, so a run of chunks is a single range of it.
+  for(size_t c = 0; c < chunks_.size(); c++)
+  {
+    Chunk& chunk = chunks_[c];
+    chunk.knobCapTriangleIndices.first = triangleIndices_.size();
+    for(int i = chunk.knobInstances.first; i < chunk.knobInstances.first + chunk.knobInstances.count; i++)
+    {
+      addKnobCap(knobInstances_[i], knobColors_[i]);
+    }
+    chunk.knobCapTriangleIndices.count = triangleIndices_.size() - chunk.knobCapTriangleIndices.first;
+  }
+
+  for(size_t c = 0; c < chunks_.size(); c++)
+  {
+    Chunk& chunk = chunks_[c];
+    chunk.knobSideTriangleIndices.first = triangleIndices_.size();
+    for(int i = chunk.knobInstances.first; i < chunk.knobInstances.first + chunk.knobInstances.count; i++)
+    {
+      addKnobSide(knobInstances_[i], knobColors_[i]);
+    }
+    chunk.knobSideTriangleIndices.count = triangleIndices_.size() - chunk.knobSideTriangleIndices.first;
+  }
+
+  for(size_t c = 0; c < chunks_.size(); c++)
+  {
+    Chunk& chunk = chunks_[c];
+    chunk.knobLineVertices.first = lineVertices_.size()/3;
+    for(int i = chunk.knobInstances.first; i < chunk.knobInstances.first + chunk.knobInstances.count; i++)
+    {
+      const Vector3 center(knobInstances_[i].offset[0], knobInstances_[i].offset[1], knobInstances_[i].offset[2]);
+      const Vector3 height(0, LEGO_KNOB_HEIGHT, 0);
+      for(int k = 0; k < KNOB_RESOLUTION_DISPLAY; ++k)
+      {
+        const int next = (k+1) % KNOB_RESOLUTION_DISPLAY;
+        addLine(center + knobRing(k), center + knobRing(next));
+        addLine(center + knobRing(k) - height, center + knobRing(next) - height);
+      }
+    }
+    chunk.knobLineVertices.count = lineVertices_.size()/3 - chunk.knobLineVertices.first;
+  }
+
+  for(size_t c = 0; c < chunks_.size(); c++)
+  {
+    chunks_[c].knobInstances.count = 0;
+  }
+}
+
+void LegoRenderMesh::Geometry::addQuad(const Vector3 corners[4], const float faceCoords[4][2], const Vector3& normal, const BrickColors& colors)
+{
+  //The face coordinates span the whole brick face: the seams between the quads of a partly hidden face are not darkened
+  unsigned int first = 0;
+  for(int i = 0; i < 4; i++)
+  {
+    const unsigned int index = addVertex(corners[i], normal, colors, (unsigned char)qRound(faceCoords[i][0]*255.0f), (unsigned char)qRound(faceCoords[i][1]*255.0f));
+    if(i == 0)
+      first = index;
+  }
+
+  triangleIndices_.push_back(first);
+  triangleIndices_.push_back(first+1);
+  triangleIndices_.push_back(first+2);
+  triangleIndices_.push_back(first);
+  triangleIndices_.push_back(first+2);
+  triangleIndices_.push_back(first+3);
+}
+
+unsigned int LegoRenderMesh::Geometry::addVertex(const Vector3& position, const Vector3& normal, const BrickColors& colors, unsigned char u, unsigned char v)
+{
+  Vertex vertex;
+  for(int i = 0; i < 3; i++)
+  {
+    vertex.position[i] = position[i];
+    vertex.normal[i] = (signed char)(qRound(normal[i]*127.0f));
+  }
+  vertex.normal[3] = 0;
+  vertex.faceCoord[0] = u;
+  vertex.faceCoord[1] = v;
+  vertex.faceCoord[2] = 0;
+  vertex.faceCoord[3] = 0;
+
+  vertices_.push_back(vertex);
+  for(int mode = 0; mode < COLOR_MODE_NUMBER; mode++)
+  {
+    vertexColors_[mode].insert(vertexColors_[mode].end(), colors.rgba[mode], colors.rgba[mode] + 4);
+  }
+  return vertices_.size() - 1;
+}
+
+void LegoRenderMesh::Geometry::addLine(const Vector3& a, const Vector3& b)
+{
+  lineVertices_.insert(lineVertices_.end(), a.data(), a.data() + 3);
+  lineVertices_.insert(lineVertices_.end(), b.data(), b.data() + 3);
+}
+
+void LegoRenderMesh::initShaders()
+{
+  if(instancingSupport_ != InstancingUnknown)
+    return;
+
+  instancingSupport_ = InstancingUnsupported;
+
+  const QGLContext* context = QGLContext::currentContext();
+  if(!context || !QGLShaderProgram::hasOpenGLShaderPrograms())
+  {
+    std::cout << "LegoRenderMesh: no shader support, knobs are drawn as static geometry and outlines as lines" << std::endl;
+    return;
+  }
+
+  faceProgram_.reset(new QGLShaderProgram());
+  if(!faceProgram_->addShaderFromSourceCode(QGLShader::Vertex, FACE_VERTEX_SHADER) ||
+     !faceProgram_->addShaderFromSourceCode(QGLShader::Fragment, FACE_FRAGMENT_SHADER) ||
+     !faceProgram_->link())
+  {
+    std::cerr << "LegoRenderMesh: unable to build the face shader: " << qPrintable(faceProgram_->log()) << std::endl;
+    faceProgram_.reset();
+  }
+
+  vertexAttribDivisor_ = (VertexAttribDivisorFunction) context->getProcAddress("glVertexAttribDivisor");
+  if(!vertexAttribDivisor_)
+    vertexAttribDivisor_ = (VertexAttribDivisorFunction) context->getProcAddress("glVertexAttribDivisorARB");
+
+  drawArraysInstanced_ = (DrawArraysInstancedFunction) context->getProcAddress("glDrawArraysInstanced");
+  if(!drawArraysInstanced_)
+    drawArraysInstanced_ = (DrawArraysInstancedFunction) context->getProcAddress("glDrawArraysInstancedARB");
+
+  if(!vertexAttribDivisor_ || !drawArraysInstanced_)
+  {
+    std::cout << "LegoRenderMesh: instancing is not available, knobs are drawn as static geometry" << std::endl;
+    return;
+  }
+
+  knobProgram_.reset(new QGLShaderProgram());
+  if(!knobProgram_->addShaderFromSourceCode(QGLShader::Vertex, KNOB_VERTEX_SHADER) ||
+     !knobProgram_->addShaderFromSourceCode(QGLShader::Fragment, KNOB_FRAGMENT_SHADER) ||
+     !knobProgram_->link())
+  {
+    std::cerr << "LegoRenderMesh: unable to build the knob shader: " << qPrintable(knobProgram_->log()) << std::endl;
+    knobProgram_.reset();
+    return;
+  }
+
+  std::vector<KnobVertex> knobMesh;
+  buildKnobMesh(knobMesh, knobCapVertexNumber_, knobTriangleVertexNumber_, knobLineVertexNumber_);
+
+  knobMeshBuffer_.create();
+  knobMeshBuffer_.bind();
+  knobMeshBuffer_.allocate(&knobMesh[0], knobMesh.size()*sizeof(KnobVertex));
+  knobMeshBuffer_.release();
+
+  knobInstanceBuffer_.create();
+  knobColorBuffer_.create();
+
+  instancingSupport_ = InstancingSupported;
+}
+
+void LegoRenderMesh::upload(Geometry& geometry)
+{
+  initShaders();
+
+  if(instancingSupport_ == InstancingSupported)
+  {
+    knobInstanceBuffer_.bind();
+    knobInstanceBuffer_.allocate(geometry.knobInstances_.empty() ? NULL : &geometry.knobInstances_[0], geometry.knobInstances_.size()*sizeof(KnobInstance));
+    knobInstanceBuffer_.release();
+
+    //One stream per color mode, one after the other
+    knobNumber_ = geometry.knobInstances_.size();
+    knobColorBuffer_.bind();
+    knobColorBuffer_.allocate(COLOR_MODE_NUMBER*knobNumber_*4);
+    for(int mode = 0; mode < COLOR_MODE_NUMBER && knobNumber_ > 0; mode++)
+    {
+      std::vector<unsigned char> stream(knobNumber_*4);
+      for(int i = 0; i < knobNumber_; i++)
+      {
+        std::copy(geometry.knobColors_[i].rgba[mode], geometry.knobColors_[i].rgba[mode] + 4, &stream[i*4]);
+      }
+      knobColorBuffer_.write(mode*knobNumber_*4, &stream[0], knobNumber_*4);
+    }
+    knobColorBuffer_.release();
+  }
+  else
+  {
+    geometry.expandKnobs();
+  }
+
+  //The edge shader replaces the box outlines
+  if(faceProgram_)
+  {
+    for(size_t c = 0; c < geometry.chunks_.size(); c++)
+    {
+      geometry.chunks_[c].lineVertices.count = 0;
+    }
+  }
+
+  if(!vertexBuffer_.isCreated())
+  {
+    vertexBuffer_.create();
+    colorBuffer_.create();
+    indexBuffer_.create();
+    lineBuffer_.create();
+  }
+
+  vertexBuffer_.bind();
+  vertexBuffer_.allocate(geometry.vertices_.empty() ? NULL : &geometry.vertices_[0], geometry.vertices_.size()*sizeof(Vertex));
+  vertexBuffer_.release();
+
+  vertexNumber_ = geometry.vertices_.size();
+  colorBuffer_.bind();
+  colorBuffer_.allocate(COLOR_MODE_NUMBER*vertexNumber_*4);
+  for(int mode = 0; mode < COLOR_MODE_NUMBER && vertexNumber_ > 0; mode++)
+  {
+    colorBuffer_.write(mode*vertexNumber_*4, &geometry.vertexColors_[mode][0], vertexNumber_*4);
+  }
+  colorBuffer_.release();
+
+  indexBuffer_.bind();
+  indexBuffer_.allocate(geometry.triangleIndices_.empty() ? NULL : &geometry.triangleIndices_[0], geometry.triangleIndices_.size()*sizeof(unsigned int));
+  indexBuffer_.release();
+
+  lineBuffer_.bind();
+  lineBuffer_.allocate(geometry.lineVertices_.empty() ? NULL : &geometry.lineVertices_[0], geometry.lineVertices_.size()*sizeof(float));
+  lineBuffer_.release();
+
+  //The GPU copy and the ranges are all that is needed from now on
+  chunks_.swap(geometry.chunks_);
+  geometry.clear();
+}
+
+void LegoRenderMesh::extendRuns(std::vector<Range>& runs, int chunk)
+{
+  if(!runs.empty() && runs.back().first + runs.back().count == chunk)
+  {
+    runs.back().count++;
+  }
+  else
+  {
+    Range run;
+    run.first = chunk;
+    run.count = 1;
+    runs.push_back(run);
+  }
+}
+
+void LegoRenderMesh::visibleChunkRuns(int onlyChunk, std::vector<Range>& runs, std::vector<Range>& capRuns, std::vector<Range>& fullRuns) const
+{
+  const View view;
+
+  const int first = onlyChunk >= 0 ? onlyChunk : 0;
+  const int end = onlyChunk >= 0 ? std::min(onlyChunk+1, int(chunks_.size())) : int(chunks_.size());
+  for(int c = first; c < end; c++)
+  {
+    const Chunk& chunk = chunks_[c];
+    const bool hasKnobs = chunk.knobInstances.count > 0 || chunk.knobCapTriangleIndices.count > 0;
+    if(chunk.triangleIndices.count == 0 && !hasKnobs)
+      continue;
+    if(!view.isBoxVisible(chunk.boundsMin, chunk.boundsMax))
+      continue;
+
+    extendRuns(runs, c);
+
+    if(hasKnobs)
+    {
+      const float knobSize = view.knobSizeInPixels(chunk.boundsMin, chunk.boundsMax);
+      if(knobSize >= KNOB_LOD_FULL_PIXELS)
+        extendRuns(fullRuns, c);
+      else if(knobSize >= KNOB_LOD_CAP_PIXELS)
+        extendRuns(capRuns, c);
+    }
+  }
+}
+
+LegoRenderMesh::Range LegoRenderMesh::runRange(const std::vector<Chunk>& chunks, const Range& run, Range Chunk::*range)
+{
+  const Range& first = chunks[run.first].*range;
+  const Range& last = chunks[run.first + run.count - 1].*range;
+
+  Range result;
+  result.first = first.first;
+  result.count = last.first + last.count - first.first;
+  return result;
+}
+
+void LegoRenderMesh::draw(int colorMode, int onlyChunk)
+{
+  if(!vertexBuffer_.isCreated())
+    return;
+
+  std::vector<Range> runs, capRuns, fullRuns;
+  visibleChunkRuns(onlyChunk, runs, capRuns, fullRuns);
+  if(runs.empty())
+    return;
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+
+  //Changing the color mode only moves the color pointer to another stream
+  colorBuffer_.bind();
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, (const GLvoid*)(size_t(colorMode)*vertexNumber_*4));
+  colorBuffer_.release();
+
+  vertexBuffer_.bind();
+  glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, position));
+  glNormalPointer(GL_BYTE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, normal));
+
+  int faceCoordLocation = -1;
+  if(faceProgram_)
+  {
+    faceProgram_->bind();
+    faceCoordLocation = faceProgram_->attributeLocation("faceCoord");
+    faceProgram_->enableAttributeArray(faceCoordLocation);
+    faceProgram_->setAttributeBuffer(faceCoordLocation, GL_UNSIGNED_BYTE, offsetof(Vertex, faceCoord), 2, sizeof(Vertex));
+  }
+
+  indexBuffer_.bind();
+  for(size_t i = 0; i < runs.size(); i++)
+  {
+    const Range boxes = runRange(chunks_, runs[i], &Chunk::triangleIndices);
+    if(boxes.count > 0)
+      glDrawElements(GL_TRIANGLES, boxes.count, GL_UNSIGNED_INT, (const GLvoid*)(boxes.first*sizeof(unsigned int)));
+  }
+
+  if(faceProgram_)
+  {
+    faceProgram_->disableAttributeArray(faceCoordLocation);
+    faceProgram_->release();
+  }
+
+  //Expanded knobs: caps when they are large enough, sides too when they are close
+  for(size_t i = 0; i < capRuns.size(); i++)
+  {
+    const Range caps = runRange(chunks_, capRuns[i], &Chunk::knobCapTriangleIndices);
+    if(caps.count > 0)
+      glDrawElements(GL_TRIANGLES, caps.count, GL_UNSIGNED_INT, (const GLvoid*)(caps.first*sizeof(unsigned int)));
+  }
+  for(size_t i = 0; i < fullRuns.size(); i++)
+  {
+    const Range caps = runRange(chunks_, fullRuns[i], &Chunk::knobCapTriangleIndices);
+    const Range sides = runRange(chunks_, fullRuns[i], &Chunk::knobSideTriangleIndices);
+    if(caps.count > 0)
+      glDrawElements(GL_TRIANGLES, caps.count, GL_UNSIGNED_INT, (const GLvoid*)(caps.first*sizeof(unsigned int)));
+    if(sides.count > 0)
+      glDrawElements(GL_TRIANGLES, sides.count, GL_UNSIGNED_INT, (const GLvoid*)(sides.first*sizeof(unsigned int)));
+  }
+  indexBuffer_.release();
+  vertexBuffer_.release();
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+
+  glColor3f(0.0f, 0.0f, 0.0f);
+  lineBuffer_.bind();
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  for(size_t i = 0; i < runs.size(); i++)
+  {
+    const Range boxes = runRange(chunks_, runs[i], &Chunk::lineVertices);
+    if(boxes.count > 0)
+      glDrawArrays(GL_LINES, boxes.first, boxes.count);
+  }
+  for(size_t i = 0; i < fullRuns.size(); i++)
+  {
+    const Range knobs = runRange(chunks_, fullRuns[i], &Chunk::knobLineVertices);
+    if(knobs.count > 0)
+      glDrawArrays(GL_LINES, knobs.first, knobs.count);
+  }
+  lineBuffer_.release();
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+  if(instancingSupport_ == InstancingSupported && (!capRuns.empty() || !fullRuns.empty()))
+    drawKnobInstances(colorMode, capRuns, fullRuns);
+}
+
+void LegoRenderMesh::drawKnobInstances(int colorMode, const std::vector<Range>& capRuns, const std::vector<Range>& fullRuns)
+{
+  knobProgram_->bind();
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  knobMeshBuffer_.bind();
+  glVertexPointer(3, GL_FLOAT, sizeof(KnobVertex), (const GLvoid*)offsetof(KnobVertex, position));
+  glNormalPointer(GL_FLOAT, sizeof(KnobVertex), (const GLvoid*)offsetof(KnobVertex, normal));
+  knobMeshBuffer_.release();
+
+  const int offsetLocation = knobProgram_->attributeLocation("instanceOffset");
+  const int colorLocation = knobProgram_->attributeLocation("instanceColor");
+
+  knobProgram_->enableAttributeArray(offsetLocation);
+  knobProgram_->enableAttributeArray(colorLocation);
+  vertexAttribDivisor_(offsetLocation, 1);
+  vertexAttribDivisor_(colorLocation, 1);
+
+  for(int lod = KnobsCap; lod <= KnobsFull; lod++)
+  {
+    const std::vector<Range>& runs = lod == KnobsFull ? fullRuns : capRuns;
+    for(size_t i = 0; i < runs.size(); i++)
+    {
+      const Range knobs = runRange(chunks_, runs[i], &Chunk::knobInstances);
+      if(knobs.count == 0)
+        continue;
+
+      //No base instance in GL 2, the instance attributes start at the first knob of the run instead
+      knobInstanceBuffer_.bind();
+      knobProgram_->setAttributeBuffer(offsetLocation, GL_FLOAT, knobs.first*sizeof(KnobInstance) + offsetof(KnobInstance, offset), 3, sizeof(KnobInstance));
+      knobInstanceBuffer_.release();
+      knobColorBuffer_.bind();
+      knobProgram_->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE, (colorMode*knobNumber_ + knobs.first)*4, 4, 0);
+      knobColorBuffer_.release();
+
+      knobProgram_->setUniformValue("lit", 1.0f);
+      drawArraysInstanced_(GL_TRIANGLES, 0, lod == KnobsFull ? knobTriangleVertexNumber_ : knobCapVertexNumber_, knobs.count);
+
+      if(lod == KnobsFull)
+      {
+        knobProgram_->setUniformValue("lit", 0.0f);
+        drawArraysInstanced_(GL_LINES, knobTriangleVertexNumber_, knobLineVertexNumber_, knobs.count);
+      }
+    }
+  }
+
+  vertexAttribDivisor_(offsetLocation, 0);
+  vertexAttribDivisor_(colorLocation, 0);
+  knobProgram_->disableAttributeArray(offsetLocation);
+  knobProgram_->disableAttributeArray(colorLocation);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+  knobProgram_->release();
+}
@@ -0,0 +1,157 @@
+#ifndef LEGO_RENDER_MESH_H
+#define LEGO_RENDER_MESH_H
+
+#include <QGLBuffer>
+
+#include <memory>
+#include <vector>
+
+#include "LegoBrick.h"
+#include "LegoMesher.h"
+
+class QGLShaderProgram;
+
+//Brick geometry displayed by LegoCloudNode.
+//Built on the CPU as a Geometry when the cloud changes, then kept in vertex buffers and drawn with a few calls per frame.
+//Knobs are instances of a single knob mesh; without instancing support they are expanded at upload.
+//The geometry is split in chunks (one per level) with bounding boxes, drawn only when they are in the view frustum.
+//The knobs of a chunk are drawn in full, as flat caps or not at all depending on their size on screen.
+//Colors are kept apart from the vertices, one stream per color mode, so that changing the mode only changes the stream drawn.
+class LegoRenderMesh
+{
+public:
+  //Same order as LegoCloudNode::ColorRendering
+  static const int COLOR_MODE_NUMBER = 4;
+
+  //Color of a brick in each color mode
+  struct BrickColors
+  {
+    unsigned char rgba[COLOR_MODE_NUMBER][4];
+  };
+
+  static BrickColors toBrickColors(const Color3 colors[COLOR_MODE_NUMBER]);
+
+  struct Vertex
+  {
+    float position[3];
+    signed char normal[4];//Normalized by GL, the 4th byte is padding
+    unsigned char faceCoord[4];//(u, v) across the brick face, 0 or 255 on its sides, for the edges. The last 2 bytes are padding
+  };
+
+  struct KnobInstance
+  {
+    float offset[3];//Center of the knob top
+  };
+
+  class Geometry;
+
+  LegoRenderMesh();
+  ~LegoRenderMesh();
+
+  //Moves the geometry to the GPU and replaces the previous one, needs a current GL context. The geometry is left empty.
+  void upload(Geometry& geometry);
+
+  //Colored faces with dark edges, then knobs, with the current GL state (lighting, color material).
+  //Only the chunk onlyChunk if it is >= 0, and only the chunks in the frustum of the current GL matrices.
+  //colorMode picks the color stream, in [0, COLOR_MODE_NUMBER).
+  void draw(int colorMode, int onlyChunk = -1);
+
+  inline int getChunkNumber() const {return chunks_.size();}
+
+private:
+  struct Range
+  {
+    Range() : first(0), count(0) {}
+    int first;
+    int count;
+  };
+
+  struct Chunk
+  {
+    Chunk();
+
+    Range triangleIndices;
+    Range lineVertices;//Box outlines, without the edge shader
+    Range knobInstances;
+    Range knobCapTriangleIndices;//Expanded knobs, without instancing
+    Range knobSideTriangleIndices;
+    Range knobLineVertices;
+    Vector3 boundsMin;
+    Vector3 boundsMax;
+  };
+
+public:
+  //CPU side of the mesh, needs no GL context so it can be built on any thread
+  class Geometry
+  {
+  public:
+    void clear();
+    //The next bricks go to a new chunk
+    void beginChunk();
+    //Faces touching an occupied cell and covered knobs are skipped; occupancy can be NULL
+    void addBrick(const LegoBrick& brick, const BrickColors& colors, const LegoOccupancy* occupancy = NULL);
+
+  private:
+    friend class LegoRenderMesh;
+
+    void addQuad(const Vector3 corners[4], const float faceCoords[4][2], const Vector3& normal, const BrickColors& colors);
+    unsigned int addVertex(const Vector3& position, const Vector3& normal, const BrickColors& colors, unsigned char u = 0, unsigned char v = 0);
+    void addLine(const Vector3& a, const Vector3& b);
+    void addKnobCap(const KnobInstance& knob, const BrickColors& colors);
+    void addKnobSide(const KnobInstance& knob, const BrickColors& colors);
+    //Knob instances to static geometry, when instancing is not available
+    void expandKnobs();
+
+    std::vector<Vertex> vertices_;
+    std::vector<unsigned char> vertexColors_[COLOR_MODE_NUMBER];//RGBA per vertex, one stream per mode
+    std::vector<unsigned int> triangleIndices_;
+    std::vector<float> lineVertices_;
+    std::vector<KnobInstance> knobInstances_;
+    std::vector<BrickColors> knobColors_;//Per instance
+    std::vector<LegoMesher::Quad> quads_;//Scratch
+    std::vector<Chunk> chunks_;
+  };
+
+private:
+  enum KnobLod {KnobsNone, KnobsCap, KnobsFull};
+
+  //Chunks drawn this frame, as runs of consecutive chunks, and the ones of them whose knobs are drawn as caps or in full
+  void visibleChunkRuns(int onlyChunk, std::vector<Range>& runs, std::vector<Range>& capRuns, std::vector<Range>& fullRuns) const;
+  //Adds the chunk to the runs, extending the last run when they follow each other
+  static void extendRuns(std::vector<Range>& runs, int chunk);
+  //Union of the range of the chunks of the run
+  static Range runRange(const std::vector<Chunk>& chunks, const Range& run, Range Chunk::*range);
+
+  void initShaders();
+  void drawKnobInstances(int colorMode, const std::vector<Range>& capRuns, const std::vector<Range>& fullRuns);
+
+  std::vector<Chunk> chunks_;//Ranges in the GPU buffers
+
+  QGLBuffer vertexBuffer_;
+  QGLBuffer colorBuffer_;//The streams of all the modes, one after the other
+  QGLBuffer indexBuffer_;
+  QGLBuffer lineBuffer_;
+  int vertexNumber_;
+
+  //Screen space brick edges, replace the outline lines when available
+  std::unique_ptr<QGLShaderProgram> faceProgram_;
+
+  //Instanced knobs
+  enum InstancingSupport {InstancingUnknown, InstancingSupported, InstancingUnsupported};
+  InstancingSupport instancingSupport_;
+  std::unique_ptr<QGLShaderProgram> knobProgram_;
+  QGLBuffer knobMeshBuffer_;//Vertex, cap triangles, side triangles then outline lines
+  QGLBuffer knobInstanceBuffer_;
+  QGLBuffer knobColorBuffer_;//Per instance, one stream per mode like colorBuffer_
+  int knobNumber_;
+  int knobCapVertexNumber_;
+  int knobTriangleVertexNumber_;
+  int knobLineVertexNumber_;
+
+  typedef void (APIENTRY *VertexAttribDivisorFunction)(GLuint index, GLuint divisor);
+  typedef void (APIENTRY *DrawArraysInstancedFunction)(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+  VertexAttribDivisorFunction vertexAttribDivisor_;
+  DrawArraysInstancedFunction drawArraysInstanced_;
+};
+
+#endif // LEGO_RENDER_MESH_H
@@ -0,0 +1,95 @@
+#include "LogRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+LogRingBuffer::LogRingBuffer(size_t slotNumber)
+  : slots_(new Slot[slotNumber]), mask_(slotNumber - 1), tail_(0), head_(0),
+    pushedMessages_(0), droppedMessages_(0), droppedBytes_(0)
+{
+  Q_ASSERT(slotNumber > 0 && (slotNumber & mask_) == 0);
+  for(size_t i = 0; i < slotNumber; i++)
+  {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].length = 0;
+  }
+}
+
+LogRingBuffer::~LogRingBuffer()
+{
+  delete[] slots_;
+}
+
+bool LogRingBuffer::push(const char* text, size_t length)
+{
+  if(length == 0)
+    return true;
+
+  const size_t slotNumber = (length + SLOT_SIZE - 1)/SLOT_SIZE;
+  size_t position;
+  if(slotNumber > mask_ + 1 || !claim(slotNumber, position))
+  {
+    droppedMessages_.fetch_add(1, std::memory_order_relaxed);
+    droppedBytes_.fetch_add(length, std::memory_order_relaxed);
+    return false;
+  }
+
+  for(size_t i = 0; i < slotNumber; i++)
+  {
+    Slot& slot = slots_[(position + i) & mask_];
+    const size_t offset = i*SLOT_SIZE;
+    const int slotLength = int(std::min(length - offset, size_t(SLOT_SIZE)));
+    std::memcpy(slot.text, text + offset, slotLength);
+    slot.length = slotLength;
+    slot.sequence.store(position + i + 1, std::memory_order_release);
+  }
+  pushedMessages_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool LogRingBuffer::claim(size_t slotNumber, size_t& position)
+{
+  //The consumer frees the slots in order: when the last one is free, the previous ones are too
+  position = tail_.load(std::memory_order_relaxed);
+  for(;;)
+  {
+    const size_t last = position + slotNumber - 1;
+    const size_t sequence = slots_[last & mask_].sequence.load(std::memory_order_acquire);
+    const std::ptrdiff_t difference = std::ptrdiff_t(sequence) - std::ptrdiff_t(last);
+    if(difference == 0)
+    {
+      //Free slots, claim them (on failure position is reloaded)
+      if(tail_.compare_exchange_weak(position, position + slotNumber, std::memory_order_relaxed))
+        return true;
+    }
+    else if(difference < 0)
+    {
+      //The consumer has not read the last slot yet: full
+      return false;
+    }
+    else
+    {
+      //Another writer claimed it first
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+int LogRingBuffer::drain(QByteArray& output, int maxBytes)
+{
+  int drained = 0;
+  for(;;)
+  {
+    Slot& slot = slots_[head_ & mask_];
+    if(slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+      break;//Empty, or the writer of the next slot has not finished
+    if(drained > 0 && drained + slot.length > maxBytes)
+      break;
+
+    output.append(slot.text, slot.length);
+    drained += slot.length;
+    slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    head_++;
+  }
+  return drained;
+}
@@ -0,0 +1,60 @@
+#ifndef LOG_RING_BUFFER_H
+#define LOG_RING_BUFFER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+
+//Bounded lock-free queue of log text, written by any thread and read by a single consumer.
+//A message is cut into fixed size slots, all claimed at once with a compare-and-swap on the tail
+//and each published with a sequence number, so writers never wait for the reader nor for each other's lock
+//and the slots of a message are never interleaved with another one's.
+//When the message does not fit it is dropped whole and counted instead of blocking the engine.
+class LogRingBuffer
+{
+public:
+  static const int SLOT_SIZE = 240;//Bytes of text per slot, longer messages use several slots
+  static const size_t DEFAULT_SLOT_NUMBER = 4096;//Must be a power of two
+
+  explicit LogRingBuffer(size_t slotNumber = DEFAULT_SLOT_NUMBER);
+  ~LogRingBuffer();
+
+  //Any thread. False if the message was dropped
+  bool push(const char* text, size_t length);
+
+  //Consumer thread only. Appends the queued text to output, at most maxBytes (a slot is never cut, but a message can be)
+  //Returns the number of bytes appended
+  int drain(QByteArray& output, int maxBytes);
+
+  inline qint64 getPushedMessages() const {return pushedMessages_.load(std::memory_order_relaxed);}
+  inline qint64 getDroppedMessages() const {return droppedMessages_.load(std::memory_order_relaxed);}
+  inline qint64 getDroppedBytes() const {return droppedBytes_.load(std::memory_order_relaxed);}
+
+private:
+  LogRingBuffer(const LogRingBuffer&);
+  LogRingBuffer& operator=(const LogRingBuffer&);
+
+  struct Slot
+  {
+    std::atomic<size_t> sequence;//== position when free, position+1 when written
+    int length;
+    char text[SLOT_SIZE];
+  };
+
+  //Reserves slotNumber consecutive slots starting at position, false if they are not all free
+  bool claim(size_t slotNumber, size_t& position);
+
+  Slot* slots_;
+  const size_t mask_;
+
+  std::atomic<size_t> tail_;//Next position to write
+  size_t head_;//Next position to read, only used by the consumer
+
+  std::atomic<qint64> pushedMessages_;
+  std::atomic<qint64> droppedMessages_;
+  std::atomic<qint64> droppedBytes_;
+};
+
+#endif // LOG_RING_BUFFER_H
@@ -0,0 +1,456 @@
+#include "ObjParser.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)//Smaller files are not worth splitting
+
+namespace
+{
+
+//Everything read from one line-aligned part of the file
+struct ObjChunk
+{
+  std::vector<Vector3> positions;
+  std::vector<int> faceSizes;
+  std::vector<int> faceIndices;//0-based; relative indices are stored relative to the chunk first vertex
+  std::vector<int> relativeSlots;//Positions in faceIndices that still need the chunk vertex offset
+  Vector3 boundsMin;
+  Vector3 boundsMax;
+  const char* malformedLine;//First "v" line without 3 numbers, NULL if none
+};
+
+inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+  while(p < end && isBlank(*p))
+    ++p;
+  return p;
+}
+
+inline const char* skipLine(const char* p, const char* end)
+{
+  while(p < end && *p != '\n')
+    ++p;
+  return p < end ? p+1 : end;
+}
+
+inline bool parseInt(const char*& p, const char* end, int& value)
+{
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  if(p == end || *p < '0' || *p > '9')
+    return false;
+
+  int result = 0;
+  while(p < end && *p >= '0' && *p <= '9')
+  {
+    result = result*10 + (*p - '0');
+    ++p;
+  }
+
+  value = negative ? -result : result;
+  return true;
+}
+
+inline bool parseFloat(const char*& p, const char* end, float& value)
+{
+  static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                         1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+  const char* start = p;
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  unsigned long long mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+
+  while(p < end && *p >= '0' && *p <= '9')
+  {
+    if(digits < 18)
+      mantissa = mantissa*10 + (*p - '0');
+    else
+      exponent++;
+    ++digits;
+    ++p;
+  }
+
+  if(p < end && *p == '.')
+  {
+    ++p;
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+      if(digits < 18)
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        exponent--;
+      }
+      ++digits;
+      ++p;
+    }
+  }
+
+  if(digits == 0)
+  {
+    p = start;
+    return false;
+  }
+
+  if(p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* exponentStart = p;
+    ++p;
+    int explicitExponent;
+    if(parseInt(p, end, explicitExponent))
+      exponent += explicitExponent;
+    else
+      p = exponentStart;
+  }
+
+  double result = double(mantissa);
+  if(exponent < 0)
+  {
+    while(exponent < -18)
+    {
+      result /= 1e18;
+      exponent += 18;
+    }
+    result /= POWERS_OF_TEN[-exponent];
+  }
+  else
+  {
+    while(exponent > 18)
+    {
+      result *= 1e18;
+      exponent -= 18;
+    }
+    result *= POWERS_OF_TEN[exponent];
+  }
+
+  value = float(negative ? -result : result);
+  return true;
+}
+
+void parseChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+  chunk.boundsMin = Vector3( 1e9, 1e9, 1e9);
+  chunk.boundsMax = Vector3(-1e9,-1e9,-1e9);
+  chunk.malformedLine = NULL;
+
+  const char* p = begin;
+  while(p < end)
+  {
+    p = skipBlanks(p, end);
+    if(p == end)
+      break;
+
+    if(*p == 'v' && p+1 < end && isBlank(p[1]))
+    {
+      const char* line = p;
+      p += 2;
+      Vector3 position;
+      bool valid = true;
+      for(int i = 0; i < 3 && valid; ++i)
+      {
+        p = skipBlanks(p, end);
+        valid = parseFloat(p, end, position[i]);
+      }
+
+      if(valid)
+      {
+        chunk.boundsMin = chunk.boundsMin.min(position);
+        chunk.boundsMax = chunk.boundsMax.max(position);
+        chunk.positions.push_back(position);
+      }
+      else if(chunk.malformedLine == NULL)
+      {
+        chunk.malformedLine = line;
+      }
+    }
+    else if(*p == 'f' && p+1 < end && (isBlank(p[1]) || (p[1] == 'o' && p+2 < end && isBlank(p[2]))))
+    {
+      p += (p[1] == 'o') ? 3 : 2;
+      const int localVertexNumber = int(chunk.positions.size());
+      int faceSize = 0;
+
+      while(true)
+      {
+        p = skipBlanks(p, end);
+        int vertexIndex;
+        if(p == end || !parseInt(p, end, vertexIndex))
+          break;
+
+        //Skip the texture coordinate and normal indices ("v/vt/vn")
+        while(p < end && !isBlank(*p) && *p != '\n')
+          ++p;
+
+        if(vertexIndex > 0)
+        {
+          chunk.faceIndices.push_back(vertexIndex - 1);
+          ++faceSize;
+        }
+        else if(vertexIndex < 0)
+        {
+          chunk.relativeSlots.push_back(int(chunk.faceIndices.size()));
+          chunk.faceIndices.push_back(localVertexNumber + vertexIndex);
+          ++faceSize;
+        }
+      }
+
+      if(faceSize >= 3)
+      {
+        chunk.faceSizes.push_back(faceSize);
+      }
+      else
+      {
+        //Degenerated face, forget its indices
+        chunk.faceIndices.resize(chunk.faceIndices.size() - faceSize);
+        while(!chunk.relativeSlots.empty() && chunk.relativeSlots.back() >= int(chunk.faceIndices.size()))
+          chunk.relativeSlots.pop_back();
+      }
+    }
+
+    p = skipLine(p, end);
+  }
+}
+
+//Writes the whole buffer and empties it, false on a short write
+bool flushBuffer(QFile& file, QByteArray& buffer)
+{
+  const bool written = file.write(buffer) == buffer.size();
+  buffer.resize(0);
+  return written;
+}
+
+}
+
+bool ObjParser::parse(const QString& filePath, Mesh& mesh, int threadCount)
+{
+  QFile file(filePath);
+  if(!file.open(QIODevice::ReadOnly))
+    return false;
+
+  if(file.size() == 0)
+  {
+    mesh = Mesh();
+    return true;
+  }
+
+  uchar* data = file.map(0, file.size());
+  if(data != NULL)
+  {
+    bool ok = parse(reinterpret_cast<const char*>(data), file.size(), mesh, threadCount);
+    file.unmap(data);
+    return ok;
+  }
+
+  //Mapping is not available (e.g. special file systems), fall back to a single read
+  const QByteArray content = file.readAll();
+  return parse(content.constData(), content.size(), mesh, threadCount);
+}
+
+bool ObjParser::parse(const char* data, qint64 size, Mesh& mesh, int threadCount)
+{
+  if(threadCount <= 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  int chunkNumber = int(std::min<qint64>(threadCount, std::max<qint64>(1, size/OBJ_MIN_CHUNK_SIZE)));
+
+  //Line-aligned chunk boundaries
+  std::vector<const char*> boundaries;
+  boundaries.push_back(data);
+  for(int i = 1; i < chunkNumber; i++)
+  {
+    const char* boundary = std::max(data + size*i/chunkNumber, boundaries.back());
+    while(boundary < data + size && *(boundary-1) != '\n')
+      ++boundary;
+    boundaries.push_back(boundary);
+  }
+  boundaries.push_back(data + size);
+
+  std::vector<ObjChunk> chunks(chunkNumber);
+  std::vector<std::thread> threads;
+  for(int i = 1; i < chunkNumber; i++)
+  {
+    threads.push_back(std::thread(parseChunk, boundaries[i], boundaries[i+1], std::ref(chunks[i])));
+  }
+  parseChunk(boundaries[0], boundaries[1], chunks[0]);
+  for(size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i].join();
+  }
+
+  //A vertex that cannot be read would shift all the following indices
+  for(int i = 0; i < chunkNumber; i++)
+  {
+    if(chunks[i].malformedLine != NULL)
+    {
+      std::cerr << "ObjParser: malformed vertex at line " << std::count(data, chunks[i].malformedLine, '\n') + 1 << std::endl;
+      mesh = Mesh();
+      return false;
+    }
+  }
+
+  //Gather the chunks
+  int vertexNumber = 0;
+  int triangleNumber = 0;
+  mesh.boundsMin = Vector3( 1e9, 1e9, 1e9);
+  mesh.boundsMax = Vector3(-1e9,-1e9,-1e9);
+  for(int i = 0; i < chunkNumber; i++)
+  {
+    vertexNumber += int(chunks[i].positions.size());
+    for(size_t f = 0; f < chunks[i].faceSizes.size(); f++)
+      triangleNumber += chunks[i].faceSizes[f] - 2;
+
+    mesh.boundsMin = mesh.boundsMin.min(chunks[i].boundsMin);
+    mesh.boundsMax = mesh.boundsMax.max(chunks[i].boundsMax);
+  }
+
+  mesh.positions.resize(vertexNumber);
+  mesh.normals.resize(vertexNumber);
+  mesh.triangleIndices.resize(3*triangleNumber);
+  mesh.edgeIndices.resize(0);
+
+  std::fill(mesh.normals.begin(), mesh.normals.end(), Vector3());
+
+  //Single pass: resolve the indices, triangulate, collect the edges and accumulate the normals
+  int vertexOffset = 0;
+  int triangleIndex = 0;
+  bool indicesValid = true;
+  for(int i = 0; i < chunkNumber; i++)
+  {
+    ObjChunk& chunk = chunks[i];
+    std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + vertexOffset);
+
+    for(size_t s = 0; s < chunk.relativeSlots.size(); s++)
+      chunk.faceIndices[chunk.relativeSlots[s]] += vertexOffset;
+
+    size_t faceStart = 0;
+    for(size_t f = 0; f < chunk.faceSizes.size(); f++)
+    {
+      const int faceSize = chunk.faceSizes[f];
+      const int* face = &chunk.faceIndices[faceStart];
+      faceStart += faceSize;
+
+      bool faceValid = true;
+      for(int v = 0; v < faceSize; v++)
+      {
+        if(face[v] < 0 || face[v] >= vertexNumber)
+          faceValid = false;
+      }
+      if(!faceValid)
+      {
+        indicesValid = false;
+        continue;
+      }
+
+      for(int v = 0; v < faceSize; v++)
+      {
+        const int edgeA = face[v];
+        const int edgeB = face[(v + 1) % faceSize];
+        if(edgeA < edgeB)
+        {
+          mesh.edgeIndices.push_back(edgeA);
+          mesh.edgeIndices.push_back(edgeB);
+        }
+      }
+
+      for(int v = 1; v+1 < faceSize; v++)
+      {
+        const int a = face[0];
+        const int b = face[v];
+        const int c = face[v+1];
+        mesh.triangleIndices[3*triangleIndex + 0] = a;
+        mesh.triangleIndices[3*triangleIndex + 1] = b;
+        mesh.triangleIndices[3*triangleIndex + 2] = c;
+        triangleIndex++;
+
+        const Vector3& pa = mesh.positions[a];
+        const Vector3& pb = mesh.positions[b];
+        const Vector3& pc = mesh.positions[c];
+        Vector3 faceNormal = cross(pb - pa, pc - pa);
+        if(faceNormal.squaredNorm() > 0.0f)
+          faceNormal = faceNormal.normalize();//Every face counts the same, as Model always did
+        mesh.normals[a] += faceNormal;
+        mesh.normals[b] += faceNormal;
+        mesh.normals[c] += faceNormal;
+      }
+    }
+
+    vertexOffset += int(chunk.positions.size());
+  }
+
+  mesh.triangleIndices.resize(3*triangleIndex);
+
+  for(int i = 0; i < vertexNumber; i++)
+  {
+    if(mesh.normals[i].squaredNorm() > 0.0f)
+      mesh.normals[i] = mesh.normals[i].normalize();
+  }
+
+  return indicesValid;
+}
+
+bool ObjParser::write(const QString& filePath, const Mesh& mesh, const Vector3& scale)
+{
+  QFile file(filePath);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  const int FLUSH_SIZE = 32*1024*1024;
+  QByteArray buffer;
+  buffer.reserve(FLUSH_SIZE + 128);
+
+  bool written = true;
+  char line[128];
+  for(int i = 0; i < mesh.positions.size() && written; i++)
+  {
+    const Vector3& p = mesh.positions[i];
+    int length = snprintf(line, sizeof(line), "v %.9g %.9g %.9g\n", p[0]*scale[0], p[1]*scale[1], p[2]*scale[2]);
+    buffer.append(line, length);
+    if(buffer.size() > FLUSH_SIZE)
+      written = flushBuffer(file, buffer);
+  }
+
+  for(int i = 0; i < mesh.triangleNumber() && written; i++)
+  {
+    int length = snprintf(line, sizeof(line), "f %d %d %d\n", mesh.triangleIndices[3*i]+1, mesh.triangleIndices[3*i+1]+1, mesh.triangleIndices[3*i+2]+1);
+    buffer.append(line, length);
+    if(buffer.size() > FLUSH_SIZE)
+      written = flushBuffer(file, buffer);
+  }
+
+  //close() clears the error of an earlier write when it succeeds, so everything is checked before
+  written = written && flushBuffer(file, buffer) && file.flush();
+  const QString errorString = file.errorString();
+  file.close();
+  written = written && file.error() == QFile::NoError;
+
+  //A truncated mesh would be voxelized and cached as if it was complete
+  if(!written)
+  {
+    std::cerr << "ObjParser: unable to write " << qPrintable(filePath) << ": " << qPrintable(file.error() != QFile::NoError ? file.errorString() : errorString) << std::endl;
+    file.remove();
+    return false;
+  }
+  return true;
+}
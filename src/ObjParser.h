@@ -0,0 +1,35 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <QString>
+#include <QVector>
+
+#include "Vector3.h"
+
+//Memory-mapped Wavefront OBJ reader shared by Model and the mesh scaling pass.
+//Only positions ("v") and faces ("f", "fo") are read, polygons are triangulated as fans.
+//The file is split into line-aligned chunks that are parsed in parallel.
+class ObjParser
+{
+public:
+  struct Mesh
+  {
+    QVector<Vector3> positions;
+    QVector<Vector3> normals;//Per vertex, averaged from the incident faces
+    QVector<int> triangleIndices;//3 per triangle, 0-based
+    QVector<int> edgeIndices;//2 per edge, each polygon edge is stored once
+    Vector3 boundsMin;
+    Vector3 boundsMax;
+
+    inline int triangleNumber() const {return triangleIndices.size()/3;}
+  };
+
+  //threadCount <= 0 means one thread per core
+  static bool parse(const QString& filePath, Mesh& mesh, int threadCount = 0);
+  static bool parse(const char* data, qint64 size, Mesh& mesh, int threadCount = 0);
+
+  //Writes positions (optionally scaled per axis) and triangles, removes the file and returns false if any write fails
+  static bool write(const QString& filePath, const Mesh& mesh, const Vector3& scale = Vector3(1.0f, 1.0f, 1.0f));
+};
+
+#endif // OBJ_PARSER_H
@@ -0,0 +1,232 @@
+#include "PreviewRenderer.h"
+
+#include "LegoCloud.h"
+#include "LegoDimensions.h"
+#include "LegoMesher.h"
+
+#include <qmath.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+//The image is rendered this many times larger in each direction then filtered down
+#define PREVIEW_SUPERSAMPLING 2
+//Brick edges are darkened over this width, in final pixels
+#define PREVIEW_EDGE_WIDTH 0.75f
+#define PREVIEW_AMBIENT 0.35f
+//Closest eye, in bounding sphere radii
+#define PREVIEW_MIN_DISTANCE 1.05f
+
+namespace
+{
+
+struct Frame
+{
+  Vector3 eye;
+  Vector3 right;
+  Vector3 up;
+  Vector3 forward;
+  Vector3 light;
+  float focal;//Pixels at an eye space depth of 1
+  float centerX;
+  float centerY;
+};
+
+Frame cameraFrame(const LegoCloud& legoCloud, int width, int height, const PreviewRenderer::Camera& camera)
+{
+  const Vector3 boundsMax(legoCloud.getWidth()*LEGO_KNOB_DISTANCE, legoCloud.getLevelNumber()*LEGO_HEIGHT, legoCloud.getDepth()*LEGO_KNOB_DISTANCE);
+  const Vector3 center = boundsMax*0.5f;
+  const float radius = std::max(center.norm(), float(LEGO_KNOB_DISTANCE));
+
+  //The bounding sphere fits in the smallest field of view
+  const float halfFov = qDegreesToRadians(camera.fieldOfView)*0.5f;
+  const float halfFovMin = width < height ? atan(tan(halfFov)*width/height) : halfFov;
+  //The eye stays outside the bounding sphere, so that every corner is in front of it and no quad needs clipping
+  const float distance = std::max(radius/sin(halfFovMin)/std::max(camera.zoom, 0.01f), radius*PREVIEW_MIN_DISTANCE);
+
+  const float yaw = qDegreesToRadians(camera.yaw);
+  const float pitch = qDegreesToRadians(camera.pitch);
+  const Vector3 toEye(cos(pitch)*sin(yaw), sin(pitch), cos(pitch)*cos(yaw));
+
+  Frame frame;
+  frame.eye = center + toEye*distance;
+  frame.forward = toEye*-1.0f;
+  frame.right = cross(frame.forward, Vector3(0, 1, 0));
+  if(frame.right.norm() < 1e-6f)
+    frame.right = Vector3(1, 0, 0);//Straight from above or below
+  frame.right = frame.right.normalize();
+  frame.up = cross(frame.right, frame.forward);
+  frame.light = (frame.up*0.6f - frame.right*0.4f - frame.forward).normalize();
+  frame.focal = height*0.5f/tan(halfFov);
+  frame.centerX = width*0.5f;
+  frame.centerY = height*0.5f;
+  return frame;
+}
+
+//Z-buffered rasterization of convex planar quads
+class Rasterizer
+{
+public:
+  Rasterizer(QImage& image, const Frame& frame)
+    : image_(image), frame_(frame), inverseDepth_(size_t(image.width())*image.height(), 0.0f)
+  {
+  }
+
+  void drawQuad(const LegoMesher::Quad& quad, const Color3& color)
+  {
+    if(dot(quad.normal, frame_.eye - quad.corners[0]) <= 0.0f)
+      return;
+
+    float x[4], y[4], inverseZ[4];
+    for(int i = 0; i < 4; i++)
+    {
+      const Vector3 p = quad.corners[i] - frame_.eye;
+      const float z = dot(p, frame_.forward);
+      if(z < 1e-5f)
+        return;//Not clipped, the eye is kept out of the bounding sphere
+      inverseZ[i] = 1.0f/z;
+      x[i] = frame_.centerX + dot(p, frame_.right)*frame_.focal*inverseZ[i];
+      y[i] = frame_.centerY - dot(p, frame_.up)*frame_.focal*inverseZ[i];
+    }
+
+    //Edge functions normalized to pixel distances, positive inside
+    float area = 0.0f;
+    for(int i = 0; i < 4; i++)
+      area += x[i]*y[(i+1)%4] - x[(i+1)%4]*y[i];
+    if(fabs(area) < 1e-6f)
+      return;
+    float edgeA[4], edgeB[4], edgeC[4];
+    for(int i = 0; i < 4; i++)
+    {
+      const int j = (i+1)%4;
+      const float dx = x[j] - x[i];
+      const float dy = y[j] - y[i];
+      const float length = sqrt(dx*dx + dy*dy);
+      const float sign = (area > 0.0f ? 1.0f : -1.0f)/std::max(length, 1e-6f);
+      edgeA[i] = -dy*sign;
+      edgeB[i] = dx*sign;
+      edgeC[i] = (dy*x[i] - dx*y[i])*sign;
+    }
+
+    //Only the sides on the border of the brick face are darkened, not the seams between the quads of a partly hidden face
+    bool brickEdge[4];
+    for(int i = 0; i < 4; i++)
+    {
+      const float* from = quad.faceCoords[i];
+      const float* to = quad.faceCoords[(i+1)%4];
+      brickEdge[i] = false;
+      for(int c = 0; c < 2; c++)
+        brickEdge[i] = brickEdge[i] || (from[c] == to[c] && (from[c] == 0.0f || from[c] == 1.0f));
+    }
+
+    //1/z is affine in screen space on a plane, from the corners 0, 1, 2 (or 0, 2, 3 when the first ones are aligned)
+    int c1 = 1, c2 = 2;
+    float det = (x[1]-x[0])*(y[2]-y[0]) - (x[2]-x[0])*(y[1]-y[0]);
+    if(fabs(det) < 1e-6f)
+    {
+      c1 = 2;
+      c2 = 3;
+      det = (x[2]-x[0])*(y[3]-y[0]) - (x[3]-x[0])*(y[2]-y[0]);
+      if(fabs(det) < 1e-6f)
+        return;
+    }
+    const float depthA = ((inverseZ[c1]-inverseZ[0])*(y[c2]-y[0]) - (inverseZ[c2]-inverseZ[0])*(y[c1]-y[0]))/det;
+    const float depthB = ((x[c1]-x[0])*(inverseZ[c2]-inverseZ[0]) - (x[c2]-x[0])*(inverseZ[c1]-inverseZ[0]))/det;
+    const float depthC = inverseZ[0] - depthA*x[0] - depthB*y[0];
+
+    const float shade = PREVIEW_AMBIENT + (1.0f - PREVIEW_AMBIENT)*std::max(dot(quad.normal, frame_.light), 0.0f);
+    const QRgb faceColor = qRgb(std::min(int(color[0]*shade*255), 255), std::min(int(color[1]*shade*255), 255), std::min(int(color[2]*shade*255), 255));
+    const QRgb edgeColor = qRgb(qRed(faceColor)*0.35f, qGreen(faceColor)*0.35f, qBlue(faceColor)*0.35f);
+    const float edgeWidth = PREVIEW_EDGE_WIDTH*PREVIEW_SUPERSAMPLING;
+
+    const int minX = std::max(int(floor(*std::min_element(x, x+4))), 0);
+    const int maxX = std::min(int(ceil(*std::max_element(x, x+4))), image_.width()-1);
+    const int minY = std::max(int(floor(*std::min_element(y, y+4))), 0);
+    const int maxY = std::min(int(ceil(*std::max_element(y, y+4))), image_.height()-1);
+    for(int py = minY; py <= maxY; py++)
+    {
+      QRgb* line = reinterpret_cast<QRgb*>(image_.scanLine(py));
+      float* depthLine = &inverseDepth_[size_t(py)*image_.width()];
+      const float sampleY = py + 0.5f;
+      for(int px = minX; px <= maxX; px++)
+      {
+        const float sampleX = px + 0.5f;
+        float edgeDistance = FLT_MAX;
+        bool inside = true;
+        for(int i = 0; i < 4 && inside; i++)
+        {
+          const float distance = edgeA[i]*sampleX + edgeB[i]*sampleY + edgeC[i];
+          inside = distance >= 0.0f;
+          if(brickEdge[i])
+            edgeDistance = std::min(edgeDistance, distance);
+        }
+        if(!inside)
+          continue;
+
+        const float depth = depthA*sampleX + depthB*sampleY + depthC;
+        if(depth <= depthLine[px])
+          continue;
+        depthLine[px] = depth;
+        line[px] = edgeDistance < edgeWidth ? edgeColor : faceColor;
+      }
+    }
+  }
+
+private:
+  QImage& image_;
+  const Frame& frame_;
+  std::vector<float> inverseDepth_;//0 is infinitely far
+};
+
+}
+
+PreviewRenderer::PreviewRenderer(const LegoCloud& legoCloud)
+  : legoCloud_(legoCloud)
+{
+}
+
+QImage PreviewRenderer::render(int width, int height, const Camera& camera) const
+{
+  if(width <= 0 || height <= 0)
+    return QImage();
+
+  QImage image(width*PREVIEW_SUPERSAMPLING, height*PREVIEW_SUPERSAMPLING, QImage::Format_ARGB32);
+  image.fill(0);
+
+  const Frame frame = cameraFrame(legoCloud_, image.width(), image.height(), camera);
+  Rasterizer rasterizer(image, frame);
+
+  //Faces against other bricks are never visible
+  const LegoOccupancy occupancy(legoCloud_);
+  const QVector<Color3>& legalColors = legoCloud_.getLegalColor();
+  std::vector<LegoMesher::Quad> quads;
+  for(int level = 0; level < legoCloud_.getLevelNumber(); level++)
+  {
+    const LegoBrickList& bricks = legoCloud_.getBricks(level);
+    for(LegoBrickList::const_iterator brick = bricks.constBegin(); brick != bricks.constEnd(); brick++)
+    {
+      quads.clear();
+      LegoMesher::brickFaces(*brick, &occupancy, quads);
+      const Color3& color = legalColors[brick->getColorId()];
+      for(size_t i = 0; i < quads.size(); i++)
+      {
+        rasterizer.drawQuad(quads[i], color);
+      }
+    }
+  }
+
+  return image.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+bool PreviewRenderer::save(const QString& filePath, int width, int height, const Camera& camera) const
+{
+  const QImage image = render(width, height, camera);
+  if(image.isNull() || !image.save(filePath))
+  {
+    std::cerr << "Unable to save: " << qPrintable(filePath) << std::endl;
+    return false;
+  }
+  return true;
+}
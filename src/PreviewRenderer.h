@@ -0,0 +1,38 @@
+#ifndef PREVIEW_RENDERER_H
+#define PREVIEW_RENDERER_H
+
+#include <QImage>
+#include <QString>
+
+class LegoCloud;
+
+//Shaded view of the bricks rasterized on the CPU into a QImage: no window, GL context nor display server needed.
+//Takes the cloud of a LegoCloudNode (getLegoCloud) so that batch jobs can render thumbnails of many models in parallel.
+//Visible brick faces are drawn with a z-buffer and Lambert shading in the real colors; knobs are left out.
+class PreviewRenderer
+{
+public:
+  //Orbit around the center of the bricks, at the distance where the whole model fits in the view
+  struct Camera
+  {
+    Camera() : yaw(-35.0f), pitch(30.0f), fieldOfView(40.0f), zoom(1.0f) {}
+
+    float yaw;//Degrees around the vertical axis, 0 looks along -z
+    float pitch;//Degrees above the horizontal plane
+    float fieldOfView;//Vertical, in degrees
+    float zoom;//Above 1 moves the camera closer, up to just outside the bounding sphere (about 2.8 at 40 degrees)
+  };
+
+  explicit PreviewRenderer(const LegoCloud& legoCloud);
+
+  //Transparent background. Thread safe, as long as the cloud is not modified
+  QImage render(int width, int height, const Camera& camera = Camera()) const;
+
+  //The format follows the suffix
+  bool save(const QString& filePath, int width, int height, const Camera& camera = Camera()) const;
+
+private:
+  const LegoCloud& legoCloud_;
+};
+
+#endif // PREVIEW_RENDERER_H
@@ -0,0 +1,59 @@
+#include "ProcessStats.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+qint64 ProcessStats::currentResidentBytes()
+{
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return -1;
+  return counters.WorkingSetSize;
+#elif defined(Q_OS_MAC)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+    return -1;
+  return info.resident_size;
+#else
+  //Second field of statm, in pages
+  FILE* file = fopen("/proc/self/statm", "r");
+  if(!file)
+    return -1;
+  long pages = -1;
+  const int read = fscanf(file, "%*s %ld", &pages);
+  fclose(file);
+  if(read != 1 || pages < 0)
+    return -1;
+  return qint64(pages)*sysconf(_SC_PAGESIZE);
+#endif
+}
+
+qint64 ProcessStats::peakResidentBytes()
+{
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return -1;
+  return counters.PeakWorkingSetSize;
+#else
+  rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#if defined(Q_OS_MAC)
+  return usage.ru_maxrss;//Bytes on macOS
+#else
+  return qint64(usage.ru_maxrss)*1024;//Kilobytes on Linux
+#endif
+#endif
+}
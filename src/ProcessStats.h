@@ -0,0 +1,17 @@
+#ifndef PROCESS_STATS_H
+#define PROCESS_STATS_H
+
+#include <QtGlobal>
+
+//Memory used by the running process, as reported by the system.
+class ProcessStats
+{
+public:
+  //Resident set size in bytes, -1 if it cannot be read on this platform
+  static qint64 currentResidentBytes();
+
+  //Highest resident set size since the process started, -1 if it cannot be read on this platform
+  static qint64 peakResidentBytes();
+};
+
+#endif // PROCESS_STATS_H
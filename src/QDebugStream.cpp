@@ -0,0 +1,128 @@
+#include "QDebugStream.h"
+
+#include <QScrollBar>
+
+namespace
+{
+
+//Shared by the streams of a thread, std::cout and std::cerr lines stay in order
+std::string& pendingText()
+{
+  thread_local std::string text;
+  return text;
+}
+
+//Length of the longest prefix of text that does not end inside a UTF-8 sequence
+size_t utf8Boundary(const char* text, size_t length)
+{
+  size_t start = length;//Start of the last sequence
+  while(start > 0 && length - start < 4 && (uchar(text[start-1]) & 0xC0) == 0x80)
+    start--;
+  if(start == 0)
+    return length;
+  start--;
+
+  const uchar lead = uchar(text[start]);
+  size_t sequenceLength = 1;
+  if((lead & 0xE0) == 0xC0)
+    sequenceLength = 2;
+  else if((lead & 0xF0) == 0xE0)
+    sequenceLength = 3;
+  else if((lead & 0xF8) == 0xF0)
+    sequenceLength = 4;
+  return length - start < sequenceLength ? start : length;
+}
+
+}
+
+QDebugStream::int_type QDebugStream::overflow(int_type c)
+{
+  if(!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    const char character = traits_type::to_char_type(c);
+    write(&character, 1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize QDebugStream::xsputn(const char *p, std::streamsize n)
+{
+  write(p, n);
+  return n;
+}
+
+int QDebugStream::sync()
+{
+  std::string& pending = pendingText();
+  if(!pending.empty())
+  {
+    buffer_->push(pending.data(), pending.size());
+    pending.clear();
+  }
+  return 0;
+}
+
+void QDebugStream::write(const char *p, size_t n)
+{
+  std::string& pending = pendingText();
+  pending.append(p, n);
+
+  //Queue the complete lines as one message, or the whole characters once a line gets too long
+  size_t end;
+  if(pending.size() < MAXIMUM_MESSAGE_SIZE)
+  {
+    const size_t lastNewLine = pending.rfind('\n');
+    if(lastNewLine == std::string::npos)
+      return;
+    end = lastNewLine + 1;
+  }
+  else
+  {
+    end = utf8Boundary(pending.data(), pending.size());
+  }
+  buffer_->push(pending.data(), end);
+  pending.erase(0, end);
+}
+
+ConsoleSink::ConsoleSink(QTextEdit* textEdit, int maximumLines, int interval)
+  : textEdit_(textEdit), reportedDroppedMessages_(0)
+{
+  textEdit_->document()->setMaximumBlockCount(maximumLines);
+  connect(&timer_, SIGNAL(timeout()), this, SLOT(drain()));
+  timer_.start(interval);
+}
+
+void ConsoleSink::drain()
+{
+  QByteArray batch = incompleteText_;
+  buffer_.drain(batch, MAXIMUM_BATCH_BYTES);
+
+  //The batch limit or a message still being written can cut a character, its start waits for the next batch
+  const int complete = int(utf8Boundary(batch.constData(), batch.size()));
+  incompleteText_ = batch.mid(complete);
+  batch.truncate(complete);
+
+  const qint64 droppedMessages = buffer_.getDroppedMessages();
+  if(droppedMessages > reportedDroppedMessages_)
+  {
+    if(!batch.isEmpty() && !batch.endsWith('\n'))
+      batch += '\n';
+    batch += "[" + QByteArray::number(droppedMessages - reportedDroppedMessages_) + " console messages dropped, "
+        + QByteArray::number(buffer_.getDroppedMessages()) + " since the start]\n";
+    reportedDroppedMessages_ = droppedMessages;
+  }
+
+  if(batch.isEmpty())
+    return;
+
+  //Only follow the output if the user did not scroll up
+  QScrollBar* scrollBar = textEdit_->verticalScrollBar();
+  const bool atBottom = scrollBar->value() == scrollBar->maximum();
+
+  QTextCursor cursor(textEdit_->document());
+  cursor.movePosition(QTextCursor::End);
+  cursor.insertText(QString::fromUtf8(batch));
+
+  if(atBottom)
+    scrollBar->setValue(scrollBar->maximum());
+}
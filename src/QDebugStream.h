@@ -5,9 +5,11 @@
 #include <streambuf>
 #include <string>
 
-#include <QFileInfo>
-
+#include <QObject>
 #include <QTextEdit>
+#include <QTimer>
+
+#include "LogRingBuffer.h"
 
 // to be able to tee (duplicate) streams
 
@@ -56,55 +58,55 @@ private:
     std::streambuf * sb2_;
 };
 
+//Unbuffered stream that queues its text in the ring buffer of a ConsoleSink.
+//The text is kept per thread until a new line or a flush and queued as one message, so the lines of different threads are not mixed.
+//Every stream of a console must write to the same ring buffer.
 class QDebugStream : public std::streambuf
 {
 public:
-  QDebugStream(QTextEdit* text_edit)
+  explicit QDebugStream(LogRingBuffer* buffer)
+    : buffer_(buffer)
   {
-    log_window = text_edit;
   }
 
-
 protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *p, std::streamsize n);
+  virtual int sync();
 
-  //This is called when a std::endl has been inserted into the stream
-  virtual int_type overflow(int_type c)
-  {
-//    if (c == '\n')
-//    {
-//      log_window->insertPlainText("");
-//    }
-//    else
-//    {
-      QString str; str.append(c);
-      log_window->moveCursor (QTextCursor::End);
-      log_window->insertPlainText(str);
-//    }
-    return c;
-  }
+private:
+  static const size_t MAXIMUM_MESSAGE_SIZE = 16*LogRingBuffer::SLOT_SIZE;//A longer line is queued in several messages
 
-  virtual std::streamsize xsputn(const char *p, std::streamsize n)
-  {
-    QString str = QString::fromUtf8(p, n);
-    if(str.contains("\n")){
-      QStringList strSplitted = str.split("\n");
-
-      log_window->moveCursor (QTextCursor::End);
-      log_window->insertPlainText(strSplitted.at(0)); //Index 0 is still on the same old line
-
-      for(int i = 1; i < strSplitted.size(); i++){
-        log_window->insertPlainText(strSplitted.at(i));
-      }
-    }else{
-      log_window->moveCursor (QTextCursor::End);
-      log_window->insertPlainText(str);
-    }
-    return n;
-  }
+  void write(const char *p, size_t n);
 
+  LogRingBuffer* buffer_;
+};
+
+//Appends the queued text to a console widget in batches, on a timer of the GUI thread.
+//The console keeps the last maximumLines lines; messages dropped because the ring buffer was full are reported in it.
+class ConsoleSink : public QObject
+{
+  Q_OBJECT
+
+public:
+  static const int DEFAULT_MAXIMUM_LINES = 5000;
+  static const int DEFAULT_INTERVAL = 50;//ms
+
+  ConsoleSink(QTextEdit* textEdit, int maximumLines = DEFAULT_MAXIMUM_LINES, int interval = DEFAULT_INTERVAL);
+
+  inline LogRingBuffer* getBuffer() {return &buffer_;}
+
+public slots:
+  void drain();
 
 private:
-  QTextEdit* log_window;
+  static const int MAXIMUM_BATCH_BYTES = 256*1024;//Per timer tick, the rest waits for the next one
+
+  QTextEdit* textEdit_;
+  LogRingBuffer buffer_;
+  QTimer timer_;
+  qint64 reportedDroppedMessages_;
+  QByteArray incompleteText_;//Start of a UTF-8 character cut at the end of the last batch
 };
 
 #endif // QDEBUGSTREAM_H
@@ -0,0 +1,206 @@
+#include "Trace.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+struct Event
+{
+  const char* name;
+  qint64 start;
+  qint64 duration;
+  int argNumber;
+  const char* argKeys[Trace::MAX_ARGS];
+  qint64 argValues[Trace::MAX_ARGS];
+};
+
+//Each thread appends to its own buffer, the lock is only contended while stop collects the events
+struct ThreadBuffer
+{
+  int threadId;
+  std::mutex mutex;
+  std::vector<Event> events;
+};
+
+//origin is written by start before recording is released, and read by the spans after acquiring it
+std::atomic<bool> recording(false);
+std::chrono::steady_clock::time_point origin;
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer> > threadBuffers;//Kept after their thread exits, until the next start
+QString traceFilePath;
+
+ThreadBuffer& threadBuffer()
+{
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if(!buffer)
+  {
+    buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->threadId = threadBuffers.size() + 1;
+    threadBuffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+qint64 now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void appendString(QByteArray& json, const char* text)
+{
+  json += '"';
+  for(const char* c = text; *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+      json += '\\';
+    json += *c;
+  }
+  json += '"';
+}
+
+}
+
+bool Trace::start(const QString& filePath)
+{
+#ifdef BRICKR_TRACING
+  std::lock_guard<std::mutex> lock(registryMutex);
+  if(recording.load(std::memory_order_acquire))
+  {
+    //Moving the origin would shift the open spans
+    std::cerr << "Already tracing to " << qPrintable(traceFilePath) << ", stop first" << std::endl;
+    return false;
+  }
+  for(size_t i = 0; i < threadBuffers.size(); i++)
+  {
+    std::lock_guard<std::mutex> bufferLock(threadBuffers[i]->mutex);
+    threadBuffers[i]->events.clear();
+  }
+  traceFilePath = filePath;
+  origin = std::chrono::steady_clock::now();
+  recording.store(true, std::memory_order_release);
+  std::cout << "Tracing to " << qPrintable(filePath) << std::endl;
+  return true;
+#else
+  Q_UNUSED(filePath);
+  std::cerr << "Tracing is not compiled in, build with CONFIG+=tracing" << std::endl;
+  return false;
+#endif
+}
+
+bool Trace::stop()
+{
+  if(!recording.exchange(false))
+    return false;
+
+  QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+  size_t eventNumber = 0;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for(size_t i = 0; i < threadBuffers.size(); i++)
+    {
+      std::vector<Event> events;
+      {
+        std::lock_guard<std::mutex> bufferLock(threadBuffers[i]->mutex);
+        events.swap(threadBuffers[i]->events);
+      }
+
+      for(size_t e = 0; e < events.size(); e++)
+      {
+        const Event& event = events[e];
+        json += first ? "\n{\"name\":" : ",\n{\"name\":";
+        first = false;
+        appendString(json, event.name);
+        json += ",\"cat\":\"brickr\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(threadBuffers[i]->threadId);
+        json += ",\"ts\":" + QByteArray::number(event.start) + ",\"dur\":" + QByteArray::number(event.duration);
+        if(event.argNumber > 0)
+        {
+          json += ",\"args\":{";
+          for(int a = 0; a < event.argNumber; a++)
+          {
+            if(a > 0)
+              json += ',';
+            appendString(json, event.argKeys[a]);
+            json += ':' + QByteArray::number(event.argValues[a]);
+          }
+          json += '}';
+        }
+        json += '}';
+      }
+      eventNumber += events.size();
+    }
+  }
+  json += "\n]}\n";
+
+  QFile file(traceFilePath);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+  {
+    std::cerr << "Unable to write the trace: " << qPrintable(traceFilePath) << std::endl;
+    return false;
+  }
+  std::cout << "Trace written: " << eventNumber << " spans in " << qPrintable(traceFilePath) << std::endl;
+  return true;
+}
+
+bool Trace::isRecording()
+{
+  return recording.load(std::memory_order_acquire);
+}
+
+Trace::Span::Span(const char* name)
+  : name_(name), start_(-1), argNumber_(0)
+{
+  if(recording.load(std::memory_order_acquire))
+    start_ = now();
+}
+
+Trace::Span::~Span()
+{
+  end();
+}
+
+void Trace::Span::addArg(const char* key, qint64 value)
+{
+  if(start_ < 0 || argNumber_ == MAX_ARGS)
+    return;
+  argKeys_[argNumber_] = key;
+  argValues_[argNumber_] = value;
+  argNumber_++;
+}
+
+void Trace::Span::end()
+{
+  if(start_ < 0)
+    return;
+
+  //Spans that end after stop are dropped
+  if(!recording.load(std::memory_order_acquire))
+  {
+    start_ = -1;
+    return;
+  }
+
+  Event event;
+  event.name = name_;
+  event.start = start_;
+  event.duration = now() - start_;
+  event.argNumber = argNumber_;
+  std::copy(argKeys_, argKeys_ + argNumber_, event.argKeys);
+  std::copy(argValues_, argValues_ + argNumber_, event.argValues);
+  start_ = -1;
+
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events.push_back(event);
+}
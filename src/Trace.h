@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+
+//Scoped timing spans written as Chrome trace events (chrome://tracing or ui.perfetto.dev).
+//The spans are compiled only with BRICKR_TRACING (qmake CONFIG+=tracing), otherwise the macros expand to nothing
+//and their arguments are not evaluated. Once compiled, spans are only recorded between Trace::start and Trace::stop.
+//
+//  void LegoCloud::merge()
+//  {
+//    BRICKR_TRACE_SCOPE("LegoCloud::merge");
+//    ...
+//    BRICKR_TRACE_ARG("bricks", getBrickNumber());//Arguments can be added until the end of the scope
+//  }
+//
+//BRICKR_TRACE_BEGIN(span, name) and BRICKR_TRACE_END(span) time a part of a scope.
+//Names and argument keys must be string literals: only the pointers are kept.
+class Trace
+{
+public:
+  static const int MAX_ARGS = 4;
+
+  //Clears the previous spans. False when tracing is not compiled in or already recording (stop first)
+  static bool start(const QString& filePath);
+  //Writes the spans recorded since start; the traced work must be finished in every thread
+  static bool stop();
+  static bool isRecording();
+
+  class Span
+  {
+  public:
+    explicit Span(const char* name);
+    ~Span();
+
+    void addArg(const char* key, qint64 value);//Beyond MAX_ARGS, the arguments are dropped
+    void end();
+
+  private:
+    Span(const Span&);
+    Span& operator=(const Span&);
+
+    const char* name_;
+    qint64 start_;//Microseconds since Trace::start, -1 when not recorded
+    int argNumber_;
+    const char* argKeys_[MAX_ARGS];
+    qint64 argValues_[MAX_ARGS];
+  };
+};
+
+#ifdef BRICKR_TRACING
+#define BRICKR_TRACE_SCOPE(name) Trace::Span brickrTraceSpan(name)
+#define BRICKR_TRACE_ARG(key, value) brickrTraceSpan.addArg(key, value)
+#define BRICKR_TRACE_BEGIN(span, name) Trace::Span span(name)
+#define BRICKR_TRACE_END(span) span.end()
+#else
+#define BRICKR_TRACE_SCOPE(name) do {} while(0)
+#define BRICKR_TRACE_ARG(key, value) do {} while(0)
+#define BRICKR_TRACE_BEGIN(span, name) do {} while(0)
+#define BRICKR_TRACE_END(span) do {} while(0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,211 @@
+#include "VoxelCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMultiMap>
+#include <QSettings>
+#include <QStringList>
+
+#include <iostream>
+
+#define VOXEL_CACHE_MAGIC 0x42564358 //"BVCX"
+#define VOXEL_CACHE_VERSION 1
+
+VoxelCache::VoxelCache(const QString& cacheDir, qint64 maxBytes)
+  : cacheDir_(cacheDir), maxBytes_(maxBytes)
+{
+  QDir().mkpath(cacheDir_);
+}
+
+QString VoxelCache::defaultCacheDir()
+{
+  return QDir::tempPath() + "/brickr-voxel-cache";
+}
+
+QByteArray VoxelCache::computeKey(const QString& meshFilePath, int resolution, const QString& voxelizerSettings) const
+{
+  QFile meshFile(meshFilePath);
+  if(!meshFile.open(QIODevice::ReadOnly))
+    return QByteArray();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  //Hash the mesh without copying it when it can be mapped
+  uchar* data = meshFile.map(0, meshFile.size());
+  if(data != NULL)
+  {
+    hash.addData(reinterpret_cast<const char*>(data), meshFile.size());
+    meshFile.unmap(data);
+  }
+  else
+  {
+    hash.addData(meshFile.readAll());
+  }
+  meshFile.close();
+
+  hash.addData(QByteArray::number(VOXEL_CACHE_VERSION));
+  hash.addData(QByteArray::number(resolution));
+  hash.addData(voxelizerSettings.toUtf8());
+
+  return hash.result().toHex();
+}
+
+bool VoxelCache::fetch(const QByteArray& key, const QString& binvoxFilePath)
+{
+  if(key.isEmpty())
+    return false;
+
+  QFile entryFile(entryFilePath(key));
+  if(!entryFile.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&entryFile);
+  quint32 magic, version;
+  QByteArray occupancy, colors;
+  in >> magic >> version >> occupancy >> colors;
+  entryFile.close();
+
+  if(in.status() != QDataStream::Ok || magic != VOXEL_CACHE_MAGIC || version != VOXEL_CACHE_VERSION)
+  {
+    std::cerr << "Voxel cache: ignoring corrupted entry " << key.constData() << std::endl;
+    QFile::remove(entryFilePath(key));
+    return false;
+  }
+
+  //qUncompress returns an empty array on corrupted data
+  const QByteArray binvoxData = qUncompress(occupancy);
+  const QByteArray colorData = colors.isEmpty() ? QByteArray() : qUncompress(colors);
+  if(binvoxData.isEmpty() || (!colors.isEmpty() && colorData.isEmpty()))
+  {
+    std::cerr << "Voxel cache: ignoring corrupted entry " << key.constData() << std::endl;
+    QFile::remove(entryFilePath(key));
+    return false;
+  }
+
+  QFile binvoxFile(binvoxFilePath);
+  QFile colorFile(binvoxFilePath + ".color");
+  bool written = binvoxFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+      && binvoxFile.write(binvoxData) == binvoxData.size() && binvoxFile.flush();
+  binvoxFile.close();
+
+  if(written && !colorData.isEmpty())
+  {
+    written = colorFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        && colorFile.write(colorData) == colorData.size() && colorFile.flush();
+    colorFile.close();
+  }
+  else if(colorFile.exists())
+  {
+    colorFile.remove();//A stale sidecar would recolor the cached voxels
+  }
+
+  if(!written)
+  {
+    //Leave nothing half written: the caller voxelizes again
+    std::cerr << "Voxel cache: unable to write " << qPrintable(binvoxFilePath) << std::endl;
+    binvoxFile.remove();
+    colorFile.remove();
+    QFile::remove(entryFilePath(key));
+    return false;
+  }
+
+  touch(key);
+  return true;
+}
+
+bool VoxelCache::store(const QByteArray& key, const QString& binvoxFilePath, const QString& colorFilePath)
+{
+  if(key.isEmpty())
+    return false;
+
+  QFile binvoxFile(binvoxFilePath);
+  if(!binvoxFile.open(QIODevice::ReadOnly))
+    return false;
+  QByteArray occupancy = qCompress(binvoxFile.readAll());
+  binvoxFile.close();
+
+  QByteArray colors;
+  if(!colorFilePath.isEmpty())
+  {
+    QFile colorFile(colorFilePath);
+    if(!colorFile.open(QIODevice::ReadOnly))
+      return false;
+    colors = qCompress(colorFile.readAll());
+    colorFile.close();
+  }
+
+  //Write to a temporary file first so that a concurrent fetch never sees a partial entry
+  const QString finalPath = entryFilePath(key);
+  const QString tempPath = finalPath + ".tmp";
+  QFile entryFile(tempPath);
+  if(!entryFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  QDataStream out(&entryFile);
+  out << quint32(VOXEL_CACHE_MAGIC) << quint32(VOXEL_CACHE_VERSION) << occupancy << colors;
+  entryFile.close();
+
+  QFile::remove(finalPath);
+  if(!QFile::rename(tempPath, finalPath))
+    return false;
+
+  touch(key);
+  evict();
+  return true;
+}
+
+QString VoxelCache::entryFilePath(const QByteArray& key) const
+{
+  return cacheDir_ + "/" + QString::fromLatin1(key) + ".bvc";
+}
+
+QString VoxelCache::indexFilePath() const
+{
+  return cacheDir_ + "/index.ini";
+}
+
+void VoxelCache::touch(const QByteArray& key)
+{
+  QSettings index(indexFilePath(), QSettings::IniFormat);
+  index.setValue("lastAccess/" + QString::fromLatin1(key), QDateTime::currentDateTime().toMSecsSinceEpoch());
+}
+
+void VoxelCache::evict()
+{
+  QSettings index(indexFilePath(), QSettings::IniFormat);
+  index.beginGroup("lastAccess");
+
+  QMultiMap<qint64, QString> entriesByAccess;
+  qint64 totalBytes = 0;
+
+  foreach(const QString& key, index.childKeys())
+  {
+    QFileInfo entryInfo(entryFilePath(key.toLatin1()));
+    if(!entryInfo.exists())
+    {
+      index.remove(key);
+      continue;
+    }
+
+    entriesByAccess.insert(index.value(key).toLongLong(), key);
+    totalBytes += entryInfo.size();
+  }
+
+  //Oldest entries come first in the map
+  QMultiMap<qint64, QString>::const_iterator entryIt = entriesByAccess.constBegin();
+  while(totalBytes > maxBytes_ && entryIt != entriesByAccess.constEnd())
+  {
+    QFile entryFile(entryFilePath(entryIt.value().toLatin1()));
+    totalBytes -= entryFile.size();
+    entryFile.remove();
+    index.remove(entryIt.value());
+    std::cout << "Voxel cache: evicted " << qPrintable(entryIt.value()) << std::endl;
+    ++entryIt;
+  }
+
+  index.endGroup();
+}
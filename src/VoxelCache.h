@@ -0,0 +1,43 @@
+#ifndef VOXEL_CACHE_H
+#define VOXEL_CACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+//Content-addressed cache of binvox voxelizations.
+//An entry is keyed by a hash of the mesh bytes, the resolution and the voxelizer settings;
+//it stores the compressed occupancy (binvox) and the optional .color sidecar.
+//The cache directory is bounded in size, the least recently used entries are evicted first.
+class VoxelCache
+{
+public:
+  static const qint64 DEFAULT_MAX_BYTES = 512*1024*1024;
+
+  explicit VoxelCache(const QString& cacheDir = defaultCacheDir(), qint64 maxBytes = DEFAULT_MAX_BYTES);
+
+  static QString defaultCacheDir();
+
+  //Returns an empty key if the mesh could not be read
+  QByteArray computeKey(const QString& meshFilePath, int resolution, const QString& voxelizerSettings) const;
+
+  //On a hit, writes the cached voxelization to binvoxFilePath (and binvoxFilePath.color if there is one).
+  //A corrupted entry or a failed write removes the entry and returns false
+  bool fetch(const QByteArray& key, const QString& binvoxFilePath);
+  //colorFilePath is the sidecar produced with this voxelization, if any: a .color file that is merely
+  //next to binvoxFilePath may come from another model
+  bool store(const QByteArray& key, const QString& binvoxFilePath, const QString& colorFilePath = QString());
+
+  inline const QString& getCacheDir() const {return cacheDir_;}
+  inline qint64 getMaxBytes() const {return maxBytes_;}
+
+private:
+  QString entryFilePath(const QByteArray& key) const;
+  QString indexFilePath() const;
+  void touch(const QByteArray& key);
+  void evict();
+
+  QString cacheDir_;
+  qint64 maxBytes_;
+};
+
+#endif // VOXEL_CACHE_H
@@ -0,0 +1,178 @@
+#include "Voxelizer.h"
+
+#include "ObjParser.h"
+#include "VoxelCache.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSettings>
+
+#include <iostream>
+
+#define MESH_VERTICAL_SCALE 0.83333333//Voxels are scaled to the brick proportions before voxelization
+
+#ifdef WIN32
+#define BINVOX_OPTIONS ""
+#else
+#define BINVOX_OPTIONS " -pb"
+#endif
+
+Voxelizer::Voxelizer(const QString& binvoxProgram)
+  : binvoxProgram_(binvoxProgram)
+{
+}
+
+Voxelizer::~Voxelizer()
+{
+}
+
+bool Voxelizer::isMeshExtensionSupported(const QString& extension)
+{
+  return extension.compare("obj", Qt::CaseInsensitive) == 0;// ||
+//      extension.compare("off", Qt::CaseInsensitive) == 0 ||
+//      extension.compare("stl", Qt::CaseInsensitive) == 0 ||
+//      extension.compare("ply", Qt::CaseInsensitive) == 0 ||
+//      extension.compare("dxf", Qt::CaseInsensitive) == 0;
+}
+
+QString Voxelizer::settings()
+{
+  return QString("binvox%1;yscale=%2").arg(BINVOX_OPTIONS).arg(MESH_VERTICAL_SCALE, 0, 'g', 10);
+}
+
+QString Voxelizer::binvoxFilePath(const QString& meshFilePath, int resolution)
+{
+  const QFileInfo meshFileInfo(meshFilePath);
+  return meshFileInfo.absolutePath() + "/" + meshFileInfo.baseName() + QString::number(resolution) + ".binvox";
+}
+
+bool Voxelizer::voxelize(const QString& meshFilePath, int resolution, const QString& binvoxFilePath, VoxelCache* cache)
+{
+  if(resolution <= 0)
+  {
+    std::cerr << "The voxelization resolution must be positive" << std::endl;
+    return false;
+  }
+
+  QFile binvoxFile(binvoxFilePath);
+  if(binvoxFile.exists())
+  {
+    //We make sure that binvoxFilePath does not exist
+    std::cout << "Removing file: " << qPrintable(binvoxFilePath) << std::endl;
+    binvoxFile.remove();
+  }
+
+  //The same mesh voxelized at the same resolution with the same settings is taken from the cache
+  QByteArray cacheKey;
+  if(cache)
+  {
+    cacheKey = cache->computeKey(meshFilePath, resolution, settings());
+    if(!cacheKey.isEmpty() && cache->fetch(cacheKey, binvoxFilePath))
+    {
+      std::cout << "Voxelization found in cache (" << cacheKey.constData() << ")" << std::endl;
+      return true;
+    }
+  }
+
+  const QString binvoxProgram = locateBinvoxProgram();
+  if(binvoxProgram.isEmpty())
+  {
+    std::cerr << "The binvox executable was not found." << std::endl;
+    return false;
+  }
+
+  if(!runBinvox(binvoxProgram, meshFilePath, resolution, binvoxFilePath))
+    return false;
+
+  //binvox does not produce colors: a .color file next to the output is not part of this voxelization
+  if(cache && !cacheKey.isEmpty())
+    cache->store(cacheKey, binvoxFilePath);
+
+  return true;
+}
+
+QString Voxelizer::locateBinvoxProgram()
+{
+  if(!binvoxProgram_.isEmpty())
+    return QFileInfo(binvoxProgram_).exists() ? binvoxProgram_ : QString();
+
+  //First we try to find it in its default location
+#ifdef WIN32
+  QFileInfo binvoxProgramFileInfo(QCoreApplication::applicationDirPath() + "/binvox.exe");
+#else
+  QFileInfo binvoxProgramFileInfo(QCoreApplication::applicationDirPath() + "/../Resources/binvox");
+#endif
+
+  //If it is not in the default location, we try from the last specified location
+  if(!binvoxProgramFileInfo.exists())
+  {
+    QSettings settings;
+    binvoxProgramFileInfo.setFile(settings.value("AssemblyPlugin::Binvox", "").toString());
+  }
+
+  return binvoxProgramFileInfo.exists() ? binvoxProgramFileInfo.absoluteFilePath() : QString();
+}
+
+bool Voxelizer::runBinvox(const QString& binvoxProgram, const QString& meshFilePath, int resolution, const QString& binvoxFilePath)
+{
+  const QFileInfo meshFileInfo(meshFilePath);
+  const QString scaledFilePath = meshFileInfo.absolutePath() + "/_" + meshFileInfo.baseName() + "_scaled.obj";
+
+  {
+    QFile scaledFile(scaledFilePath);
+    scaledFile.remove();
+  }
+  if(!scaleMesh(meshFilePath, scaledFilePath))
+    return false;
+  const QFileInfo scaledFileinfo(scaledFilePath);
+
+  //We first check that the following file does not exist or we remove it (otherwise the binvox program will rename the output file)
+  QFile binvoxProgramOutputFile(scaledFileinfo.absolutePath()+"/"+scaledFileinfo.baseName()+".binvox");
+
+  if(binvoxProgramOutputFile.exists())
+  {
+    std::cout << "Removing file: " << qPrintable(binvoxProgramOutputFile.fileName()) << std::endl;
+    if(!binvoxProgramOutputFile.remove())
+    {
+      std::cerr << "Unable to remove: " << qPrintable(binvoxProgramOutputFile.fileName()) << std::endl;
+      return false;
+    }
+  }
+
+  QString command("\"" + QFileInfo(binvoxProgram).absoluteFilePath() + "\"" + BINVOX_OPTIONS + " -d "+ QString::number(resolution) + " \"" + scaledFilePath + "\"");
+  std::cout << "Running " << qPrintable(command) << std::endl;
+
+  QProcess process;
+  process.start(command);
+  process.waitForFinished(-1); // will wait forever until finished
+
+  std::cerr << process.readAllStandardError().data() << std::endl;
+
+  {
+    QFile scaledFile(scaledFilePath);
+    scaledFile.remove();
+  }
+
+  if(!binvoxProgramOutputFile.exists())
+  {
+    std::cerr << "The file could not be voxelized with binvox. The format is probably not correctly handled by binvox or the software does not have administrative rights." << std::endl;
+    return false;
+  }
+
+  return binvoxProgramOutputFile.rename(binvoxFilePath);
+}
+
+bool Voxelizer::scaleMesh(const QString& filePath, const QString& scaledFilePath)
+{
+  ObjParser::Mesh mesh;
+  if(!ObjParser::parse(filePath, mesh))
+  {
+    std::cerr << "Some faces of " << qPrintable(filePath) << " could not be read." << std::endl;
+    if(mesh.positions.isEmpty())
+      return false;
+  }
+
+  return ObjParser::write(scaledFilePath, mesh, Vector3(1.0f, MESH_VERTICAL_SCALE, 1.0f));
+}
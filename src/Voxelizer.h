@@ -0,0 +1,37 @@
+#ifndef VOXELIZER_H
+#define VOXELIZER_H
+
+#include <QString>
+
+class VoxelCache;
+
+//Mesh voxelization with the external binvox program, run as a child process.
+//The mesh is scaled vertically first so that the voxels have the proportions of the bricks.
+class Voxelizer
+{
+public:
+  //An empty binvox program means: next to the application, then the last one located (settings)
+  explicit Voxelizer(const QString& binvoxProgram = QString());
+  virtual ~Voxelizer();
+
+  static bool isMeshExtensionSupported(const QString& extension);
+  //Everything besides the mesh and the resolution that changes the binvox output, part of the cache key
+  static QString settings();
+  //"<mesh directory>/<mesh base name><resolution>.binvox"
+  static QString binvoxFilePath(const QString& meshFilePath, int resolution);
+
+  //Writes the voxelization of the mesh to binvoxFilePath, from the cache when it has it (cache can be NULL)
+  bool voxelize(const QString& meshFilePath, int resolution, const QString& binvoxFilePath, VoxelCache* cache = NULL);
+
+protected:
+  //Called on a cache miss only; empty when binvox was not found
+  virtual QString locateBinvoxProgram();
+
+private:
+  bool runBinvox(const QString& binvoxProgram, const QString& meshFilePath, int resolution, const QString& binvoxFilePath);
+  static bool scaleMesh(const QString& filePath, const QString& scaledFilePath);
+
+  QString binvoxProgram_;
+};
+
+#endif // VOXELIZER_H
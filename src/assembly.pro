@@ -9,27 +9,36 @@ INCLUDEPATH += .
 
 # Input
 HEADERS += \
-    LegoDimensions.h \
     AssemblyWidget.h \
     AssemblyPlugin.h \
-    LegoBrick.h \
-    LegoCloud.h \
+    InstructionRenderer.h \
+    InstructionWriter.h \
     LegoCloudNode.h \
-    LegoGraph.h \
+    LegoGraphOverlay.h \
+    LegoRenderMesh.h \
+    LogRingBuffer.h \
     model.h \
     openglscene.h \
-    Vector3.h \
+    PreviewRenderer.h \
     QDebugStream.h
 SOURCES += \
     AssemblyPlugin.cpp \
     AssemblyWidget.cpp \
-    LegoCloud.cpp \
+    InstructionRenderer.cpp \
+    InstructionWriter.cpp \
     LegoCloudNode.cpp \
+    LegoGraphOverlay.cpp \
+    LegoRenderMesh.cpp \
+    LogRingBuffer.cpp \
     main.cpp \
     model.cpp \
-    openglscene.cpp
+    openglscene.cpp \
+    PreviewRenderer.cpp \
+    QDebugStream.cpp
 
-QT += opengl widgets svg
+QT += opengl widgets
+
+include(../libbrickr.pri)
 
 FORMS += \
     ../forms/AssemblyWidget.ui
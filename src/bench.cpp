@@ -0,0 +1,380 @@
+//Benchmarks of the LegoCloud operations on deterministic inputs: solid boxes (as the Test button),
+//the bundled test.binvox and the bundled models voxelized at several resolutions.
+//Every case is run from scratch a few times with the same seed; the log goes to stderr and the
+//results are printed as JSON on stdout (or to --output): time and bricks per second of each
+//operation, brick counts and peak resident memory.
+//The operations of each run are recorded and replayed on a new cloud: "replay" is the cost of the
+//data structures on that fixed trajectory, without the heuristics that chose it.
+
+#include "Brickr.h"
+#include "InstructionRenderer.h"
+#include "InstructionWriter.h"
+#include "ProcessStats.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+
+struct BenchCase
+{
+  enum Kind{Box, Binvox, Mesh};
+
+  BenchCase() : kind(Box), sizeX(0), sizeY(0), sizeZ(0), resolution(0) {}
+
+  QString name;
+  Kind kind;
+  int sizeX, sizeY, sizeZ;//Box
+  QString binvoxFilePath;//Binvox, and Mesh once voxelized
+  QString meshFilePath;//Mesh
+  int resolution;//Mesh
+};
+
+//Durations of an operation over the repetitions, with the bricks it started from
+struct OperationSamples
+{
+  OperationSamples() : items(0) {}
+
+  int items;
+  QVector<qint64> nanoseconds;
+};
+
+class Measures
+{
+public:
+  template<typename Operation>
+  void time(const QString& name, int items, Operation operation)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    operation();
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    if(!samples_.contains(name))
+      names_.append(name);
+    OperationSamples& samples = samples_[name];
+    samples.items = items;
+    samples.nanoseconds.append(elapsed);
+  }
+
+  QJsonObject toJson() const
+  {
+    QJsonObject operations;
+    foreach(const QString& name, names_)
+    {
+      QVector<qint64> nanoseconds = samples_[name].nanoseconds;
+      std::sort(nanoseconds.begin(), nanoseconds.end());
+      qint64 total = 0;
+      for(int i = 0; i < nanoseconds.size(); i++)
+        total += nanoseconds[i];
+      const double median = nanoseconds[nanoseconds.size()/2]*1e-9;
+
+      QJsonObject operation;
+      operation["bricks"] = samples_[name].items;
+      operation["minSeconds"] = nanoseconds.first()*1e-9;
+      operation["medianSeconds"] = median;
+      operation["meanSeconds"] = total*1e-9/nanoseconds.size();
+      if(samples_[name].items > 0 && median > 0.0)
+        operation["bricksPerSecond"] = samples_[name].items/median;
+      operations[name] = operation;
+    }
+    return operations;
+  }
+
+private:
+  QStringList names_;//In the order of the first run
+  QHash<QString, OperationSamples> samples_;
+};
+
+//Same as the Test button of the GUI
+void loadBox(const BenchCase& benchCase, LegoCloud& legoCloud)
+{
+  legoCloud.setVoxelGridDimmension(benchCase.sizeY, benchCase.sizeX, benchCase.sizeZ);
+  for(int level = 0; level < benchCase.sizeY; level++)
+  {
+    for(int x = 0; x < benchCase.sizeX; ++x)
+    {
+      for(int y = 0; y < benchCase.sizeZ; ++y)
+      {
+        LegoBrick* brick = legoCloud.addBrick(level, x, y);
+        legoCloud.addVoxel(level, x, y, brick);
+      }
+    }
+  }
+}
+
+//Limits the most used brick larger than 1x1 to half its number, so that the solver has work to do
+void setHalfBrickLimit(LegoCloud& legoCloud)
+{
+  const QMap<BrickSize, int>& brickTypeNumbers = legoCloud.getBrickTypeNumbers();
+  BrickSize mostUsed(1, 1);
+  int mostUsedNumber = 0;
+  for(QMap<BrickSize, int>::const_iterator it = brickTypeNumbers.constBegin(); it != brickTypeNumbers.constEnd(); ++it)
+  {
+    if(it.key() != BrickSize(1, 1) && it.value() > mostUsedNumber)
+    {
+      mostUsed = it.key();
+      mostUsedNumber = it.value();
+    }
+  }
+  if(mostUsedNumber > 0)
+    legoCloud.setBrickLimit(mostUsed, mostUsedNumber/2);
+}
+
+bool loadCase(const BenchCase& benchCase, LegoCloud& legoCloud)
+{
+  if(benchCase.kind == BenchCase::Box)
+  {
+    loadBox(benchCase, legoCloud);
+    return true;
+  }
+  return BinvoxParser::parse(benchCase.binvoxFilePath.toStdString(), legoCloud);
+}
+
+bool runCase(const BenchCase& benchCase, unsigned int seed, const QString& outputDir, bool instructions, Measures& measures,
+             LegoOperationLog& operationLog, QJsonObject& result)
+{
+  LegoCloud legoCloud;
+  legoCloud.setSeed(seed);
+
+  bool loaded = true;
+  measures.time("load", 0, [&]() {loaded = loadCase(benchCase, legoCloud);});
+  if(!loaded)
+    return false;
+
+  const int voxelNumber = legoCloud.getBrickNumber();
+  measures.time("buildNeighbourhood", voxelNumber, [&]() {legoCloud.buildNeighbourhood();});
+  operationLog.clear();
+  legoCloud.setOperationLog(&operationLog);
+  measures.time("merge", legoCloud.getBrickNumber(), [&]() {legoCloud.merge();});
+  measures.time("splitConComp", legoCloud.getBrickNumber(), [&]() {legoCloud.splitConComp();});
+  legoCloud.merge();
+  measures.time("splitBiconComp", legoCloud.getBrickNumber(), [&]() {legoCloud.splitBiconComp();});
+  legoCloud.merge();
+  measures.time("postHollow", legoCloud.getBrickNumber(), [&]() {legoCloud.postHollow();});
+  setHalfBrickLimit(legoCloud);
+  measures.time("solveBrickNumberLimitation", legoCloud.getBrickNumber(), [&]() {legoCloud.solveBrickNumberLimitation();});
+  legoCloud.setOperationLog(NULL);
+
+  bool outputsOk = true;
+  measures.time("exportObj", legoCloud.getBrickNumber(), [&]() {
+    outputsOk = LegoExporter::exportCloud(legoCloud, outputDir + "/bench.obj") && outputsOk;
+  });
+  if(instructions)
+  {
+    measures.time("instructionsPng", legoCloud.getBrickNumber(), [&]() {
+      outputsOk = InstructionRenderer(legoCloud).saveLevels(outputDir + "/bench.png") && outputsOk;
+    });
+    measures.time("instructionsPdf", legoCloud.getBrickNumber(), [&]() {
+      outputsOk = InstructionWriter(legoCloud).writePdf(outputDir + "/bench.pdf") && outputsOk;
+    });
+  }
+
+  result["voxels"] = voxelNumber;
+  result["levels"] = legoCloud.getLevelNumber();
+  result["bricks"] = legoCloud.getBrickNumber();
+  result["connectedComponents"] = legoCloud.getConCompNumber();
+  result["weakArticulationPoints"] = legoCloud.getBadArtPointNumber();
+  result["outputsOk"] = outputsOk;
+  result["recordedOperations"] = operationLog.size();
+  return true;
+}
+
+//The recorded operations on a new cloud, after the same loading
+bool replayCase(const BenchCase& benchCase, const LegoOperationLog& operationLog, Measures& measures)
+{
+  LegoCloud legoCloud;
+  if(!loadCase(benchCase, legoCloud))
+    return false;
+  legoCloud.buildNeighbourhood();
+
+  bool replayed = false;
+  measures.time("replay", operationLog.size(), [&]() {replayed = legoCloud.replay(operationLog);});
+  return replayed;
+}
+
+QList<int> parseIntList(const QString& text, bool& ok)
+{
+  QList<int> values;
+  ok = true;
+  foreach(const QString& field, text.split(',', QString::SkipEmptyParts))
+  {
+    bool fieldOk;
+    const int value = field.toInt(&fieldOk);
+    ok = ok && fieldOk && value > 0;
+    values.append(value);
+  }
+  return values;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  //The instruction writers need a gui application, but never a display
+  if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QGuiApplication app(argc, argv);
+  QGuiApplication::setApplicationName("brickr-bench");
+  QGuiApplication::setApplicationVersion(BRICKR_VERSION_STR);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Benchmarks of the brick layout operations, results as JSON.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+
+  const QCommandLineOption dataDirOption("data-dir", "Directory with test.binvox and models/ (default: current directory).", "dir", QDir::currentPath());
+  const QCommandLineOption boxesOption("boxes", "Sizes of the solid box cases (default 16,32,48).", "n,...", "16,32,48");
+  const QCommandLineOption resolutionsOption("resolutions", "Voxelization resolutions of the model cases (default 32,64).", "n,...", "32,64");
+  const QCommandLineOption repeatOption("repeat", "Runs of every case (default 3).", "n", "3");
+  const QCommandLineOption seedOption("seed", "Seed of the random choices, reset before every run (default 0).", "n", "0");
+  const QCommandLineOption caseOption("case", "Only run this case, e.g. box32 or chair64. Can be repeated.", "name");
+  const QCommandLineOption binvoxOption("binvox", "Path of the binvox executable.", "path");
+  const QCommandLineOption noInstructionsOption("no-instructions", "Skip the instruction exports.");
+  const QCommandLineOption outputOption("output", "Write the JSON results to this file instead of stdout.", "file");
+  parser.addOptions(QList<QCommandLineOption>() << dataDirOption << boxesOption << resolutionsOption << repeatOption
+                    << seedOption << caseOption << binvoxOption << noInstructionsOption << outputOption);
+  parser.process(app);
+
+  bool ok[4];
+  const QList<int> boxSizes = parseIntList(parser.value(boxesOption), ok[0]);
+  const QList<int> resolutions = parseIntList(parser.value(resolutionsOption), ok[1]);
+  const int repeat = parser.value(repeatOption).toInt(&ok[2]);
+  const unsigned int seed = parser.value(seedOption).toUInt(&ok[3]);
+  if(!ok[0] || !ok[1] || !ok[2] || repeat <= 0 || !ok[3])
+  {
+    std::cerr << qPrintable(parser.helpText()) << std::endl;
+    return 1;
+  }
+
+  QTemporaryDir outputDir;
+  if(!outputDir.isValid())
+  {
+    std::cerr << "Unable to create a temporary directory" << std::endl;
+    return 1;
+  }
+
+  //Only the results go to stdout
+  std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  //Cases
+  const QDir dataDir(parser.value(dataDirOption));
+  QList<BenchCase> benchCases;
+  foreach(int size, boxSizes)
+  {
+    BenchCase benchCase;
+    benchCase.name = QString("box%1").arg(size);
+    benchCase.kind = BenchCase::Box;
+    benchCase.sizeX = benchCase.sizeY = benchCase.sizeZ = size;
+    benchCases.append(benchCase);
+  }
+  {
+    BenchCase benchCase;
+    benchCase.name = "test";
+    benchCase.kind = BenchCase::Binvox;
+    benchCase.binvoxFilePath = dataDir.filePath("test.binvox");
+    benchCases.append(benchCase);
+  }
+  QStringList meshes;
+  meshes << "chair" << "wateringcan";
+  foreach(const QString& mesh, meshes)
+  {
+    foreach(int resolution, resolutions)
+    {
+      BenchCase benchCase;
+      benchCase.name = mesh + QString::number(resolution);
+      benchCase.kind = BenchCase::Mesh;
+      benchCase.meshFilePath = dataDir.filePath("models/" + mesh + ".obj");
+      benchCase.resolution = resolution;
+      benchCases.append(benchCase);
+    }
+  }
+
+  const QStringList selectedCases = parser.values(caseOption);
+  VoxelCache voxelCache;
+  Voxelizer voxelizer(parser.value(binvoxOption));
+
+  QJsonArray results;
+  bool allOk = true;
+  foreach(BenchCase benchCase, benchCases)
+  {
+    if(!selectedCases.isEmpty() && !selectedCases.contains(benchCase.name))
+      continue;
+
+    QJsonObject result;
+    result["name"] = benchCase.name;
+    std::cerr << "Benchmarking " << qPrintable(benchCase.name) << std::endl;
+
+    //The voxelization is not measured, binvox is an external program
+    if(benchCase.kind == BenchCase::Mesh)
+    {
+      result["resolution"] = benchCase.resolution;
+      benchCase.binvoxFilePath = outputDir.path() + "/" + benchCase.name + ".binvox";
+      if(!voxelizer.voxelize(benchCase.meshFilePath, benchCase.resolution, benchCase.binvoxFilePath, &voxelCache))
+      {
+        result["skipped"] = QString("voxelization failed");
+        results.append(result);
+        continue;
+      }
+    }
+
+    Measures measures;
+    LegoOperationLog operationLog;
+    bool caseOk = true;
+    for(int run = 0; run < repeat && caseOk; run++)
+    {
+      caseOk = runCase(benchCase, seed, outputDir.path(), !parser.isSet(noInstructionsOption), measures, operationLog, result)
+          && replayCase(benchCase, operationLog, measures);
+    }
+    if(!caseOk)
+    {
+      result["skipped"] = QString("loading or replay failed");
+      allOk = false;
+    }
+    else
+    {
+      result["operations"] = measures.toJson();
+    }
+    result["residentBytes"] = ProcessStats::currentResidentBytes();
+    result["peakResidentBytes"] = ProcessStats::peakResidentBytes();//Of the process: run one case per process to isolate it
+    results.append(result);
+  }
+
+  QJsonObject report;
+  report["version"] = QString(BRICKR_VERSION_STR);
+  report["seed"] = qint64(seed);
+  report["repeat"] = repeat;
+  report["cases"] = results;
+  report["peakResidentBytes"] = ProcessStats::peakResidentBytes();
+
+  std::cout.rdbuf(stdoutBuffer);
+
+  const QByteArray json = QJsonDocument(report).toJson();
+  if(parser.isSet(outputOption))
+  {
+    QFile outputFile(parser.value(outputOption));
+    if(!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || outputFile.write(json) != json.size())
+    {
+      std::cerr << "Unable to write the results: " << qPrintable(outputFile.fileName()) << std::endl;
+      return 1;
+    }
+  }
+  else
+  {
+    std::cout << json.constData() << std::flush;
+  }
+
+  return allOk ? 0 : 2;
+}
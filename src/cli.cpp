@@ -0,0 +1,420 @@
+//Command line driver of the whole pipeline, without widgets nor GL context:
+//load (mesh, binvox or project), optimize, finalize, then write the requested outputs.
+//The log goes to stderr, the statistics are printed as JSON on stdout (or to --stats).
+
+#include "Brickr.h"
+#include "InstructionRenderer.h"
+#include "InstructionWriter.h"
+#include "PreviewRenderer.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <iostream>
+
+namespace
+{
+
+enum ExitCode
+{
+  ExitOk = 0,
+  ExitUsage = 1,
+  ExitLoadFailed = 2,
+  ExitOutputFailed = 3
+};
+
+//"2x4=100"
+bool parseBrickLimit(const QString& text, BrickSize& size, int& limit)
+{
+  const QStringList sizeAndLimit = text.split('=');
+  if(sizeAndLimit.size() != 2)
+    return false;
+  const QStringList dimensions = sizeAndLimit[0].split('x');
+  if(dimensions.size() != 2)
+    return false;
+
+  bool ok[3];
+  const int sizeX = dimensions[0].toInt(&ok[0]);
+  const int sizeY = dimensions[1].toInt(&ok[1]);
+  limit = sizeAndLimit[1].toInt(&ok[2]);
+  size = sizeX <= sizeY ? BrickSize(sizeX, sizeY) : BrickSize(sizeY, sizeX);
+  return ok[0] && ok[1] && ok[2];
+}
+
+//"512x384"
+bool parseImageSize(const QString& text, int& width, int& height)
+{
+  const QStringList dimensions = text.split('x');
+  if(dimensions.size() != 2)
+    return false;
+  bool ok[2];
+  width = dimensions[0].toInt(&ok[0]);
+  height = dimensions[1].toInt(&ok[1]);
+  return ok[0] && ok[1] && width > 0 && height > 0;
+}
+
+QJsonObject cloudStats(const LegoCloud& legoCloud)
+{
+  QJsonObject stats;
+  stats["bricks"] = legoCloud.getBrickNumber();
+  stats["levels"] = legoCloud.getLevelNumber();
+  stats["width"] = legoCloud.getWidth();
+  stats["depth"] = legoCloud.getDepth();
+  stats["connectedComponents"] = legoCloud.getConCompNumber();
+  stats["weakArticulationPoints"] = legoCloud.getBadArtPointNumber();
+
+  QJsonObject brickTypes;
+  const QMap<BrickSize, int>& brickTypeNumbers = legoCloud.getBrickTypeNumbers();
+  for(QMap<BrickSize, int>::const_iterator it = brickTypeNumbers.constBegin(); it != brickTypeNumbers.constEnd(); ++it)
+  {
+    if(it.value() > 0)
+      brickTypes[QString("%1x%2").arg(it.key().first).arg(it.key().second)] = it.value();
+  }
+  stats["brickTypes"] = brickTypes;
+  return stats;
+}
+
+QJsonObject memoryStats(const LegoCloud::MemoryReport& report)
+{
+  QJsonObject stats;
+  stats["bricks"] = report.bricks;
+  stats["neighbourhood"] = report.neighbourhood;
+  stats["graphVertices"] = report.graphVertices;
+  stats["graphEdges"] = report.graphEdges;
+  stats["brickToVertex"] = report.brickToVertex;
+  stats["brickLists"] = report.brickLists;
+  stats["voxelGrid"] = report.voxelGrid;
+  stats["colorsAndLimits"] = report.colorsAndLimits;
+  stats["total"] = report.total();
+  if(report.peakResidentBytes >= 0)
+    stats["peakResidentBytes"] = report.peakResidentBytes;
+  return stats;
+}
+
+//"resolution:fillRatio", e.g. 256:0.3
+bool parseMemoryProjection(const QString& text, int& resolution, double& fillRatio)
+{
+  const QStringList values = text.split(':');
+  if(values.size() != 2)
+    return false;
+  bool ok[2];
+  resolution = values[0].toInt(&ok[0]);
+  fillRatio = values[1].toDouble(&ok[1]);
+  return ok[0] && ok[1] && resolution > 0 && fillRatio >= 0.0 && fillRatio <= 1.0;
+}
+
+QJsonObject counterStats(const EngineCounters::Snapshot& counters)
+{
+  QJsonObject stats;
+  for(int i = 0; i < EngineCounters::COUNTER_NUMBER; i++)
+    stats[EngineCounters::name(EngineCounters::Counter(i))] = counters.values[i];
+  return stats;
+}
+
+bool writeInstructions(const LegoCloud& legoCloud, const QString& filePathBase)
+{
+  const QString suffix = QFileInfo(filePathBase).suffix();
+  if(suffix.compare("pdf", Qt::CaseInsensitive) == 0)
+    return InstructionWriter(legoCloud).writePdf(filePathBase);
+  if(suffix.compare("svg", Qt::CaseInsensitive) == 0)
+    return InstructionWriter(legoCloud).writeSvgLevels(filePathBase);
+  return InstructionRenderer(legoCloud).saveLevels(filePathBase);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  //The PDF and image writers need a gui application, but never a display
+  if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QGuiApplication app(argc, argv);
+  QGuiApplication::setApplicationName("brickr-cli");
+  QGuiApplication::setApplicationVersion(BRICKR_VERSION_STR);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Brick layout of a model, from the voxelization to the instructions.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addPositionalArgument("input", "Mesh (.obj), voxelization (.binvox) or project (.brickr).");
+
+  const QCommandLineOption resolutionOption(QStringList() << "r" << "resolution", "Voxelization resolution of a mesh (default 30).", "n", "30");
+  const QCommandLineOption seedOption("seed", "Seed of the random choices of the optimization (default 0).", "n", "0");
+  const QCommandLineOption hollowOption("hollow", "Hollow the model after loading, keeping a shell of this thickness.", "thickness");
+  const QCommandLineOption limitOption("limit", "Maximum number of bricks of a size, e.g. 2x4=100. Can be repeated.", "WxH=count");
+  const QCommandLineOption noOptimizeOption("no-optimize", "Skip the automatic optimization.");
+  const QCommandLineOption noFinalizeOption("no-finalize", "Skip the finalization (post hollow, brick limits, last merge).");
+  const QCommandLineOption binvoxOption("binvox", "Path of the binvox executable.", "path");
+  const QCommandLineOption cacheDirOption("cache-dir", "Voxelization cache directory.", "dir", VoxelCache::defaultCacheDir());
+  const QCommandLineOption noCacheOption("no-cache", "Do not use the voxelization cache.");
+  const QCommandLineOption projectOption("project", "Save the project.", "file");
+  const QCommandLineOption exportOption("export", "Export the bricks as a mesh, the format follows the suffix (.obj, .ply, .stl).", "file");
+  const QCommandLineOption outerOnlyOption("export-outer-only", "Only export the bricks that can be seen from outside.");
+  const QCommandLineOption instructionsOption("instructions", "Save the instructions: <base>_<level>.png/.jpg/.svg or one .pdf.", "base");
+  const QCommandLineOption previewOption("preview", "Save a shaded preview image.", "file");
+  const QCommandLineOption previewSizeOption("preview-size", "Preview size (default 512x512).", "WxH", "512x512");
+  const QCommandLineOption statsOption("stats", "Write the JSON statistics to this file instead of stdout.", "file");
+  const QCommandLineOption traceOption("trace", "Record a Chrome trace of the run (builds with CONFIG+=tracing).", "file");
+  const QCommandLineOption recordOption("record", "Record the operations of the optimization and the finalization to this log.", "file");
+  const QCommandLineOption replayOption("replay", "Apply a recorded operation log instead of optimizing and finalizing.\n"
+                                        "The input and --hollow must be the same as for the recording.", "file");
+  const QCommandLineOption memoryProjectionOption("memory-projection", "Add the projected memory of a resolution^3 voxelization with this fill ratio, e.g. 256:0.3.", "resolution:fill");
+
+  parser.addOptions(QList<QCommandLineOption>() << resolutionOption << seedOption << hollowOption << limitOption
+                    << noOptimizeOption << noFinalizeOption << binvoxOption << cacheDirOption << noCacheOption
+                    << projectOption << exportOption << outerOnlyOption << instructionsOption << previewOption << previewSizeOption << statsOption << traceOption
+                    << recordOption << replayOption << memoryProjectionOption);
+  parser.process(app);
+
+  if(parser.positionalArguments().size() != 1)
+  {
+    std::cerr << qPrintable(parser.helpText()) << std::endl;
+    return ExitUsage;
+  }
+
+  const QString inputFilePath = parser.positionalArguments().first();
+  bool ok = true;
+  const int resolution = parser.value(resolutionOption).toInt(&ok);
+  if(!ok || resolution <= 0)
+  {
+    std::cerr << "Invalid resolution: " << qPrintable(parser.value(resolutionOption)) << std::endl;
+    return ExitUsage;
+  }
+  const unsigned int seed = parser.value(seedOption).toUInt(&ok);
+  if(!ok)
+  {
+    std::cerr << "Invalid seed: " << qPrintable(parser.value(seedOption)) << std::endl;
+    return ExitUsage;
+  }
+  int shellThickness = 0;
+  if(parser.isSet(hollowOption))
+  {
+    shellThickness = parser.value(hollowOption).toInt(&ok);
+    if(!ok || shellThickness <= 0)
+    {
+      std::cerr << "Invalid shell thickness: " << qPrintable(parser.value(hollowOption)) << std::endl;
+      return ExitUsage;
+    }
+    //A project keeps its bricks but not the voxel grid that preHollow needs
+    if(QFileInfo(inputFilePath).suffix().compare("brickr", Qt::CaseInsensitive) == 0)
+    {
+      std::cerr << "--hollow needs a voxelization, it cannot be applied to a brickr project" << std::endl;
+      return ExitUsage;
+    }
+  }
+  QMap<BrickSize, int> brickLimits;
+  foreach(const QString& limitText, parser.values(limitOption))
+  {
+    BrickSize size;
+    int limit;
+    if(!parseBrickLimit(limitText, size, limit))
+    {
+      std::cerr << "Invalid brick limit: " << qPrintable(limitText) << std::endl;
+      return ExitUsage;
+    }
+    brickLimits[size] = limit;
+  }
+  int previewWidth = 0, previewHeight = 0;
+  if(!parseImageSize(parser.value(previewSizeOption), previewWidth, previewHeight))
+  {
+    std::cerr << "Invalid preview size: " << qPrintable(parser.value(previewSizeOption)) << std::endl;
+    return ExitUsage;
+  }
+
+  if(parser.isSet(recordOption) && parser.isSet(replayOption))
+  {
+    std::cerr << "--record and --replay cannot be used together" << std::endl;
+    return ExitUsage;
+  }
+  LegoOperationLog operationLog;
+  if(parser.isSet(replayOption) && !operationLog.load(parser.value(replayOption)))
+    return ExitUsage;
+
+  int projectedResolution = 0;
+  double projectedFillRatio = 0.0;
+  if(parser.isSet(memoryProjectionOption) && !parseMemoryProjection(parser.value(memoryProjectionOption), projectedResolution, projectedFillRatio))
+  {
+    std::cerr << "Invalid memory projection: " << qPrintable(parser.value(memoryProjectionOption)) << std::endl;
+    return ExitUsage;
+  }
+
+  //Only the statistics go to stdout
+  std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  if(parser.isSet(traceOption) && !Trace::start(parser.value(traceOption)))
+  {
+    std::cout.rdbuf(stdoutBuffer);
+    return ExitUsage;
+  }
+
+  QJsonObject stats;
+  QJsonObject timings;
+  QElapsedTimer timer;
+  stats["version"] = QString(BRICKR_VERSION_STR);
+  stats["input"] = inputFilePath;
+  stats["seed"] = qint64(seed);
+
+  //Load
+  timer.start();
+  LegoCloud legoCloud;
+  legoCloud.setSeed(seed);
+  const QFileInfo inputFileInfo(inputFilePath);
+  bool loaded = false;
+  if(inputFileInfo.suffix().compare("brickr", Qt::CaseInsensitive) == 0)
+  {
+    loaded = legoCloud.loadProject(inputFilePath);
+  }
+  else if(Voxelizer::isMeshExtensionSupported(inputFileInfo.suffix()))
+  {
+    stats["resolution"] = resolution;
+    const QString binvoxFilePath = Voxelizer::binvoxFilePath(inputFilePath, resolution);
+    VoxelCache voxelCache(parser.value(cacheDirOption));
+    Voxelizer voxelizer(parser.value(binvoxOption));
+    loaded = voxelizer.voxelize(inputFilePath, resolution, binvoxFilePath, parser.isSet(noCacheOption) ? NULL : &voxelCache)
+        && LegoPipeline::loadVoxelization(binvoxFilePath, legoCloud);
+  }
+  else if(inputFileInfo.suffix().compare("binvox", Qt::CaseInsensitive) == 0)
+  {
+    loaded = LegoPipeline::loadVoxelization(inputFilePath, legoCloud);
+  }
+  else
+  {
+    std::cerr << "This file extension is not supported: " << qPrintable(inputFileInfo.suffix()) << std::endl;
+  }
+  timings["load"] = timer.elapsed()/1000.0;
+  stats["loadedBricks"] = legoCloud.getBrickNumber();
+  QJsonObject memory;
+  memory["loaded"] = memoryStats(legoCloud.memoryReport());
+
+  bool outputsOk = loaded;
+  if(loaded)
+  {
+    for(QMap<BrickSize, int>::const_iterator it = brickLimits.constBegin(); it != brickLimits.constEnd(); ++it)
+    {
+      legoCloud.setBrickLimit(it.key(), it.value());
+    }
+
+    if(shellThickness > 0)
+    {
+      timer.restart();
+      legoCloud.preHollow(shellThickness);
+      timings["hollow"] = timer.elapsed()/1000.0;
+    }
+
+    if(parser.isSet(recordOption))
+      legoCloud.setOperationLog(&operationLog);
+
+    if(parser.isSet(replayOption))
+    {
+      timer.restart();
+      const bool replayed = legoCloud.replay(operationLog);
+      timings["replay"] = timer.elapsed()/1000.0;
+      stats["replayedOperations"] = operationLog.size();
+      outputsOk = outputsOk && replayed;
+    }
+    else if(!parser.isSet(noOptimizeOption))
+    {
+      const LegoPipeline::OptimizeResult result = LegoPipeline::autoOptimize(legoCloud);
+      timings["optimize"] = result.seconds;
+      stats["conCompIterations"] = result.conCompIterations;
+      stats["artPointIterations"] = result.artPointIterations;
+    }
+
+    if(!parser.isSet(noFinalizeOption) && !parser.isSet(replayOption))
+    {
+      timer.restart();
+      LegoPipeline::finalize(legoCloud);
+      timings["finalize"] = timer.elapsed()/1000.0;
+    }
+
+    //Outputs
+    QJsonObject outputs;
+    if(parser.isSet(recordOption))
+    {
+      legoCloud.setOperationLog(NULL);
+      const bool saved = operationLog.save(parser.value(recordOption));
+      stats["recordedOperations"] = operationLog.size();
+      outputs["record"] = saved;
+      outputsOk = outputsOk && saved;
+    }
+    if(parser.isSet(projectOption))
+    {
+      timer.restart();
+      const bool saved = legoCloud.saveProject(parser.value(projectOption));
+      timings["project"] = timer.elapsed()/1000.0;
+      outputs["project"] = saved;
+      outputsOk = outputsOk && saved;
+    }
+    if(parser.isSet(exportOption))
+    {
+      LegoExporter::Options options;
+      options.format = LegoExporter::formatFromFileName(parser.value(exportOption));
+      options.outerOnly = parser.isSet(outerOnlyOption);
+      timer.restart();
+      const bool exported = LegoExporter::exportCloud(legoCloud, parser.value(exportOption), options);
+      timings["export"] = timer.elapsed()/1000.0;
+      outputs["export"] = exported;
+      outputsOk = outputsOk && exported;
+    }
+    if(parser.isSet(instructionsOption))
+    {
+      timer.restart();
+      const bool written = writeInstructions(legoCloud, parser.value(instructionsOption));
+      timings["instructions"] = timer.elapsed()/1000.0;
+      outputs["instructions"] = written;
+      outputsOk = outputsOk && written;
+    }
+    if(parser.isSet(previewOption))
+    {
+      timer.restart();
+      const bool saved = PreviewRenderer(legoCloud).save(parser.value(previewOption), previewWidth, previewHeight);
+      timings["preview"] = timer.elapsed()/1000.0;
+      outputs["preview"] = saved;
+      outputsOk = outputsOk && saved;
+    }
+    stats["outputs"] = outputs;
+    stats["cloud"] = cloudStats(legoCloud);
+    memory["final"] = memoryStats(legoCloud.memoryReport());
+  }
+  stats["loaded"] = loaded;
+  stats["timings"] = timings;
+  stats["counters"] = counterStats(EngineCounters::snapshot());
+  if(parser.isSet(memoryProjectionOption))
+  {
+    QJsonObject projection = memoryStats(legoCloud.projectMemory(projectedResolution, projectedFillRatio));
+    projection["resolution"] = projectedResolution;
+    projection["fillRatio"] = projectedFillRatio;
+    memory["projection"] = projection;
+  }
+  stats["memory"] = memory;
+  if(Trace::isRecording() && !Trace::stop())
+    outputsOk = false;
+  stats["ok"] = outputsOk;
+
+  std::cout.rdbuf(stdoutBuffer);
+
+  const QByteArray json = QJsonDocument(stats).toJson();
+  if(parser.isSet(statsOption))
+  {
+    QFile statsFile(parser.value(statsOption));
+    if(!statsFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || statsFile.write(json) != json.size())
+    {
+      std::cerr << "Unable to write the statistics: " << qPrintable(statsFile.fileName()) << std::endl;
+      return ExitOutputFailed;
+    }
+  }
+  else
+  {
+    std::cout << json.constData() << std::flush;
+  }
+
+  if(!loaded)
+    return ExitLoadFailed;
+  return outputsOk ? ExitOk : ExitOutputFailed;
+}
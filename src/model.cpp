@@ -1,88 +1,25 @@
 #include "model.h"
 
-#include <QFile>
-#include <QTextStream>
-#include <QVarLengthArray>
+#include "ObjParser.h"
+
+#include <QFileInfo>
 
 #include <QtOpenGL>
 
 Model::Model(const QString &filePath)
     : QObject(), m_fileName(QFileInfo(filePath).fileName())
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly))
+    ObjParser::Mesh mesh;
+    if (!ObjParser::parse(filePath, mesh) && mesh.positions.isEmpty())
         return;
 
-    Vector3 boundsMin( 1e9, 1e9, 1e9);
-    Vector3 boundsMax(-1e9,-1e9,-1e9);
-
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString input = in.readLine();
-        if (input.isEmpty() || input[0] == '#')
-            continue;
-
-        QTextStream ts(&input);
-        QString id;
-        ts >> id;
-        if (id == "v") {
-            Vector3 p;
-            for (int i = 0; i < 3; ++i) {
-                ts >> p[i];
-                boundsMin[i] = qMin(boundsMin[i], p[i]);
-                boundsMax[i] = qMax(boundsMax[i], p[i]);
-            }
-            m_points << p;
-        } else if (id == "f" || id == "fo") {
-            QVarLengthArray<int, 4> p;
-
-            while (!ts.atEnd()) {
-                QString vertex;
-                ts >> vertex;
-                const int vertexIndex = vertex.split('/').value(0).toInt();
-                if (vertexIndex)
-                    p.append(vertexIndex > 0 ? vertexIndex - 1 : m_points.size() + vertexIndex);
-            }
-
-            for (int i = 0; i < p.size(); ++i) {
-                const int edgeA = p[i];
-                const int edgeB = p[(i + 1) % p.size()];
-
-                if (edgeA < edgeB)
-                    m_edgeIndices << edgeA << edgeB;
-            }
-
-            for (int i = 0; i < 3; ++i)
-                m_pointIndices << p[i];
-
-            if (p.size() == 4)
-                for (int i = 0; i < 3; ++i)
-                    m_pointIndices << p[(i + 2) % 4];
-        }
-    }
-
-    boundsMax_ = boundsMax;
-    boundsMin_ = boundsMin;
-
-//    const Vector3 bounds = boundsMax - boundsMin;
-//    const qreal scale = 1 / qMax(bounds.x(), qMax(bounds.y(), bounds.z()));
-//    for (int i = 0; i < m_points.size(); ++i)
-//        m_points[i] = (m_points[i] - (boundsMin + bounds * 0.5)) * scale;
-
-    m_normals.resize(m_points.size());
-    for (int i = 0; i < m_pointIndices.size(); i += 3) {
-        const Vector3 a = m_points.at(m_pointIndices.at(i));
-        const Vector3 b = m_points.at(m_pointIndices.at(i+1));
-        const Vector3 c = m_points.at(m_pointIndices.at(i+2));
-
-        const Vector3 normal = cross(b - a, c - a).normalize();
-
-        for (int j = 0; j < 3; ++j)
-            m_normals[m_pointIndices.at(i + j)] += normal;
-    }
+    m_points = mesh.positions;
+    m_normals = mesh.normals;
+    m_pointIndices = mesh.triangleIndices;
+    m_edgeIndices = mesh.edgeIndices;
 
-    for (int i = 0; i < m_normals.size(); ++i)
-        m_normals[i] = m_normals[i].normalize();
+    boundsMax_ = mesh.boundsMax;
+    boundsMin_ = mesh.boundsMin;
 
     emit geometryChanged();
 }
@@ -41,6 +41,7 @@ OpenGLScene::OpenGLScene(int width, int height)
 {
     m_plugin = std::auto_ptr<AssemblyPlugin>(new AssemblyPlugin);
     connect(m_plugin.get(), SIGNAL(geometryChanged()), this, SLOT(resetScene()));
+    connect(m_plugin.get(), SIGNAL(sceneChanged()), this, SLOT(update()));
 
     QWidget *assembly = createDialog(tr("Brickr"));
     m_assembly = new AssemblyWidget(m_plugin.get());
@@ -58,7 +59,9 @@ OpenGLScene::OpenGLScene(int width, int height)
     infoLabel->setText("Automatic Generation of Constructable Brick Sculptures\n© 2013-2015 Romain Testuz and Yuliy Schwartzburg\nDetails at http://lgg.epfl.ch/publications/2013/lego.php\nContact: romain.testuz@rayform.ch");
     info->layout()->addWidget(infoLabel);
 
-    debugStreamOut_ = std::unique_ptr<QDebugStream>(new QDebugStream(consoleEdit));
+    consoleSink_ = std::unique_ptr<ConsoleSink>(new ConsoleSink(consoleEdit));
+
+    debugStreamOut_ = std::unique_ptr<QDebugStream>(new QDebugStream(consoleSink_->getBuffer()));
 #ifdef WIN32
     std::cout.rdbuf(debugStreamOut_.get());
 #else
@@ -66,7 +69,7 @@ OpenGLScene::OpenGLScene(int width, int height)
     std::cout.rdbuf(teebufOut_.get());
 #endif
 
-    debugStreamErr_ = std::unique_ptr<QDebugStream>(new QDebugStream(consoleEdit));
+    debugStreamErr_ = std::unique_ptr<QDebugStream>(new QDebugStream(consoleSink_->getBuffer()));
 #ifdef WIN32
     std::cerr.rdbuf(debugStreamErr_.get());
 #else
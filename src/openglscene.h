@@ -21,6 +21,7 @@ class AssemblyWidget;
 #include <ostream>
 class teebuf;
 class QDebugStream;
+class ConsoleSink;
 
 class OpenGLScene : public QGraphicsScene
 {
@@ -59,6 +60,7 @@ private:
 
     QGraphicsRectItem *m_lightItem;
 
+    std::unique_ptr<ConsoleSink> consoleSink_;
     std::unique_ptr<QDebugStream> debugStreamOut_;
     std::unique_ptr<QDebugStream> debugStreamErr_;
     std::unique_ptr<teebuf> teebufOut_;